@@ -0,0 +1,989 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+	#include <pthread.h>
+#else
+	#pragma warning(disable:4996)
+#endif
+
+#include "config.h"
+#include "logging.h"
+#include "oracle.h"
+#include "query.h"
+#include "tempfs.h"
+#include "util.h"
+#include "vfs.h"
+#include "compile.h"
+
+#define CMP_BATCH_MAX_WAIT 5000 // ms, DDL is executed even if it keeps coming (compilewindow=, debounce=)
+
+// DDL written through a file, waiting to be executed
+typedef struct s_cmp_job {
+    char *path;     // file path, e.g. /SCHEMA/PACKAGE_BODY/MY_PACKAGE.SQL
+    const t_objtype *ot;  // type of object, e.g. PACKAGE BODY (also determines order within batch)
+    char *schema;
+    char *object;
+    char *cache_fn; // DDL is read from cache file when it is executed (see cmp_execute_ddl)
+    char *ddl;      // DROP statement (only for jobs queued by cmp_drop, they have no cache file)
+    long long queued;  // ms, when DDL for this path was queued first (see cmp_enqueue)
+    long long updated; // ms, when DDL was queued last
+    long long mtime;   // ns, modification time of cache file when DDL was read from it
+    long long size;
+    int       done;    // 1=executed, batch it belongs to may still be running (see cmp_done)
+    struct s_cmp_job *next;
+} t_cmp_job;
+
+static void cmp_job_free(t_cmp_job *job) {
+    if (job == NULL)
+        return;
+    free(job->path);
+    free(job->schema);
+    free(job->object);
+    free(job->cache_fn);
+    free(job->ddl);
+    free(job);
+}
+
+// modification time (ns) and size of file fname
+static int cmp_stat(const char *fname, long long *mtime, long long *size) {
+    struct stat st;
+    if (stat(fname, &st) != 0)
+        return EXIT_FAILURE;
+#ifndef _MSC_VER
+    *mtime = (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    *mtime = (long long) st.st_mtime * 1000000000LL;
+#endif
+    *size = (long long) st.st_size;
+    return EXIT_SUCCESS;
+}
+
+// files created through the filesystem, whose objects were not created in database yet (see cmp_create)
+typedef struct s_cmp_created {
+    char *path;
+    int   failed;   // 1=DDL creating the object was executed, but it failed
+    struct s_cmp_created *next;
+} t_cmp_created;
+
+static t_cmp_created *cmp_created_head = NULL;
+
+#ifndef _MSC_VER
+static pthread_mutex_t cmp_created_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define CMP_CREATED_LOCK()   pthread_mutex_lock(&cmp_created_mutex)
+#define CMP_CREATED_UNLOCK() pthread_mutex_unlock(&cmp_created_mutex)
+#else
+#define CMP_CREATED_LOCK()
+#define CMP_CREATED_UNLOCK()
+#endif
+
+// cmp_created_mutex must be held by caller
+static t_cmp_created* cmp_created_search(const char *path) {
+    for (t_cmp_created *c = cmp_created_head; c != NULL; c = c->next)
+        if (strcmp(c->path, path) == 0)
+            return c;
+    return NULL;
+}
+
+int cmp_create(const char *path) {
+    int retval = EXIT_SUCCESS;
+    CMP_CREATED_LOCK();
+    if (cmp_created_search(path) == NULL) {
+        t_cmp_created *c = calloc(1, sizeof(t_cmp_created));
+        if (c == NULL || (c->path = strdup(path)) == NULL) {
+            logmsg(LOG_ERROR, "cmp_create() - unable to allocate memory for [%s]", path);
+            free(c);
+            retval = EXIT_FAILURE;
+        } else {
+            c->next = cmp_created_head;
+            cmp_created_head = c;
+        }
+    }
+    CMP_CREATED_UNLOCK();
+    return retval;
+}
+
+int cmp_created(const char *path) {
+    CMP_CREATED_LOCK();
+    int found = (cmp_created_search(path) != NULL);
+    CMP_CREATED_UNLOCK();
+    return found;
+}
+
+// name of file path if it is in directory dir (e.g. /SCHEMA/VIEW), NULL otherwise
+static const char* cmp_dir_name(const char *path, const char *dir, size_t dir_len) {
+    if (strncmp(path, dir, dir_len) != 0 || path[dir_len] != '/' || strchr(path + dir_len + 1, '/') != NULL)
+        return NULL;
+    return path + dir_len + 1;
+}
+
+int cmp_created_list(const char *dir, char ***names, int *count) {
+    size_t dir_len = strlen(dir);
+    *names = NULL;
+    *count = 0;
+
+    CMP_CREATED_LOCK();
+    int n = 0;
+    for (t_cmp_created *c = cmp_created_head; c != NULL; c = c->next)
+        n++;
+    if (n == 0) {
+        CMP_CREATED_UNLOCK();
+        return EXIT_SUCCESS;
+    }
+
+    *names = calloc(n, sizeof(char*));
+    if (*names == NULL) {
+        CMP_CREATED_UNLOCK();
+        logmsg(LOG_ERROR, "cmp_created_list() - unable to allocate memory for %d names", n);
+        return EXIT_FAILURE;
+    }
+
+    int retval = EXIT_SUCCESS;
+    for (t_cmp_created *c = cmp_created_head; c != NULL && retval == EXIT_SUCCESS; c = c->next) {
+        const char *name = cmp_dir_name(c->path, dir, dir_len);
+        if (name == NULL)
+            continue;
+        if (((*names)[*count] = strdup(name)) == NULL)
+            retval = EXIT_FAILURE;
+        else
+            (*count)++;
+    }
+    CMP_CREATED_UNLOCK();
+
+    if (retval != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "cmp_created_list() - unable to allocate memory for names in [%s]", dir);
+    return retval;
+}
+
+// forget created file, return 1 if DDL creating its object was never executed (so it does not exist in database)
+static int cmp_created_remove(const char *path) {
+    int local = 0;
+    CMP_CREATED_LOCK();
+    for (t_cmp_created **link = &cmp_created_head; *link != NULL; link = &(*link)->next) {
+        t_cmp_created *c = *link;
+        if (strcmp(c->path, path) == 0) {
+            *link = c->next;
+            local = (c->failed == 0);
+            free(c->path);
+            free(c);
+            break;
+        }
+    }
+    CMP_CREATED_UNLOCK();
+    return local;
+}
+
+static void cmp_created_failed(const char *path) {
+    CMP_CREATED_LOCK();
+    t_cmp_created *c = cmp_created_search(path);
+    if (c != NULL)
+        c->failed = 1;
+    CMP_CREATED_UNLOCK();
+}
+
+// execute DDL straight from (mapped) cache file, so that even large sources are not copied in memory
+static int cmp_execute_ddl(t_cmp_job *job, t_ddl_result *result) {
+    const char *data = NULL;
+    size_t len = 0;
+    if (tfs_map(job->cache_fn, &data, &len) != EXIT_SUCCESS || len == 0) {
+        logddl("Unable to read DDL for [%s].\n", job->path);
+        return EXIT_FAILURE;
+    }
+
+    int retval;
+    if (job->ot->id == OT_JAVA_SOURCE) {
+        // java source is not DDL by itself, statement is assembled (without last character of the file, see fs_template)
+        char prefix[600];
+        int prefix_len = snprintf(prefix, sizeof(prefix), "CREATE OR REPLACE AND COMPILE JAVA SOURCE NAMED \"%s\".\"%s\" AS\n",
+            job->schema, job->object);
+        char *ddl = malloc(prefix_len + len);
+        if (ddl == NULL) {
+            logmsg(LOG_ERROR, "cmp_execute() - unable to allocate memory for DDL of [%s]", job->path);
+            tfs_unmap(data, len);
+            return EXIT_FAILURE;
+        }
+        memcpy(ddl, prefix, prefix_len);
+        memcpy(ddl + prefix_len, data, len - 1);
+        retval = qry_exec_ddl(job->schema, job->object, ddl, prefix_len + len - 1, job->ot->ora_name, result);
+        free(ddl);
+    } else {
+        retval = qry_exec_ddl(job->schema, job->object, data, len, job->ot->ora_name, result);
+    }
+
+    tfs_unmap(data, len);
+    return retval;
+}
+
+// split job path (/SCHEMA/TYPE/FILE) to filesystem names, parts point into (modified) path
+static int cmp_path_parts(char *path, char **schema, char **type, char **fname) {
+    *schema = path + 1;
+    if ((*type = strchr(*schema, '/')) == NULL)
+        return EXIT_FAILURE;
+    *(*type)++ = '\0';
+    if ((*fname = strchr(*type, '/')) == NULL)
+        return EXIT_FAILURE;
+    *(*fname)++ = '\0';
+    return EXIT_SUCCESS;
+}
+
+static void cmp_execute(t_cmp_job *job) {
+    t_ddl_result result = { 0, 0 };
+    long long mtime = 0, size = 0;
+    int refill = 0;
+
+    // file is written again (its DDL is queued again when it is closed), content must not be torn
+    if (cmp_stat(job->cache_fn, &mtime, &size) != EXIT_SUCCESS || mtime != job->mtime || size != job->size) {
+        logmsg(LOG_INFO, "cmp_execute() - [%s] was modified after its DDL was queued, DDL is skipped.", job->path);
+        return;
+    }
+
+    logmsg(LOG_DEBUG, "cmp_execute() - executing DDL for [%s]", job->path);
+    int created = cmp_created(job->path);
+    cmp_execute_ddl(job, &result);
+    if (created && result.last_ddl_time == 0) {
+        // object was not created, cache file is the only copy of its source, so it is kept
+        cmp_created_failed(job->path);
+        logddl("New file [%s] is kept locally until its DDL succeeds.\n", job->path);
+        return;
+    }
+    if (created)
+        cmp_created_remove(job->path);
+
+    // file may have been written again meanwhile (its DDL is queued again), such file must be kept
+    tfs_lock(job->cache_fn);
+    if (cmp_stat(job->cache_fn, &mtime, &size) != EXIT_SUCCESS) {
+        logmsg(LOG_DEBUG, "cmp_execute() - cache file [%s] is already removed.", job->cache_fn);
+    } else if (mtime != job->mtime || size != job->size) {
+        logmsg(LOG_DEBUG, "cmp_execute() - cache file [%s] was modified after its DDL was queued, it is kept.", job->cache_fn);
+    } else if (tfs_rmfile(job->cache_fn) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "cmp_execute() - unable to remove cache file [%s] after DDL.", job->cache_fn);
+    } else {
+        refill = 1;
+    }
+    tfs_unlock(job->cache_fn);
+
+    if (result.last_ddl_time == 0)
+        return;
+
+    char *path = strdup(job->path);
+    char *schema, *type, *fname;
+    if (path == NULL || cmp_path_parts(path, &schema, &type, &fname) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "cmp_execute() - unable to split path [%s]", job->path);
+        free(path);
+        return;
+    }
+
+    // cache entry is rewritten right away (as database returns it), so that reopening the file does not fetch it
+    if (refill && qry_object_prefetch(schema, type, fname, result.last_ddl_time) != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "cmp_execute() - unable to refill cache for [%s]", job->path);
+
+    vfs_update_later(schema, type, fname, (result.valid ? 'F' : 'I'), result.last_ddl_time);
+    free(path);
+}
+
+// execute DROP statements of count jobs (in list) as a single PL/SQL block, directories of objects which
+// could not be dropped are listed again (their files were removed from vfs by fs_unlink)
+static void cmp_execute_drops(t_cmp_job *list, int count) {
+    char **ddl = calloc(count, sizeof(char*));
+    int *failed = calloc(count, sizeof(int));
+    t_cmp_job **jobs = calloc(count, sizeof(t_cmp_job*));
+    if (ddl == NULL || failed == NULL || jobs == NULL) {
+        logmsg(LOG_ERROR, "cmp_execute_drops() - unable to allocate memory for %d jobs, objects are not dropped.", count);
+        goto cmp_execute_drops_cleanup;
+    }
+
+    int n = 0;
+    for (t_cmp_job *job = list; job != NULL && n < count; job = job->next) {
+        if (job->ddl != NULL) {
+            jobs[n] = job;
+            ddl[n++] = job->ddl;
+        }
+    }
+
+    logmsg(LOG_DEBUG, "cmp_execute_drops() - dropping %d objects", n);
+    qry_exec_drops(ddl, n, failed);
+
+    for (int i = 0; i < n; i++) {
+        if (failed[i] == 0)
+            continue;
+
+        char *path = strdup(jobs[i]->path);
+        char *schema, *type, *fname;
+        if (path != NULL && cmp_path_parts(path, &schema, &type, &fname) == EXIT_SUCCESS)
+            vfs_invalidate_later(schema, type);
+        free(path);
+    }
+
+cmp_execute_drops_cleanup:
+    free(ddl);
+    free(failed);
+    free(jobs);
+}
+
+#ifndef _MSC_VER
+
+// file open for writing (see cmp_writer_open)
+typedef struct s_cmp_writer {
+    char *path;
+    int   count;    // number of handles (and truncates in progress)
+    struct s_cmp_writer *next;
+} t_cmp_writer;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;      // signaled when job is queued or completed
+    pthread_t       thread;
+    int             thread_started;
+    int             running;
+    long long       last_queued;
+    t_cmp_job      *head;      // jobs in order they were queued
+    t_cmp_job      *tail;
+    t_cmp_job      *batch;     // jobs being executed by worker
+    long long       completed; // jobs executed (or failed) so far, reported in ddlfs.status
+    t_cmp_writer   *writers;   // files open for writing, their DDL is not executed meanwhile
+} cmp = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+// return 1 if file path is open for writing, cmp.mutex must be held by caller
+static int cmp_writing(const char *path) {
+    for (t_cmp_writer *w = cmp.writers; w != NULL; w = w->next)
+        if (strcmp(w->path, path) == 0)
+            return 1;
+    return 0;
+}
+
+static long long cmp_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// add edge from job with (schema, ref_name, ref_type) to job with (schema, name, type) for every such pair of jobs
+static void cmp_order_edges(t_cmp_job **jobs, int n, const char *schema, const t_dependency *d, char *edges) {
+    for (int from = 0; from < n; from++) {
+        if (strcmp(jobs[from]->schema, schema) != 0 || strcmp(jobs[from]->object, d->referenced_name) != 0 ||
+            strcmp(jobs[from]->ot->ora_name, d->referenced_type) != 0)
+            continue;
+
+        for (int to = 0; to < n; to++)
+            if (strcmp(jobs[to]->schema, schema) == 0 && strcmp(jobs[to]->object, d->name) == 0 &&
+                strcmp(jobs[to]->ot->ora_name, d->type) == 0)
+                edges[from*n + to] = 1;
+    }
+}
+
+// order jobs so that referenced objects are compiled before objects which depend on them (all_dependencies),
+// otherwise by type rank (see t_objtype) and then in order they were queued. Cycles are broken by the same rule.
+static void cmp_order(t_cmp_job **jobs, int n) {
+    char *edges = calloc((size_t) n * n, sizeof(char));
+    int *order = calloc(n, sizeof(int));
+    char *done = calloc(n, sizeof(char));
+    char **names = calloc(n, sizeof(char*));
+    if (edges == NULL || order == NULL || done == NULL || names == NULL) {
+        logmsg(LOG_ERROR, "cmp_order() - unable to allocate memory for %d jobs, DDL is executed in queued order.", n);
+        goto cmp_order_cleanup;
+    }
+
+    // dependencies are queried once per schema
+    for (int i = 0; i < n; i++) {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++)
+            seen = (strcmp(jobs[j]->schema, jobs[i]->schema) == 0);
+        if (seen)
+            continue;
+
+        int name_count = 0;
+        for (int j = i; j < n; j++)
+            if (strcmp(jobs[j]->schema, jobs[i]->schema) == 0)
+                names[name_count++] = jobs[j]->object;
+
+        t_dependency *deps = NULL;
+        int dep_count = 0;
+        if (qry_dependencies(jobs[i]->schema, names, name_count, &deps, &dep_count) != EXIT_SUCCESS)
+            logmsg(LOG_ERROR, "cmp_order() - unable to query dependencies of schema [%s]", jobs[i]->schema);
+
+        for (int d = 0; d < dep_count; d++)
+            cmp_order_edges(jobs, n, jobs[i]->schema, &deps[d], edges);
+        free(deps);
+    }
+
+    // topological sort, among ready jobs the one with lowest rank (and queued first) goes first
+    for (int k = 0; k < n; k++) {
+        int best = -1, best_ready = 0;
+        for (int i = 0; i < n; i++) {
+            if (done[i])
+                continue;
+
+            int ready = 1;
+            for (int from = 0; from < n && ready; from++)
+                if (!done[from] && from != i && edges[from*n + i])
+                    ready = 0;
+
+            if (best == -1 || ready > best_ready || (ready == best_ready && jobs[i]->ot->rank < jobs[best]->ot->rank)) {
+                best = i;
+                best_ready = ready;
+            }
+        }
+        done[best] = 1;
+        order[k] = best;
+    }
+
+    t_cmp_job **sorted = calloc(n, sizeof(t_cmp_job*));
+    if (sorted != NULL) {
+        for (int k = 0; k < n; k++)
+            sorted[k] = jobs[order[k]];
+        memcpy(jobs, sorted, n * sizeof(t_cmp_job*));
+        free(sorted);
+    }
+
+cmp_order_cleanup:
+    free(edges);
+    free(order);
+    free(done);
+    free(names);
+}
+
+// job was executed, so that files waiting for it (cmp_wait, cmp_writer_open, cmp_discard) don't wait for the rest of
+// its batch (e.g. DDL after it and recompile of invalid objects)
+static void cmp_done(t_cmp_job *job) {
+    pthread_mutex_lock(&cmp.mutex);
+    job->done = 1;
+    cmp.completed++;
+    pthread_cond_broadcast(&cmp.cond);
+    pthread_mutex_unlock(&cmp.mutex);
+}
+
+// execute batch of jobs (in cmp.batch list): DROP statements first (in a single round trip), then DDL back
+// to back, then recompile objects they've invalidated
+static void cmp_execute_batch(t_cmp_job *batch) {
+    int n = 0, drops = 0;
+    for (t_cmp_job *job = batch; job != NULL; job = job->next) {
+        if (job->ddl != NULL)
+            drops++;
+        else
+            n++;
+    }
+
+    if (drops > 0) {
+        cmp_execute_drops(batch, drops);
+        for (t_cmp_job *job = batch; job != NULL; job = job->next)
+            if (job->ddl != NULL)
+                cmp_done(job);
+    }
+    if (n == 0)
+        return;
+
+    t_cmp_job **jobs = calloc(n, sizeof(t_cmp_job*));
+    if (jobs == NULL) {
+        logmsg(LOG_ERROR, "cmp_execute_batch() - unable to allocate memory for %d jobs, DDL is executed in queued order.", n);
+        for (t_cmp_job *job = batch; job != NULL; job = job->next) {
+            if (job->ddl == NULL) {
+                cmp_execute(job);
+                cmp_done(job);
+            }
+        }
+        return;
+    }
+
+    n = 0;
+    for (t_cmp_job *job = batch; job != NULL; job = job->next)
+        if (job->ddl == NULL)
+            jobs[n++] = job;
+
+    if (n > 1) {
+        logmsg(LOG_INFO, "Executing batch of %d DDL statements.", n);
+        cmp_order(jobs, n);
+    }
+
+    for (int i = 0; i < n; i++) {
+        cmp_execute(jobs[i]);
+        cmp_done(jobs[i]);
+    }
+
+    // objects of the batch (and their dependents) may have been invalidated by DDL executed after them
+    for (int i = 0; i < n && n > 1; i++) {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++)
+            seen = (strcmp(jobs[j]->schema, jobs[i]->schema) == 0);
+        if (!seen)
+            qry_compile_invalid(jobs[i]->schema);
+    }
+
+    free(jobs);
+}
+
+static void cmp_timedwait(long long due) {
+    struct timespec ts;
+    ts.tv_sec = (time_t) (due / 1000);
+    ts.tv_nsec = (long) (due % 1000) * 1000000;
+    pthread_cond_timedwait(&cmp.cond, &cmp.mutex, &ts);
+}
+
+static void* cmp_worker(void *arg) {
+    struct s_connection conn;
+    int connected = 0;
+
+    memset(&conn, 0, sizeof(struct s_connection));
+    logmsg(LOG_DEBUG, "cmp_worker() - started.");
+
+    pthread_mutex_lock(&cmp.mutex);
+    while (cmp.running || cmp.head != NULL) {
+        if (cmp.head == NULL) {
+            pthread_cond_wait(&cmp.cond, &cmp.mutex);
+            continue;
+        }
+
+        // wait until no DDL was queued for compilewindow ms, so that bulk writes (e.g. git checkout) form a single batch
+        long long now = cmp_now();
+        long long due = cmp.last_queued + g_conf.compilewindow;
+        if (due > cmp.head->queued + CMP_BATCH_MAX_WAIT)
+            due = cmp.head->queued + CMP_BATCH_MAX_WAIT;
+        if (cmp.running && now < due) {
+            cmp_timedwait(due);
+            continue;
+        }
+
+        // only files which were not written for debounce ms are taken (all of them on umount), drops right away.
+        // Files still open for writing are left alone, their content could change while DDL is read from it
+        t_cmp_job **link = &cmp.head;
+        t_cmp_job *batch_tail = NULL;
+        long long next_due = 0;
+        cmp.tail = NULL;
+        while (*link != NULL) {
+            t_cmp_job *job = *link;
+            long long job_due = job->updated + (job->ddl != NULL ? 0 : g_conf.debounce);
+            if (cmp.running && job->ddl == NULL && cmp_writing(job->path)) {
+                cmp.tail = job;
+                link = &job->next;
+            } else if (!cmp.running || now >= job_due || job_due > job->queued + CMP_BATCH_MAX_WAIT) {
+                *link = job->next;
+                job->next = NULL;
+                if (batch_tail == NULL)
+                    cmp.batch = job;
+                else
+                    batch_tail->next = job;
+                batch_tail = job;
+            } else {
+                if (next_due == 0 || job_due < next_due)
+                    next_due = job_due;
+                cmp.tail = job;
+                link = &job->next;
+            }
+        }
+
+        if (cmp.batch == NULL) {
+            // only files open for writing are left, cmp_writer_close signals once they are closed
+            if (next_due == 0)
+                pthread_cond_wait(&cmp.cond, &cmp.mutex);
+            else
+                cmp_timedwait(next_due);
+            continue;
+        }
+        pthread_mutex_unlock(&cmp.mutex);
+
+        // database session is only opened once there's something to do
+        if (connected == 0) {
+            if (ora_connect_session(&conn) == EXIT_SUCCESS)
+                connected = 1;
+        }
+
+        if (connected == 1) {
+            cmp_execute_batch(cmp.batch);
+        } else {
+            // cache files (with local changes) are kept, so that DDL can be written again
+            for (t_cmp_job *job = cmp.batch; job != NULL; job = job->next) {
+                logmsg(LOG_ERROR, "cmp_worker() - unable to connect, DDL for [%s] was not executed.", job->path);
+                logddl("Unable to connect, DDL for [%s] was not executed.", job->path);
+            }
+        }
+
+        pthread_mutex_lock(&cmp.mutex);
+        while (cmp.batch != NULL) {
+            t_cmp_job *next = cmp.batch->next;
+            if (cmp.batch->done == 0)
+                cmp.completed++;
+            cmp_job_free(cmp.batch);
+            cmp.batch = next;
+        }
+        pthread_cond_broadcast(&cmp.cond);
+    }
+    pthread_mutex_unlock(&cmp.mutex);
+
+    if (connected == 1)
+        ora_disconnect_session(&conn);
+
+    logmsg(LOG_DEBUG, "cmp_worker() - stopped.");
+    return NULL;
+}
+
+int cmp_start() {
+    cmp.running = 1;
+    if (pthread_create(&cmp.thread, NULL, cmp_worker, NULL) != 0) {
+        logmsg(LOG_ERROR, "cmp_start() - unable to start compile worker.");
+        cmp.running = 0;
+        return EXIT_FAILURE;
+    }
+    cmp.thread_started = 1;
+    return EXIT_SUCCESS;
+}
+
+void cmp_stop() {
+    if (cmp.thread_started == 0)
+        return;
+
+    pthread_mutex_lock(&cmp.mutex);
+    if (cmp.head != NULL)
+        logmsg(LOG_INFO, "Waiting for queued DDL to be executed.");
+    cmp.running = 0;
+    pthread_cond_broadcast(&cmp.cond);
+    pthread_mutex_unlock(&cmp.mutex);
+
+    pthread_join(cmp.thread, NULL);
+    cmp.thread_started = 0;
+}
+
+// return 1 if DDL for path is being executed (or its batch was taken, but it was not executed yet),
+// cmp.mutex must be held by caller
+static int cmp_running(const char *path) {
+    for (t_cmp_job *job = cmp.batch; job != NULL; job = job->next)
+        if (job->done == 0 && strcmp(job->path, path) == 0)
+            return 1;
+    return 0;
+}
+
+// remove queued (not running) DDL jobs for path from queue and return the first one removed (if any),
+// others are freed. Drops are kept, so that an object dropped and created again is created anew.
+// cmp.mutex must be held by caller
+static t_cmp_job* cmp_dequeue(const char *path) {
+    t_cmp_job *found = NULL;
+    t_cmp_job **link = &cmp.head;
+    cmp.tail = NULL;
+    while (*link != NULL) {
+        t_cmp_job *job = *link;
+        if (strcmp(job->path, path) != 0 || job->ddl != NULL) {
+            cmp.tail = job;
+            link = &job->next;
+            continue;
+        }
+
+        *link = job->next;
+        job->next = NULL;
+        if (found == NULL)
+            found = job;
+        else
+            cmp_job_free(job);
+    }
+    return found;
+}
+
+int cmp_enqueue(const char *path, const t_objtype *ot, char *schema, char *object, char *cache_fn) {
+    t_cmp_job *job = calloc(1, sizeof(t_cmp_job));
+    if (job == NULL) {
+        logmsg(LOG_ERROR, "cmp_enqueue() - unable to allocate memory for job [%s]", path);
+        free(schema);
+        free(object);
+        free(cache_fn);
+        return EXIT_FAILURE;
+    }
+    job->path = strdup(path);
+    job->ot = ot;
+    job->schema = schema;
+    job->object = object;
+    job->cache_fn = cache_fn;
+    if (job->path == NULL) {
+        logmsg(LOG_ERROR, "cmp_enqueue() - unable to allocate memory for job [%s]", path);
+        cmp_job_free(job);
+        return EXIT_FAILURE;
+    }
+    if (cmp_stat(cache_fn, &job->mtime, &job->size) != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "cmp_enqueue() - unable to stat cache file [%s]", cache_fn);
+
+    // worker is not available, DDL is executed right away (as it was before compile queue)
+    if (cmp.thread_started == 0) {
+        cmp_execute(job);
+        cmp_job_free(job);
+        return EXIT_SUCCESS;
+    }
+
+    pthread_mutex_lock(&cmp.mutex);
+    job->updated = cmp_now();
+    job->queued = job->updated;
+
+    // the same file written again (e.g. editor saving multiple times), only its last content is executed
+    t_cmp_job *prev = cmp_dequeue(path);
+    if (prev != NULL) {
+        logmsg(LOG_DEBUG, "cmp_enqueue() - DDL for [%s] replaces DDL queued before.", path);
+        job->queued = prev->queued;
+        cmp_job_free(prev);
+    }
+
+    cmp.last_queued = job->updated;
+    if (cmp.tail == NULL)
+        cmp.head = job;
+    else
+        cmp.tail->next = job;
+    cmp.tail = job;
+    pthread_cond_broadcast(&cmp.cond);
+    pthread_mutex_unlock(&cmp.mutex);
+
+    logmsg(LOG_DEBUG, "cmp_enqueue() - queued DDL for [%s]", path);
+    return EXIT_SUCCESS;
+}
+
+int cmp_drop(const char *path, const t_objtype *ot, char *schema, char *object, char *ddl) {
+    t_cmp_job *job = calloc(1, sizeof(t_cmp_job));
+    if (ddl == NULL || job == NULL || (job->path = strdup(path)) == NULL) {
+        logmsg(LOG_ERROR, "cmp_drop() - unable to allocate memory for job [%s]", path);
+        if (job != NULL) {
+            free(job->path);
+            free(job);
+        }
+        free(schema);
+        free(object);
+        free(ddl);
+        return EXIT_FAILURE;
+    }
+    job->ot = ot;
+    job->schema = schema;
+    job->object = object;
+    job->ddl = ddl;
+
+    if (cmp.thread_started == 0) {
+        cmp_execute_drops(job, 1);
+        cmp_job_free(job);
+        return EXIT_SUCCESS;
+    }
+
+    pthread_mutex_lock(&cmp.mutex);
+    job->updated = cmp_now();
+    job->queued = job->updated;
+    cmp.last_queued = job->updated;
+    if (cmp.tail == NULL)
+        cmp.head = job;
+    else
+        cmp.tail->next = job;
+    cmp.tail = job;
+    pthread_cond_broadcast(&cmp.cond);
+    pthread_mutex_unlock(&cmp.mutex);
+
+    logmsg(LOG_DEBUG, "cmp_drop() - queued [%s]", path);
+    return EXIT_SUCCESS;
+}
+
+void cmp_wait(const char *path) {
+    if (cmp.thread_started == 0)
+        return;
+
+    pthread_mutex_lock(&cmp.mutex);
+    if (cmp_running(path)) {
+        logmsg(LOG_DEBUG, "cmp_wait() - waiting for DDL of [%s] to be executed.", path);
+        while (cmp_running(path))
+            pthread_cond_wait(&cmp.cond, &cmp.mutex);
+    }
+    pthread_mutex_unlock(&cmp.mutex);
+}
+
+int cmp_pending(const char *path) {
+    if (cmp.thread_started == 0)
+        return 0;
+
+    pthread_mutex_lock(&cmp.mutex);
+    int pending = cmp_writing(path) || cmp_running(path);
+    for (t_cmp_job *job = cmp.head; job != NULL && !pending; job = job->next)
+        pending = (job->ddl == NULL && strcmp(job->path, path) == 0);
+    pthread_mutex_unlock(&cmp.mutex);
+    return pending;
+}
+
+int cmp_writer_open(const char *path) {
+    if (cmp.thread_started == 0)
+        return EXIT_SUCCESS;
+
+    pthread_mutex_lock(&cmp.mutex);
+    if (cmp_running(path)) {
+        logmsg(LOG_DEBUG, "cmp_writer_open() - waiting for DDL of [%s] to be executed.", path);
+        while (cmp_running(path))
+            pthread_cond_wait(&cmp.cond, &cmp.mutex);
+    }
+
+    t_cmp_writer *w = cmp.writers;
+    while (w != NULL && strcmp(w->path, path) != 0)
+        w = w->next;
+    if (w == NULL) {
+        w = calloc(1, sizeof(t_cmp_writer));
+        if (w == NULL || (w->path = strdup(path)) == NULL) {
+            logmsg(LOG_ERROR, "cmp_writer_open() - unable to allocate memory for [%s]", path);
+            free(w);
+            pthread_mutex_unlock(&cmp.mutex);
+            return EXIT_FAILURE;
+        }
+        w->next = cmp.writers;
+        cmp.writers = w;
+    }
+    w->count++;
+    pthread_mutex_unlock(&cmp.mutex);
+    return EXIT_SUCCESS;
+}
+
+void cmp_writer_close(const char *path) {
+    if (cmp.thread_started == 0)
+        return;
+
+    pthread_mutex_lock(&cmp.mutex);
+    for (t_cmp_writer **link = &cmp.writers; *link != NULL; link = &(*link)->next) {
+        t_cmp_writer *w = *link;
+        if (strcmp(w->path, path) != 0)
+            continue;
+        if (--w->count == 0) {
+            *link = w->next;
+            free(w->path);
+            free(w);
+            // DDL queued for the file may be executed now
+            pthread_cond_broadcast(&cmp.cond);
+        }
+        break;
+    }
+    pthread_mutex_unlock(&cmp.mutex);
+}
+
+int cmp_discard(const char *path) {
+    int running = 0;
+    if (cmp.thread_started == 0)
+        return 0;
+
+    pthread_mutex_lock(&cmp.mutex);
+    t_cmp_job *job = cmp_dequeue(path);
+    if (job != NULL) {
+        logmsg(LOG_DEBUG, "cmp_discard() - DDL queued for [%s] is cancelled.", path);
+        cmp_job_free(job);
+    }
+    while (cmp_running(path)) {
+        running = 1;
+        pthread_cond_wait(&cmp.cond, &cmp.mutex);
+    }
+    pthread_mutex_unlock(&cmp.mutex);
+    return running;
+}
+
+int cmp_cancel(const char *path) {
+    cmp_discard(path);
+    return cmp_created_remove(path);
+}
+
+int cmp_dropped_list(const char *dir, char ***names, int *count) {
+    size_t dir_len = strlen(dir);
+    int retval = EXIT_SUCCESS;
+    *names = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&cmp.mutex);
+    for (int pass = 0; pass < 2 && retval == EXIT_SUCCESS; pass++) {
+        for (t_cmp_job *job = (pass == 0 ? cmp.head : cmp.batch); job != NULL; job = job->next) {
+            const char *name = cmp_dir_name(job->path, dir, dir_len);
+            if (job->ddl == NULL || job->done || name == NULL)
+                continue;
+
+            char **tmp = realloc(*names, (*count + 1) * sizeof(char*));
+            if (tmp == NULL || (tmp[*count] = strdup(name)) == NULL) {
+                if (tmp != NULL)
+                    *names = tmp;
+                retval = EXIT_FAILURE;
+                break;
+            }
+            *names = tmp;
+            (*count)++;
+        }
+    }
+    pthread_mutex_unlock(&cmp.mutex);
+
+    if (retval != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "cmp_dropped_list() - unable to allocate memory for names in [%s]", dir);
+    return retval;
+}
+
+int cmp_queued() {
+    int n = 0;
+    pthread_mutex_lock(&cmp.mutex);
+    for (t_cmp_job *job = cmp.head; job != NULL; job = job->next)
+        n++;
+    for (t_cmp_job *job = cmp.batch; job != NULL; job = job->next)
+        if (job->done == 0)
+            n++;
+    pthread_mutex_unlock(&cmp.mutex);
+    return n;
+}
+
+long long cmp_completed() {
+    pthread_mutex_lock(&cmp.mutex);
+    long long n = cmp.completed;
+    pthread_mutex_unlock(&cmp.mutex);
+    return n;
+}
+
+#else
+
+int cmp_start() {
+    return EXIT_SUCCESS;
+}
+
+void cmp_stop() {
+}
+
+int cmp_enqueue(const char *path, const t_objtype *ot, char *schema, char *object, char *cache_fn) {
+    t_cmp_job job = { (char*) path, ot, schema, object, cache_fn, NULL, 0, 0, 0, 0, 0, NULL };
+    cmp_stat(cache_fn, &job.mtime, &job.size);
+    cmp_execute(&job);
+    free(schema);
+    free(object);
+    free(cache_fn);
+    return EXIT_SUCCESS;
+}
+
+int cmp_drop(const char *path, const t_objtype *ot, char *schema, char *object, char *ddl) {
+    t_cmp_job job = { (char*) path, ot, schema, object, NULL, ddl, 0, 0, 0, 0, 0, NULL };
+    cmp_execute_drops(&job, 1);
+    free(schema);
+    free(object);
+    free(ddl);
+    return EXIT_SUCCESS;
+}
+
+void cmp_wait(const char *path) {
+}
+
+int cmp_pending(const char *path) {
+    return 0;
+}
+
+int cmp_writer_open(const char *path) {
+    return EXIT_SUCCESS;
+}
+
+void cmp_writer_close(const char *path) {
+}
+
+int cmp_discard(const char *path) {
+    return 0;
+}
+
+int cmp_cancel(const char *path) {
+    return cmp_created_remove(path);
+}
+
+int cmp_dropped_list(const char *dir, char ***names, int *count) {
+    *names = NULL;
+    *count = 0;
+    return EXIT_SUCCESS;
+}
+
+int cmp_queued() {
+    return 0;
+}
+
+long long cmp_completed() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "objtype.h"
+
+/**
+ * Asynchronous execution of DDL written through the filesystem (compile queue).
+ *
+ * When a modified file is closed (fs_release), its DDL is queued and executed by a single worker
+ * thread with its own database session, so that close() returns right away. DDL queued within
+ * compilewindow= ms of each other is executed as a batch: ordered by dependencies (all_dependencies)
+ * and type (e.g. specs before bodies), executed back to back and followed by a single recompile of
+ * invalid objects. Results and errors are written to ddlfs.log (see qry_exec_ddl).
+ * DDL of a file is only executed once the file was not written for debounce= ms, if it is written
+ * again before that, only its last content is executed.
+ * Once DDL is executed, cache file of the object is rewritten from database (unless it was written
+ * again meanwhile) by the worker, using new last_ddl_time and status returned along with compile
+ * errors right after the DDL (see qry_exec_ddl). Validity of its vfs entry is updated in place
+ * (vfs_update_later). Until then, cache file (with the same content as queued DDL) is served.
+ *
+ * Files created through the filesystem (fs_create) are registered by cmp_create() and served from
+ * their cache file only, their objects are created by the first DDL written through them. If that
+ * DDL fails, the file is kept locally (so that its content is not lost) until DDL succeeds.
+ *
+ * On Windows, DDL is executed synchronously by cmp_enqueue().
+ * */
+
+/**
+ * Start worker thread. Must be called after fuse has daemonized the process (fuse init).
+ * */
+int cmp_start();
+
+/**
+ * Execute DDL which is still queued, then stop worker thread and close its database session.
+ * */
+void cmp_stop();
+
+/**
+ * Queue DDL of object (of type ot, schema and object are database names) written
+ * through file path. cache_fn is cache file of the object, DDL is submitted straight from it (mapped,
+ * see tfs_map) when it is executed and it is removed afterwards. If the file is modified by then,
+ * its DDL is skipped (it is queued again when the file is closed). DDL is not executed while the
+ * file is open for writing (see cmp_writer_open).
+ * Ownership of schema, object and cache_fn is passed to this function (they're freed
+ * once job completes, even if this function fails).
+ * */
+int cmp_enqueue(const char *path, const t_objtype *ot, char *schema, char *object, char *cache_fn);
+
+/**
+ * Queue DROP statement (ddl) of object (of type ot) whose file path was removed. DROP
+ * statements queued within compilewindow= ms are executed as a single PL/SQL block (see qry_exec_drops),
+ * before other DDL of the same batch. Ownership of schema, object and ddl is passed to this function.
+ * */
+int cmp_drop(const char *path, const t_objtype *ot, char *schema, char *object, char *ddl);
+
+/**
+ * Wait until DDL for file path is not being executed anymore. Called before object is opened
+ * (or truncated), so that its cache file is not replaced while it is being read.
+ * */
+void cmp_wait(const char *path);
+
+/**
+ * Return 1 if DDL of file path is queued or being executed, or the file is open for writing. Its cache
+ * file holds local changes meanwhile, so it must not be replaced by content fetched from database.
+ * */
+int cmp_pending(const char *path);
+
+/**
+ * Register file path as open for writing (after waiting like cmp_wait), until cmp_writer_close.
+ * DDL queued for the file is not executed meanwhile, as writes could change content while DDL
+ * is read from it. Called by fs_open (writable handles) and fs_truncate.
+ * */
+int cmp_writer_open(const char *path);
+void cmp_writer_close(const char *path);
+
+/**
+ * Cancel DDL queued for file path (and wait if it is being executed). Called when file is closed with
+ * content reverted to what was fetched from database, so that DDL of an earlier save is not executed anymore.
+ * Returns 1 if DDL of path was being executed meanwhile (database may differ from what was fetched), 0 otherwise.
+ * */
+int cmp_discard(const char *path);
+
+/**
+ * Cancel DDL queued for file path (and wait if it is being executed). Called before object
+ * is dropped. Returns 1 if path is a created file whose object was never created in database
+ * (so there's nothing to drop), 0 otherwise.
+ * */
+int cmp_cancel(const char *path);
+
+/**
+ * Number of DDL statements queued or being executed (reported in ddlfs.status).
+ * */
+int cmp_queued();
+
+/**
+ * Number of DDL statements executed (or failed) since mount, it only grows (reported in ddlfs.status).
+ * */
+long long cmp_completed();
+
+/**
+ * Register file path as created through the filesystem, its object does not exist in database yet.
+ * */
+int cmp_create(const char *path);
+
+/**
+ * Return 1 if path is registered by cmp_create() and its object was not created in database yet.
+ * */
+int cmp_created(const char *path);
+
+/**
+ * Return names of created files in directory dir (e.g. /SCHEMA/VIEW), so that they're listed even
+ * though their objects don't exist in database. Names and array must be freed by caller.
+ * */
+int cmp_created_list(const char *dir, char ***names, int *count);
+
+/**
+ * Return names of files in directory dir whose DROP is queued (or being executed), so that they're not
+ * listed even though their objects still exist in database. Names and array must be freed by caller.
+ * */
+int cmp_dropped_list(const char *dir, char ***names, int *count);
@@ -30,10 +30,18 @@ static struct fuse_opt ddlfs_opts[] = {
     MYFS_OPT("temppath=%s", temppath,  1),
     MYFS_OPT("filesize=%d", filesize,  1),
     MYFS_OPT("pdb=%s",      pdb,       1),
+    MYFS_OPT("prefetch=%d", prefetch,  1),
+    MYFS_OPT("stream=%d",   stream,    1),
+    MYFS_OPT("compilewindow=%d", compilewindow, 1),
+    MYFS_OPT("debounce=%d", debounce,  1),
     MYFS_OPT("dbro",        dbro,      1),
     MYFS_OPT("dbrw",        dbro,      0),
     MYFS_OPT("keepcache",   keepcache, 1),
     MYFS_OPT("nokeepcache", keepcache, 0),
+    MYFS_OPT("sharedcache",   sharedcache, 1),
+    MYFS_OPT("nosharedcache", sharedcache, 0),
+    MYFS_OPT("dedup",       dedup,     1),
+    MYFS_OPT("nodedup",     dedup,     0),
 
     FUSE_OPT_KEY("-h",      KEY_HELP),
     FUSE_OPT_KEY("--help",  KEY_HELP),
@@ -73,6 +81,11 @@ static int mandatory_parameter(const char *value, const char *parameter) {
 struct fuse_args parse_arguments(int argc, char *argv[]) {
 
     g_conf.keepcache = -1;
+    g_conf.dedup = -1;
+    g_conf.prefetch = -1;
+    g_conf.stream = -1;
+    g_conf.compilewindow = -1;
+    g_conf.debounce = -1;
 	
 	g_conf.mountpoint = calloc(1000, sizeof(char));
 	g_conf.temppath	= calloc(1000, sizeof(char));
@@ -84,6 +97,7 @@ struct fuse_args parse_arguments(int argc, char *argv[]) {
 	g_conf.pdb = calloc(130, sizeof(char));
 	g_conf.loglevel = calloc(15, sizeof(char));
 	g_conf._temppath = calloc(1000, sizeof(char));
+	g_conf._dbid = calloc(100, sizeof(char));
 	
     struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
 	if (g_conf.mountpoint == NULL ||
@@ -95,7 +109,8 @@ struct fuse_args parse_arguments(int argc, char *argv[]) {
 		g_conf.schemas == NULL ||
 		g_conf.pdb == NULL ||
 		g_conf.loglevel == NULL ||
-		g_conf._temppath == NULL) {
+		g_conf._temppath == NULL ||
+		g_conf._dbid == NULL) {
 		
 		logmsg(LOG_ERROR, "Unable to allocate memory for configuration entries (g_conf).");
 		return args;
@@ -127,6 +142,35 @@ struct fuse_args parse_arguments(int argc, char *argv[]) {
     if (g_conf.keepcache == -1)
         g_conf.keepcache = 0;
 
+    if (g_conf.dedup == -1)
+        g_conf.dedup = 0;
+
+#ifndef _MSC_VER
+    if (g_conf.prefetch < 0)
+        g_conf.prefetch = 0;
+#else
+    g_conf.prefetch = 0; // not implemented on Windows
+#endif
+
+#ifndef _MSC_VER
+    if (g_conf.stream < 0)
+        g_conf.stream = 0;
+#else
+    g_conf.stream = 0; // not implemented on Windows
+#endif
+
+    if (g_conf.compilewindow < 0)
+        g_conf.compilewindow = 200;
+
+    if (g_conf.debounce < 0)
+        g_conf.debounce = 500;
+
+    if (g_conf.sharedcache == 1 && g_conf.keepcache == 0) {
+        // other mounts of the same database may still be using this cache
+        logmsg(LOG_INFO, "Parameter 'sharedcache' implies 'keepcache', cache won't be removed on umount.");
+        g_conf.keepcache = 1;
+    }
+
     if (g_conf.userrole[0] != '\0') {
         if (strcmp(g_conf.userrole, "SYSDBA") != 0 && strcmp(g_conf.userrole, "SYSOPER") != 0) {
             logmsg(LOG_ERROR, "Parameter userrole can only have the value of 'SYSDBA' or 'SYSOPER' if it is set.");
@@ -171,6 +215,12 @@ struct fuse_args parse_arguments(int argc, char *argv[]) {
     logmsg(LOG_DEBUG, ".. temppath : [%s]", g_conf.temppath);
     logmsg(LOG_DEBUG, ".. filesize : [%d]", g_conf.filesize);
     logmsg(LOG_DEBUG, ".. keepcache: [%d]", g_conf.keepcache);
+    logmsg(LOG_DEBUG, ".. sharedcache: [%d]", g_conf.sharedcache);
+    logmsg(LOG_DEBUG, ".. dedup    : [%d]", g_conf.dedup);
+    logmsg(LOG_DEBUG, ".. prefetch : [%d]", g_conf.prefetch);
+    logmsg(LOG_DEBUG, ".. stream   : [%d]", g_conf.stream);
+    logmsg(LOG_DEBUG, ".. compilewindow: [%d]", g_conf.compilewindow);
+    logmsg(LOG_DEBUG, ".. debounce : [%d]", g_conf.debounce);
     logmsg(LOG_DEBUG, ".. pdb      : [%s]", g_conf.pdb);
     logmsg(LOG_DEBUG, ".. dbro     : [%d]", g_conf.dbro);
     logmsg(LOG_DEBUG, ".");
@@ -14,20 +14,31 @@ struct s_global_config {
     char *pdb;
     int   dbro;
     int   keepcache;
+    int   sharedcache;
+    int   dedup;
     int   filesize;
+    int   prefetch;   // number of background prefetch workers (database sessions), 0=disabled
+    int   stream;     // number of workers fetching objects which are being read (database sessions), 0=disabled
+    int   compilewindow; // ms, DDL written within this interval is executed as a single batch
+    int   debounce;      // ms, DDL of a file is executed once it was not written for this long
     char *loglevel;
 
     int    _temppath_reused;
+    int    _temppath_ready;   // 1=cache directory was created (or reused) by tfs_mkdir
     char  *_temppath;
     int    _server_version;
     int    _isdba;
     int    _has_catalog_role;
+    char  *_dbid;             // "<dbid>.<con_dbid>" identity of the database (only set if sharedcache=1)
 #ifndef _MSC_VER
     pid_t  _mount_pid;
+    pid_t  _prev_mount_pid;   // mount whose cache entries this one continues (see dbr_refresh_prepare), 0=none
 #else
 	int _mount_pid;
+	int _prev_mount_pid;
 #endif
     time_t _mount_stamp;
+    time_t _prev_mount_stamp;
 };
 
 extern struct s_global_config g_conf;
@@ -1,12 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>           /* Definition of AT_* constants */
 #ifndef _MSC_VER
 	#include <unistd.h>
 	#include <dirent.h>
+	#include <pthread.h>
 #else
 	#pragma warning(disable:4996)
 #endif
@@ -17,16 +19,128 @@
 #include "config.h"
 #include "tempfs.h"
 #include "util.h"
+#include "vfs.h"
+#include "dbro_refresh.h"
 
 
-static int dbr_refresh_object(const char *schema,
-                              const char *ora_type,
-                              const char *object,
-                              time_t last_ddl_time) {    
+#define DBR_THREADS 4         // threads validating cache files
+#define DBR_ROWS_INITIAL 4096
+#define DBR_WM_FILE "ddlfs.wm" // watermark of cache contents, see dbr_wm_read()
+#define DBR_WM_VERSION 1
+
+// one object from all_objects
+typedef struct {
+    char   *schema;
+    char   *type;    // oracle type, e.g. PACKAGE BODY
+    char   *object;
+    time_t  last_ddl_time;
+    char   *fname;   // cache file name
+    int     verified;
+} t_dbr_row;
+
+typedef struct {
+    t_dbr_row *rows;
+    int        count;
+    int        first;
+    int        step;
+} t_dbr_part;
+
+typedef struct {
+    t_dbr_row *rows;
+    int        count;
+    int        capacity;
+} t_dbr_rows;
+
+// summary of objects in one schema, used to detect dropped, created and renamed objects without listing them
+typedef struct {
+    char *schema;
+    int   count;
+    char  names_hash[50]; // sum of ora_hash(object_type.object_name) of all objects
+    int   full;           // 1=schema is revalidated as a whole (it differs from watermark or is gone)
+} t_dbr_schema;
+
+// high-water mark of cache contents, persisted in DBR_WM_FILE by each refresh and used by the next one
+typedef struct {
+    long long     mount_pid;   // mount identity stamped into cache entries (see tfs_quick_validate)
+    long long     mount_stamp;
+    char          mark[25];    // max(last_ddl_time) of mounted objects, yyyy-mm-dd hh24:mi:ss
+    t_dbr_schema *schemas;
+    int           count;
+} t_dbr_wm;
+
+// verified cache files (sorted), used by dbr_delete_obsolete
+static char **dbr_verified = NULL;
+static int dbr_verified_count = 0;
+
+// schemas whose obsolete cache files are removed by dbr_delete_obsolete, NULL=all of them
+static char **dbr_sweep = NULL;
+static int dbr_sweep_count = 0;
+
+// 1=outdated cache files are removed right away (they are still stamped as valid when watermark was used)
+static int dbr_discard = 0;
+
+// watermark of previous mount, read by dbr_refresh_prepare
+static t_dbr_wm dbr_prev = { 0 };
+static int dbr_incremental = 0;
+
+// progress, see dbr_progress (validation runs in background while requests are served, see startup.c)
+#ifndef _MSC_VER
+static pthread_mutex_t dbr_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static int dbr_done = 0;
+static int dbr_total = 0;
+static int dbr_cancelled = 0;
+
+// add done to number of validated rows, return 1 if validation was cancelled
+static int dbr_progress_step(int done) {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&dbr_mutex);
+#endif
+    dbr_done += done;
+    int cancelled = dbr_cancelled;
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&dbr_mutex);
+#endif
+    return cancelled;
+}
+
+static void dbr_progress_total(int total) {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&dbr_mutex);
+#endif
+    dbr_done = 0;
+    dbr_total = total;
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&dbr_mutex);
+#endif
+}
+
+void dbr_progress(int *done, int *total) {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&dbr_mutex);
+#endif
+    *done = dbr_done;
+    *total = dbr_total;
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&dbr_mutex);
+#endif
+}
+
+void dbr_refresh_cancel() {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&dbr_mutex);
+#endif
+    dbr_cancelled = 1;
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&dbr_mutex);
+#endif
+}
+
+static int dbr_refresh_object(t_dbr_row *row) {
     char object_with_suffix[300];
 
     // convert oracle type to filesystem type
-    char *fs_type = strdup(ora_type);
+    char *fs_type = strdup(row->type);
     if (fs_type == NULL) {
         logmsg(LOG_ERROR, "dbr_refresh_object(): unable to allocate memory for ora_type");
         return EXIT_FAILURE;
@@ -35,7 +149,7 @@ static int dbr_refresh_object(const char *schema,
     
     // get suffix based on type
     char *suffix = NULL;
-    if (str_suffix(&suffix, ora_type) != EXIT_SUCCESS) {
+    if (str_suffix(&suffix, fs_type) != EXIT_SUCCESS) {
         logmsg(LOG_ERROR, "dbr_refresh_object(): unable to determine file suffix");
         if (suffix != NULL)
             free(suffix);
@@ -43,14 +157,11 @@ static int dbr_refresh_object(const char *schema,
             free(fs_type);
         return EXIT_FAILURE;
     }
-    snprintf(object_with_suffix, 299, "%s%s", object, suffix);
+    snprintf(object_with_suffix, 299, "%s%s", row->object, suffix);
     
     // get cache filename
-    char *fname = NULL;
-    if (qry_object_fname(schema, fs_type, object_with_suffix, &fname) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "dbr_refresh_object(): unable to determine cache filename for [%s] [%s].[%s]", ora_type, schema, object_with_suffix);
-        if (fname != NULL)
-            free(fname);
+    if (qry_object_fname(row->schema, fs_type, object_with_suffix, &row->fname) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "dbr_refresh_object(): unable to determine cache filename for [%s] [%s].[%s]", row->type, row->schema, object_with_suffix);
         if (suffix != NULL)
             free(suffix);
         if (fs_type != NULL)
@@ -58,27 +169,60 @@ static int dbr_refresh_object(const char *schema,
         return EXIT_FAILURE;
     }
     
-    // if cache file is already up2date
-    if (tfs_validate2(fname, last_ddl_time) == EXIT_SUCCESS) {
-        // then mark it as verified by this mount
-        if (tfs_setldt(fname, last_ddl_time) != EXIT_SUCCESS) {
-            logmsg(LOG_ERROR, "dbr_refresh_object(): unable to mark [%s] [%s].[%s] as verified by this mount.", ora_type, schema, object);
-            if (fname != NULL)
-                free(fname);
-            if (suffix != NULL)
-                free(suffix);
-            if (fs_type != NULL)
-                free(fs_type);
-            return EXIT_FAILURE;
-        }
-    }
+    // if cache file is already up2date, then mark it as verified by this mount
+    if (tfs_revalidate(row->fname, row->last_ddl_time, dbr_discard) == EXIT_SUCCESS)
+        row->verified = 1;
     
-    free(fname);
     free(suffix);
     free(fs_type);
     return EXIT_SUCCESS;
 }
 
+static void* dbr_refresh_part(void *arg) {
+    t_dbr_part *part = (t_dbr_part*) arg;
+    int cancelled = 0;
+    for (int i = part->first; i < part->count && cancelled == 0; i += part->step) {
+        dbr_refresh_object(&part->rows[i]);
+        cancelled = dbr_progress_step(1);
+    }
+    return NULL;
+}
+
+// validate cache files of all rows, spread over DBR_THREADS threads (validation is pure local i/o)
+static void dbr_refresh_rows(t_dbr_row *rows, int count) {
+    t_dbr_part parts[DBR_THREADS];
+    for (int i = 0; i < DBR_THREADS; i++) {
+        parts[i].rows = rows;
+        parts[i].count = count;
+        parts[i].first = i;
+        parts[i].step = DBR_THREADS;
+    }
+
+#ifndef _MSC_VER
+    pthread_t threads[DBR_THREADS];
+    int started[DBR_THREADS] = { 0 };
+    for (int i = 1; i < DBR_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, dbr_refresh_part, &parts[i]) == 0)
+            started[i] = 1;
+        else {
+            logmsg(LOG_ERROR, "dbr_refresh_rows() - unable to start thread %d, its part is validated by main thread.", i);
+            dbr_refresh_part(&parts[i]);
+        }
+    }
+    dbr_refresh_part(&parts[0]);
+    for (int i = 1; i < DBR_THREADS; i++)
+        if (started[i] == 1)
+            pthread_join(threads[i], NULL);
+#else
+    for (int i = 0; i < DBR_THREADS; i++)
+        dbr_refresh_part(&parts[i]);
+#endif
+}
+
+static int dbr_strcmp(const void *a, const void *b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
 static int dbr_delete_obsolete_entry(const char* fn) {
     size_t name_len = strlen(fn);
     if (name_len < 5) // ignored files are succeess because failure breaks the loop
@@ -88,24 +232,46 @@ static int dbr_delete_obsolete_entry(const char* fn) {
     if (strcmp(suffix, ".tmp") != 0)
         return EXIT_SUCCESS;
 
+    // cache file of schema which is known not to have changed
+    if (dbr_sweep != NULL) {
+        int i = 0;
+        for (; i < dbr_sweep_count; i++) {
+            size_t schema_len = strlen(dbr_sweep[i]);
+            if (strncmp(fn, "ddlfs-", 6) == 0 && strncmp(fn+6, dbr_sweep[i], schema_len) == 0 && fn[6+schema_len] == '.')
+                break;
+        }
+        if (i == dbr_sweep_count)
+            return EXIT_SUCCESS;
+    }
+
     char cache_fn[4096];
     snprintf(cache_fn, 4095, "%s%s%s", g_conf._temppath, PATH_SEP, fn);
 
-    time_t last_ddl_time = 0;
-    time_t mount_stamp = 0;
-    pid_t mount_pid = 0;
-    if (tfs_getldt(cache_fn, &last_ddl_time, &mount_pid, &mount_stamp) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "dbr_delete_obsolete() - tfs_getldt returned error");        
-        return EXIT_FAILURE;
-    }
+    // not verified by this mount, so it does not exist (in this version) anymore
+    const char *key = cache_fn;
+    if (bsearch(&key, dbr_verified, dbr_verified_count, sizeof(char*), dbr_strcmp) != NULL)
+        return EXIT_SUCCESS;
 
-    if ((mount_pid != g_conf._mount_pid) || (mount_stamp != g_conf._mount_stamp)) {
-        if (tfs_rmfile(cache_fn) != EXIT_SUCCESS)
-            return EXIT_FAILURE;
+    // unless it was fetched by this mount meanwhile (requests and workers are served while cache is validated),
+    // or it was removed or replaced by them already
+    int retval = EXIT_SUCCESS;
+    time_t last_ddl_time = 0, mount_stamp = 0;
+    pid_t mount_pid = 0;
+    struct stat st;
+    tfs_lock(cache_fn);
+    if (stat(cache_fn, &st) != 0) {
+        // already removed
+    } else if (tfs_getldt(cache_fn, &last_ddl_time, &mount_pid, &mount_stamp) == EXIT_SUCCESS &&
+               mount_pid == g_conf._mount_pid && mount_stamp == g_conf._mount_stamp) {
+        logmsg(LOG_DEBUG, "dbr_delete_obsolete() - cache file [%s] was fetched by this mount, it is kept", cache_fn);
+    } else if (tfs_rmfile(cache_fn) != EXIT_SUCCESS && stat(cache_fn, &st) == 0) {
+        retval = EXIT_FAILURE;
+    } else {
         logmsg(LOG_DEBUG, "dbr_delete_obsolete() - removed obsolete cache file [%s]", cache_fn);
     }
-    
-    return EXIT_SUCCESS;
+    tfs_unlock(cache_fn);
+
+    return retval;
 }
 
 #ifdef _MSC_VER
@@ -164,7 +330,6 @@ static int dbr_delete_obsolete() {
         const char* fn = dir_entry->d_name;
         if (dbr_delete_obsolete_entry(fn) != EXIT_SUCCESS) {
             logmsg(LOG_ERROR, "dbr_delete_obsolete() - entry function returned error, aborting.");
-            closedir(dir);
             break;
         }
 
@@ -175,13 +340,8 @@ static int dbr_delete_obsolete() {
 }
 #endif
 
-int dbr_refresh_cache() {
-    int retval = EXIT_SUCCESS;
-    char query[] =
-"select o.owner, o.object_type, o.object_name, \
- to_char(o.last_ddl_time, 'yyyy-mm-dd hh24:mi:ss') as last_ddl_time\
- from all_objects o\
- where generated='N'\
+static const char dbr_objects_where[] =
+" generated='N'\
  and (o.object_type != 'TYPE' or o.subobject_name IS NULL)\
  and object_type IN (\
  'TABLE',\
@@ -195,25 +355,446 @@ int dbr_refresh_cache() {
  'TYPE BODY',\
  'JAVA SOURCE')";
 
+static void dbr_wm_free(t_dbr_wm *wm) {
+    for (int i = 0; i < wm->count; i++)
+        free(wm->schemas[i].schema);
+    free(wm->schemas);
+    wm->schemas = NULL;
+    wm->count = 0;
+}
+
+static t_dbr_schema* dbr_wm_find(const t_dbr_wm *wm, const char *schema) {
+    for (int i = 0; i < wm->count; i++)
+        if (strcmp(wm->schemas[i].schema, schema) == 0)
+            return &wm->schemas[i];
+    return NULL;
+}
+
+static int dbr_wm_add(t_dbr_wm *wm, const char *schema, int count, const char *names_hash) {
+    t_dbr_schema *tmp = realloc(wm->schemas, (wm->count+1) * sizeof(t_dbr_schema));
+    if (tmp == NULL) {
+        logmsg(LOG_ERROR, "dbr_wm_add() - unable to allocate memory for %d schemas", wm->count+1);
+        return EXIT_FAILURE;
+    }
+    wm->schemas = tmp;
+
+    t_dbr_schema *entry = &wm->schemas[wm->count];
+    entry->schema = strdup(schema);
+    if (entry->schema == NULL) {
+        logmsg(LOG_ERROR, "dbr_wm_add() - unable to allocate memory for schema [%s]", schema);
+        return EXIT_FAILURE;
+    }
+    entry->count = count;
+    snprintf(entry->names_hash, sizeof(entry->names_hash), "%s", names_hash);
+    entry->full = 0;
+    wm->count++;
+    return EXIT_SUCCESS;
+}
+
+static void dbr_wm_fn(char *fn, size_t fn_len) {
+    snprintf(fn, fn_len, "%s%s%s", g_conf._temppath, PATH_SEP, DBR_WM_FILE);
+}
+
+/**
+ * Read watermark left by previous refresh. Watermark file is removed, so that a refresh
+ * which is interrupted before writing a new one is never trusted by the next mount.
+ * */
+static int dbr_wm_read(t_dbr_wm *wm) {
+    char fn[4096];
+    char line[1024];
+    int version = 0;
+    int retval = EXIT_SUCCESS;
+
+    dbr_wm_fn(fn, sizeof(fn));
+    FILE *fp = fopen(fn, "r");
+    if (fp == NULL) {
+        logmsg(LOG_DEBUG, "dbr_wm_read() - no watermark [%s] found.", fn);
+        return EXIT_FAILURE;
+    }
+
+    if (fgets(line, sizeof(line), fp) == NULL || sscanf(line, "ddlfs-wm %d", &version) != 1 || version != DBR_WM_VERSION ||
+        fgets(line, sizeof(line), fp) == NULL || sscanf(line, "%lld %lld", &wm->mount_pid, &wm->mount_stamp) != 2 ||
+        fgets(line, sizeof(line), fp) == NULL || strlen(line) < 20) {
+        retval = EXIT_FAILURE;
+    } else {
+        line[strcspn(line, "\r\n")] = '\0';
+        snprintf(wm->mark, sizeof(wm->mark), "%s", line);
+    }
+
+    // one line per schema: <count> <names_hash> <schema>
+    while (retval == EXIT_SUCCESS && fgets(line, sizeof(line), fp) != NULL) {
+        int count = 0, pos = 0;
+        char names_hash[50];
+        line[strcspn(line, "\r\n")] = '\0';
+        if (sscanf(line, "%d %49s %n", &count, names_hash, &pos) != 2 || pos == 0 || line[pos] == '\0') {
+            retval = EXIT_FAILURE;
+            break;
+        }
+        retval = dbr_wm_add(wm, line+pos, count, names_hash);
+    }
+
+    fclose(fp);
+    if (remove(fn) != 0)
+        logmsg(LOG_ERROR, "dbr_wm_read() - unable to remove watermark [%s]: %d - %s", fn, errno, strerror(errno));
+
+    if (retval != EXIT_SUCCESS) {
+        logmsg(LOG_INFO, "Ignoring invalid cache watermark [%s]", fn);
+        dbr_wm_free(wm);
+    }
+    return retval;
+}
+
+static int dbr_wm_write(const t_dbr_wm *wm) {
+    char fn[4096];
+    char tmp_fn[4200];
+
+    dbr_wm_fn(fn, sizeof(fn));
+    snprintf(tmp_fn, sizeof(tmp_fn), "%s.new", fn);
+
+    FILE *fp = fopen(tmp_fn, "w");
+    if (fp == NULL) {
+        logmsg(LOG_ERROR, "dbr_wm_write() - unable to open [%s]: %d - %s", tmp_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    long long mount_pid, mount_stamp;
+    dbr_generation(&mount_pid, &mount_stamp);
+    fprintf(fp, "ddlfs-wm %d\n%lld %lld\n%s\n", DBR_WM_VERSION, mount_pid, mount_stamp, wm->mark);
+    for (int i = 0; i < wm->count; i++)
+        fprintf(fp, "%d %s %s\n", wm->schemas[i].count, wm->schemas[i].names_hash, wm->schemas[i].schema);
+
+    if (fclose(fp) != 0) {
+        logmsg(LOG_ERROR, "dbr_wm_write() - unable to write [%s]: %d - %s", tmp_fn, errno, strerror(errno));
+        remove(tmp_fn);
+        return EXIT_FAILURE;
+    }
+
+    remove(fn); // rename does not replace existing file on Windows
+    if (rename(tmp_fn, fn) != 0) {
+        logmsg(LOG_ERROR, "dbr_wm_write() - unable to rename [%s] to [%s]: %d - %s", tmp_fn, fn, errno, strerror(errno));
+        remove(tmp_fn);
+        return EXIT_FAILURE;
+    }
+
+    logmsg(LOG_DEBUG, "dbr_wm_write() - watermark [%s] written, mark=[%s], schemas=%d", fn, wm->mark, wm->count);
+    return EXIT_SUCCESS;
+}
+
+// query per-schema summary of mounted objects (this is a single aggregate query, no objects are listed)
+static int dbr_summary(const char *filter, char **binds, int bind_count, t_dbr_wm *wm) {
+    int retval = EXIT_SUCCESS;
+    const char *query_fmt =
+"select o.owner, count(*),\
+ to_char(sum(ora_hash(o.object_type || '.' || o.object_name))) as names_hash,\
+ to_char(max(o.last_ddl_time), 'yyyy-mm-dd hh24:mi:ss') as last_ddl_time\
+ from all_objects o\
+ where %s\
+ and %s\
+ group by o.owner";
+
+    size_t query_len = strlen(query_fmt) + strlen(dbr_objects_where) + strlen(filter) + 1;
+    char *query = malloc(query_len);
+    if (query == NULL) {
+        logmsg(LOG_ERROR, "dbr_summary() - unable to allocate memory for query");
+        return EXIT_FAILURE;
+    }
+    snprintf(query, query_len, query_fmt, dbr_objects_where, filter);
     ora_replace_all_dba(query);
 
-    ORA_STMT_PREPARE(dbr_refresh_state);
-    ORA_STMT_DEFINE_STR_I(dbr_refresh_state, 1, schema, 300);
-    ORA_STMT_DEFINE_STR_I(dbr_refresh_state, 2, type, 300);
-    ORA_STMT_DEFINE_STR_I(dbr_refresh_state, 3, object, 300);
-    ORA_STMT_DEFINE_STR_I(dbr_refresh_state, 4, last_ddl_time, 25);
-    ORA_STMT_EXECUTE(dbr_refresh_state, 0);
+    strcpy(wm->mark, "1990-01-01 03:00:01");
+
+    ORA_STMT_PREPARE(dbr_summary);
+    ORA_STMT_DEFINE_STR_I(dbr_summary, 1, schema, 300);
+    ORA_STMT_DEFINE_INT_I(dbr_summary, 2, count);
+    ORA_STMT_DEFINE_STR_I(dbr_summary, 3, names_hash, 50);
+    ORA_STMT_DEFINE_STR_I(dbr_summary, 4, last_ddl_time, 25);
+    for (int i = 0; i < bind_count; i++) {
+        int o_bnd_idx = i+1;
+        ORA_STMT_BIND_STR(dbr_summary, o_bnd_idx, binds[i]);
+    }
+    ORA_STMT_EXECUTE(dbr_summary, 0);
+
     while (ORA_STMT_FETCH) {
-        dbr_refresh_object(
-            ORA_NVL(schema, "_UNKNOWN_SCHEMA_"),
-            ORA_NVL(type, "_UNKNOWN_TYPE_"),
-            ORA_NVL(object, "_UNKNOWN_OBJECT_"),
-            utl_str2time(ORA_NVL(last_ddl_time, "1990-01-01 03:00:01")));
+        if (dbr_wm_add(wm, ORA_NVL(schema, "_UNKNOWN_SCHEMA_"), ORA_NVL(count, 0), ORA_NVL(names_hash, "0")) != EXIT_SUCCESS) {
+            retval = EXIT_FAILURE;
+            goto dbr_summary_cleanup;
+        }
+        if (i_last_ddl_time == 0 && strcmp(ORA_VAL(last_ddl_time), wm->mark) > 0)
+            strcpy(wm->mark, ORA_VAL(last_ddl_time));
+    }
+
+dbr_summary_cleanup:
+    ORA_STMT_FREE;
+    free(query);
+    return retval;
+}
+
+/**
+ * Fetch objects matching cond (in addition to dbr_objects_where) into rows.
+ * Objects of schemas which are revalidated as a whole (full=1 in skip) are ignored.
+ * */
+static int dbr_fetch(const char *cond, char **binds, int bind_count, const t_dbr_wm *skip, t_dbr_rows *rows) {
+    int retval = EXIT_SUCCESS;
+    const char *query_fmt =
+"select o.owner, o.object_type, o.object_name, \
+ " ORA_EPOCH("o.last_ddl_time") " as last_ddl_time\
+ from all_objects o\
+ where %s\
+ and %s";
+
+    size_t query_len = strlen(query_fmt) + strlen(dbr_objects_where) + strlen(cond) + 1;
+    char *query = malloc(query_len);
+    if (query == NULL) {
+        logmsg(LOG_ERROR, "dbr_fetch() - unable to allocate memory for query");
+        return EXIT_FAILURE;
+    }
+    snprintf(query, query_len, query_fmt, dbr_objects_where, cond);
+    ora_replace_all_dba(query);
+
+    ORA_STMT_PREPARE(dbr_fetch);
+    ORA_STMT_DEFINE_STR_I(dbr_fetch, 1, schema, 300);
+    ORA_STMT_DEFINE_STR_I(dbr_fetch, 2, type, 300);
+    ORA_STMT_DEFINE_STR_I(dbr_fetch, 3, object, 300);
+    ORA_STMT_DEFINE_TIME_I(dbr_fetch, 4, last_ddl_time);
+    for (int i = 0; i < bind_count; i++) {
+        int o_bnd_idx = i+1;
+        ORA_STMT_BIND_STR(dbr_fetch, o_bnd_idx, binds[i]);
     }
+    ORA_STMT_EXECUTE(dbr_fetch, 0);
+
+    // fetch everything first, so that validation of cache files can be done in parallel
+    while (ORA_STMT_FETCH) {
+        if (skip != NULL) {
+            t_dbr_schema *summary = dbr_wm_find(skip, ORA_NVL(schema, "_UNKNOWN_SCHEMA_"));
+            if (summary != NULL && summary->full == 1)
+                continue;
+        }
 
-    dbr_delete_obsolete();
+        if (rows->count == rows->capacity) {
+            int capacity = (rows->capacity == 0 ? DBR_ROWS_INITIAL : rows->capacity*2);
+            t_dbr_row *tmp = realloc(rows->rows, capacity * sizeof(t_dbr_row));
+            if (tmp == NULL) {
+                logmsg(LOG_ERROR, "dbr_fetch() - unable to allocate memory for %d rows", capacity);
+                retval = EXIT_FAILURE;
+                goto dbr_fetch_cleanup;
+            }
+            rows->rows = tmp;
+            rows->capacity = capacity;
+        }
 
-dbr_refresh_state_cleanup:
+        t_dbr_row *row = &rows->rows[rows->count];
+        row->schema = strdup(ORA_NVL(schema, "_UNKNOWN_SCHEMA_"));
+        row->type = strdup(ORA_NVL(type, "_UNKNOWN_TYPE_"));
+        row->object = strdup(ORA_NVL(object, "_UNKNOWN_OBJECT_"));
+        row->last_ddl_time = utl_epoch2time(ORA_NVL(last_ddl_time, 631162801LL)); // 1990-01-01 03:00:01
+        row->fname = NULL;
+        row->verified = 0;
+        rows->count++;
+        if (row->schema == NULL || row->type == NULL || row->object == NULL) {
+            logmsg(LOG_ERROR, "dbr_fetch() - unable to allocate memory for row %d", rows->count);
+            retval = EXIT_FAILURE;
+            goto dbr_fetch_cleanup;
+        }
+    }
+
+dbr_fetch_cleanup:
     ORA_STMT_FREE;
+    free(query);
+    return retval;
+}
+
+/**
+ * Compare current summary (now) with watermark (prev) and fetch objects which have to be revalidated:
+ * those changed since watermark and all objects of schemas whose set of objects has changed.
+ * */
+static int dbr_fetch_incremental(const char *filter, char **binds, int bind_count, t_dbr_wm *prev, t_dbr_wm *now, t_dbr_rows *rows) {
+    // objects were dropped, created or renamed
+    for (int i = 0; i < now->count; i++) {
+        t_dbr_schema *old = dbr_wm_find(prev, now->schemas[i].schema);
+        if (old == NULL || old->count != now->schemas[i].count || strcmp(old->names_hash, now->schemas[i].names_hash) != 0)
+            now->schemas[i].full = 1;
+    }
+
+    // schema is gone
+    for (int i = 0; i < prev->count; i++)
+        prev->schemas[i].full = (dbr_wm_find(now, prev->schemas[i].schema) == NULL ? 1 : 0);
+
+    // changed since watermark (objects changed within the same second as mark are included as well)
+    size_t cond_len = strlen(filter) + 100;
+    char *cond = malloc(cond_len);
+    if (cond == NULL) {
+        logmsg(LOG_ERROR, "dbr_fetch_incremental() - unable to allocate memory for condition");
+        return EXIT_FAILURE;
+    }
+    snprintf(cond, cond_len, "%s and o.last_ddl_time >= to_date(:bind_mark, 'yyyy-mm-dd hh24:mi:ss')", filter);
+    binds[bind_count] = prev->mark;
+    int retval = dbr_fetch(cond, binds, bind_count+1, now, rows);
+    free(cond);
+    if (retval != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    logmsg(LOG_DEBUG, "dbr_fetch_incremental() - %d objects changed since [%s]", rows->count, prev->mark);
+
+    // directory listings (loaded from snapshot of previous mount) with changed objects
+    for (int i = 0; i < rows->count; i++) {
+        char *fs_type = strdup(rows->rows[i].type);
+        if (fs_type == NULL || utl_ora2fstype(&fs_type) != EXIT_SUCCESS) {
+            free(fs_type);
+            return EXIT_FAILURE;
+        }
+        vfs_invalidate_later(rows->rows[i].schema, fs_type);
+        free(fs_type);
+    }
+    for (int i = 0; i < prev->count; i++)
+        if (prev->schemas[i].full == 1)
+            vfs_invalidate_later(prev->schemas[i].schema, NULL);
+
+    for (int i = 0; i < now->count; i++) {
+        if (now->schemas[i].full == 0)
+            continue;
+        vfs_invalidate_later(now->schemas[i].schema, NULL);
+        logmsg(LOG_DEBUG, "dbr_fetch_incremental() - objects of [%s] have changed, revalidating all of them", now->schemas[i].schema);
+        if (dbr_fetch("o.owner = :bind_owner", &now->schemas[i].schema, 1, NULL, rows) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// collect schemas (fully revalidated or gone) whose obsolete cache files must be removed
+static int dbr_sweep_schemas(const t_dbr_wm *prev, const t_dbr_wm *now) {
+    dbr_sweep = malloc((prev->count + now->count + 1) * sizeof(char*));
+    if (dbr_sweep == NULL) {
+        logmsg(LOG_ERROR, "dbr_sweep_schemas() - unable to allocate memory");
+        return EXIT_FAILURE;
+    }
+    dbr_sweep_count = 0;
+    for (int i = 0; i < now->count; i++)
+        if (now->schemas[i].full == 1)
+            dbr_sweep[dbr_sweep_count++] = now->schemas[i].schema;
+    for (int i = 0; i < prev->count; i++)
+        if (prev->schemas[i].full == 1)
+            dbr_sweep[dbr_sweep_count++] = prev->schemas[i].schema;
+    return EXIT_SUCCESS;
+}
+
+void dbr_generation(long long *mount_pid, long long *mount_stamp) {
+    // entries of continued mount are still stamped by it, those (re)validated by this mount are checked by last_ddl_time next time
+    if (g_conf._prev_mount_pid != 0) {
+        *mount_pid = (long long) g_conf._prev_mount_pid;
+        *mount_stamp = (long long) g_conf._prev_mount_stamp;
+    } else {
+        *mount_pid = (long long) g_conf._mount_pid;
+        *mount_stamp = (long long) g_conf._mount_stamp;
+    }
+}
+
+int dbr_refresh_prepare() {
+    // watermark is not used with sharedcache, its entries are stamped by many mounts
+    if (g_conf._temppath_reused == 0 || g_conf.sharedcache == 1 || dbr_wm_read(&dbr_prev) != EXIT_SUCCESS)
+        return EXIT_SUCCESS;
+
+    // this mount continues the previous one, so that entries which have not changed since are valid without touching them
+    g_conf._prev_mount_pid = (pid_t) dbr_prev.mount_pid;
+    g_conf._prev_mount_stamp = (time_t) dbr_prev.mount_stamp;
+    dbr_incremental = 1;
+    logmsg(LOG_DEBUG, "dbr_refresh_prepare() - continuing mount %lld.%lld, mark=[%s]", dbr_prev.mount_pid, dbr_prev.mount_stamp, dbr_prev.mark);
+    return EXIT_SUCCESS;
+}
+
+int dbr_refresh_cache() {
+    int retval = EXIT_SUCCESS;
+    char *filter = NULL;
+    char *binds[QRY_SCHEMAS_MAX*2+1]; // +1 for watermark
+    int bind_count = 0;
+    int incremental = dbr_incremental;
+    t_dbr_wm prev = dbr_prev;
+    t_dbr_wm now = { 0 };
+    t_dbr_rows rows = { NULL, 0, 0 };
+
+    memset(&dbr_prev, 0, sizeof(t_dbr_wm));
+    dbr_incremental = 0;
+
+    // only mounted schemas
+    if (qry_schemas_filter("o.owner", &filter, binds, &bind_count) != EXIT_SUCCESS) {
+        dbr_wm_free(&prev);
+        return EXIT_FAILURE;
+    }
+
+    if (dbr_summary(filter, binds, bind_count, &now) != EXIT_SUCCESS) {
+        retval = EXIT_FAILURE;
+        goto dbr_refresh_cache_cleanup;
+    }
+
+    // new cache, there is nothing to validate yet
+    if (g_conf._temppath_reused == 0)
+        goto dbr_refresh_cache_watermark;
+
+    if (incremental == 1) {
+        dbr_discard = 1;
+        if (dbr_fetch_incremental(filter, binds, bind_count, &prev, &now, &rows) != EXIT_SUCCESS) {
+            retval = EXIT_FAILURE;
+            goto dbr_refresh_cache_cleanup;
+        }
+    } else if (dbr_fetch(filter, binds, bind_count, NULL, &rows) != EXIT_SUCCESS) {
+        retval = EXIT_FAILURE;
+        goto dbr_refresh_cache_cleanup;
+    }
+    logmsg(LOG_INFO, "Validating %d cached objects (%s).", rows.count, (incremental == 1 ? "changed since previous mount" : "all"));
+
+    dbr_progress_total(rows.count);
+    dbr_refresh_rows(rows.rows, rows.count);
+
+    // (umount) validation is incomplete, no obsolete entries can be determined and no watermark is written
+    if (dbr_progress_step(0) == 1) {
+        logmsg(LOG_INFO, "Cache validation cancelled.");
+        goto dbr_refresh_cache_cleanup;
+    }
+
+    // entries not verified by this mount might belong to schemas visible only to other mounts
+    if (g_conf.sharedcache == 0) {
+        if (incremental == 1 && dbr_sweep_schemas(&prev, &now) != EXIT_SUCCESS) {
+            retval = EXIT_FAILURE;
+            goto dbr_refresh_cache_cleanup;
+        }
+
+        dbr_verified = malloc((rows.count > 0 ? rows.count : 1) * sizeof(char*));
+        if (dbr_verified == NULL) {
+            logmsg(LOG_ERROR, "dbr_refresh_cache() - unable to allocate memory for %d verified entries", rows.count);
+            retval = EXIT_FAILURE;
+            goto dbr_refresh_cache_cleanup;
+        }
+        for (int i = 0; i < rows.count; i++)
+            if (rows.rows[i].verified == 1)
+                dbr_verified[dbr_verified_count++] = rows.rows[i].fname;
+        qsort(dbr_verified, dbr_verified_count, sizeof(char*), dbr_strcmp);
+
+        if (dbr_sweep == NULL || dbr_sweep_count > 0)
+            dbr_delete_obsolete();
+    }
+
+dbr_refresh_cache_watermark:
+    if (g_conf.sharedcache == 0)
+        dbr_wm_write(&now);
+
+dbr_refresh_cache_cleanup:
+    free(dbr_verified);
+    dbr_verified = NULL;
+    dbr_verified_count = 0;
+    free(dbr_sweep);
+    dbr_sweep = NULL;
+    dbr_sweep_count = 0;
+    dbr_discard = 0;
+    for (int i = 0; i < rows.count; i++) {
+        free(rows.rows[i].schema);
+        free(rows.rows[i].type);
+        free(rows.rows[i].object);
+        free(rows.rows[i].fname);
+    }
+    free(rows.rows);
+    dbr_wm_free(&prev);
+    dbr_wm_free(&now);
+    free(filter);
+    for (int i = 0; i < bind_count; i++)
+        free(binds[i]);
     return retval;
 }
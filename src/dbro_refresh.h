@@ -1,7 +1,30 @@
 #pragma once
 
+/**
+ * Read watermark of previous mount (if any) and continue that mount, so that cache entries it has
+ * verified are valid once dbr_refresh_cache completes. This is called before any request is served, while
+ * dbr_refresh_cache may run in background.
+ * */
+int dbr_refresh_prepare();
+
+/**
+ * Identity of mount whose stamp marks cache entries the next mount can continue with (written to
+ * watermark and directory tree snapshot). This is the continued mount, if any, otherwise this one.
+ * */
+void dbr_generation(long long *mount_pid, long long *mount_stamp);
+
 /**
  * This is called once while mounting the filesystem. It is only called
- * if option dbro=1 and if cache already exists from previous mount.
+ * if option dbro=1 and if cache already exists from previous mount (or is kept).
  * */
 int dbr_refresh_cache();
+
+/**
+ * Stop dbr_refresh_cache (running in another thread) as soon as possible.
+ * */
+void dbr_refresh_cancel();
+
+/**
+ * Number of cache entries validated so far and number of entries to be validated by dbr_refresh_cache.
+ * */
+void dbr_progress(int *done, int *total);
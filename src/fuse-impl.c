@@ -17,6 +17,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <errno.h>
 #include <ctype.h>
 #ifndef _MSC_VER
@@ -29,6 +30,7 @@
 	#include <io.h>
 	#define F_OK    0
     #define O_ACCMODE   (_O_RDONLY|_O_WRONLY|_O_RDWR)
+    #define strcasecmp  _stricmp
 
     #include <BaseTsd.h>
     typedef SSIZE_T ssize_t;
@@ -41,18 +43,25 @@
 #include "tempfs.h"
 #include "fuse-impl.h"
 #include "util.h"
+#include "prefetch.h"
+#include "startup.h"
+#include "compile.h"
+#include "overlay.h"
+#include "objtype.h"
+#include "stream.h"
 
 #define DEPTH_SCHEMA 0
 #define DEPTH_TYPE   1
 #define DEPTH_OBJECT 2
 #define DEPTH_MAX    3
 
-static void fs_path_free(char **part) {
-    for (int i = 0; i < DEPTH_MAX; i++)
-        if (part[i] != NULL)
-            free(part[i]);
-    free(part);
-}
+#define FS_STATUS_SIZE 1024 // max. size of ddlfs.status contents
+
+// path split into its parts, parts point into buf (so that nothing is allocated for every fuse call)
+typedef struct {
+    char  buf[DDLFS_PATH_MAX];
+    char *part[DEPTH_MAX];
+} t_fs_path;
 
 static const char* get_flagstr(int flags) {
     if ((flags & O_ACCMODE) == O_RDONLY)
@@ -65,30 +74,33 @@ static const char* get_flagstr(int flags) {
         return "none";
 }
 
-static int fs_path_create (char ***part, const char *path) {
-    char **r;
-    r = malloc(DEPTH_MAX * sizeof(char*));
-
+// return depth of path (number of parts) or -1
+static int fs_path_split(t_fs_path *p, const char *path) {
     for (int i = 0; i < DEPTH_MAX; i++)
-        r[i] = NULL;
+        p->part[i] = NULL;
+
+    size_t len = strlen(path);
+    if (len >= sizeof(p->buf)) {
+        logmsg(LOG_ERROR, "fs_path_split(), requested path is too long, such file cannot exist!");
+        return -1;
+    }
+    memcpy(p->buf, path, len + 1);
 
-    char *p = strdup(path);
-    char *t = strtok(p, "/");
     int i = 0;
-    while(t) {
-		if (i >= 3) {
-			logmsg(LOG_ERROR, "fs_path_create(), requested path with depth >= 3, such file cannot exist!");
-			free(p);
-			fs_path_free(r);
+    char *c = p->buf;
+    while (*c != '\0') {
+        if (*c == '/') {
+            *c++ = '\0';
+            continue;
+        }
+		if (i >= DEPTH_MAX) {
+			logmsg(LOG_ERROR, "fs_path_split(), requested path with depth >= 3, such file cannot exist!");
 			return -1;
 		}
-        r[i] = strdup(t);
-        t = strtok(NULL, "/");
-        i++;
+        p->part[i++] = c;
+        while (*c != '\0' && *c != '/')
+            c++;
     }
-    free(p);
-
-    *part = r;
 
     return i;
 }
@@ -96,15 +108,15 @@ static int fs_path_create (char ***part, const char *path) {
 static void qry_any(int depth, t_fsentry *schema, t_fsentry *type) {
     switch (depth) {
         case DEPTH_SCHEMA:
-            qry_schemas();
+            g_vfs->loaded = (qry_schemas() == EXIT_SUCCESS ? 1 : 0);
             break;
 
         case DEPTH_TYPE:
-            qry_types(schema);
+            schema->loaded = (qry_types(schema) == EXIT_SUCCESS ? 1 : 0);
             break;
 
         case DEPTH_OBJECT:
-            qry_objects(schema, type);
+            type->loaded = (qry_objects(schema, type) == EXIT_SUCCESS ? 1 : 0);
             break;
 
         default:
@@ -113,46 +125,44 @@ static void qry_any(int depth, t_fsentry *schema, t_fsentry *type) {
     }
 }
 
+// with dbro, database does not change, so directory contents, once loaded, are served from memory
+static int fs_vfs_loaded(t_fsentry *dir) {
+    return (g_conf.dbro == 1 && dir != NULL && dir->loaded == 1 ? 1 : 0);
+}
+
 // e.g. raw_path=/SYS/VIEW/DBA_TABLES.SQL
 // e.g. path[0]=SYS, path[1]=VIEW, path[2]=DBA_TABLES.SQL
 static int qry_dbro_cache(char **path, t_fsentry *type) {
-    char *cache_fname = NULL;// ddlfs-XDB.VIEW.DOCUMENT_LINKS2.SQL.tmp
-    if (qry_object_fname(path[0], path[1], path[2], &cache_fname) != EXIT_SUCCESS) {
+    char cache_fname[DDLFS_PATH_MAX]; // ddlfs-XDB.VIEW.DOCUMENT_LINKS2.SQL.tmp
+    if (qry_object_fname_buf(path[0], path[1], path[2], cache_fname, sizeof(cache_fname)) != EXIT_SUCCESS) {
         logmsg(LOG_ERROR, "qry_dbro_cache() - unable to determine filename, qry_object_fname() failed");
-        if (cache_fname != NULL)
-            free(cache_fname);
         return EXIT_FAILURE;
     }
 
     int retval = EXIT_FAILURE;
     if (tfs_quick_validate(cache_fname) == EXIT_SUCCESS) {
 
-        // get last_ddl_time from cache
-        time_t last_ddl_time;
-        if (tfs_getldt(cache_fname, &last_ddl_time, NULL, NULL) != EXIT_SUCCESS) {
-            if (cache_fname != NULL)
-                free(cache_fname);
+        // get last_ddl_time and validity from cache
+        t_tfs_meta meta;
+        if (tfs_getmeta(cache_fname, &meta) != EXIT_SUCCESS)
             return EXIT_FAILURE;
-        }
-
-        // get execution bit from cache
-        struct stat file_stat;
-        if(stat(cache_fname, &file_stat) < 0) {
-            logmsg(LOG_ERROR, "qry_dbro_cache() - unable to determine execution bit, stat() failed");
-            if (cache_fname != NULL)
-                free(cache_fname);
-            return EXIT_FAILURE;
-        }
+        time_t last_ddl_time = meta.last_ddl_time;
 
 #ifdef _MSC_VER
-		char ftype = 'F';
+		char ftype = (meta.validity == 1 ? 'I' : 'F');
 #else
-        char ftype = ((file_stat.st_mode & S_IXUSR) ? 'F' : 'I');
+        char ftype = (meta.validity == 0 ? 'F' : 'I');
+        if (meta.validity == -1) {
+            // entry was cached by an older version, which stored validity as execution bit
+            struct stat file_stat;
+            if (stat(cache_fname, &file_stat) == 0 && (file_stat.st_mode & S_IXUSR))
+                ftype = 'F';
+        }
 #endif
 
         // load vfs from cache
         t_fsentry *entry = vfs_entry_create(
-            ftype, // F=valid (execution bit set), I=invalid
+            ftype, // F=valid, I=invalid
             path[DEPTH_OBJECT],
             last_ddl_time,
             last_ddl_time);
@@ -161,16 +171,53 @@ static int qry_dbro_cache(char **path, t_fsentry *type) {
         retval = EXIT_SUCCESS;
     }
 
-    if (cache_fname != NULL)
-        free(cache_fname);
-
     return retval;
 }
 
+// files created through the filesystem are listed even though their objects don't exist in database yet (see cmp_create)
+// and removed files are not, even though their objects are not dropped yet (see cmp_drop)
+static void fs_vfs_pending(char **path, t_fsentry *type) {
+    char dir[1024];
+    char **names = NULL;
+    int count = 0;
+    int added = 0;
+
+    if (type == NULL)
+        return;
+
+    snprintf(dir, sizeof(dir), "/%s/%s", path[DEPTH_SCHEMA], path[DEPTH_TYPE]);
+    cmp_dropped_list(dir, &names, &count);
+    for (int i = 0; i < count; i++) {
+        vfs_entry_remove(type, names[i]);
+        free(names[i]);
+    }
+    free(names);
+
+    names = NULL;
+    count = 0;
+    cmp_created_list(dir, &names, &count);
+    for (int i = 0; i < count; i++) {
+        if (vfs_entry_search(type, names[i]) == NULL) {
+            time_t now = time(NULL);
+            vfs_entry_add(type, vfs_entry_create('I', names[i], now, now));
+            added = 1;
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    if (added)
+        vfs_entry_sort(type);
+}
+
 // return NULL if file not found
 static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
+    // cache validation (in background) may have found changed objects
+    vfs_invalidate_pending();
+
     if (path[0] == NULL) {
-        qry_any(0, NULL, NULL);
+        if (fs_vfs_loaded(g_vfs) == 0)
+            qry_any(0, NULL, NULL);
         return g_vfs;
     }
 
@@ -180,21 +227,8 @@ static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
         if (suffix == NULL)
             return NULL;
 
-#ifdef _MSC_VER
-		char *suffix_upper = strdup(suffix);
-		if (suffix_upper == NULL)
-			return NULL;
-		for (size_t i = 0; i < strlen(suffix_upper); i++)
-			suffix_upper[i] = (char) toupper(suffix_upper[i]);
-		if (strcmp(suffix_upper, ".JAVA") != 0 && strcmp(suffix_upper, ".SQL") != 0) {
-			free(suffix_upper);
-			return NULL;
-		}
-		free(suffix_upper);
-#else
         if (strcasecmp(suffix, ".JAVA") != 0 && strcasecmp(suffix, ".SQL") != 0)
             return NULL;
-#endif
     }
 
     if (path[DEPTH_TYPE] != NULL) {
@@ -227,12 +261,19 @@ static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
     t_fsentry *entries[DEPTH_MAX] = {NULL, NULL, NULL};
     for (int i = 0; i < DEPTH_MAX; i++) {
         if (path[i] == NULL) {
-            if (loadFound)
+            if (loadFound && fs_vfs_loaded(entries[i-1]) == 0)
                 qry_any(i, entries[DEPTH_SCHEMA], entries[DEPTH_TYPE]);
+            if (i == DEPTH_OBJECT)
+                fs_vfs_pending(path, entries[DEPTH_TYPE]);
             return entries[i-1];
         }
 
+        if (i == DEPTH_OBJECT)
+            fs_vfs_pending(path, entries[DEPTH_TYPE]);
         entries[i] = vfs_entry_search((i == 0 ? g_vfs : entries[i-1]), path[i]);
+        if (entries[i] == NULL && fs_vfs_loaded(i == 0 ? g_vfs : entries[i-1]) == 1)
+            return NULL; // complete listing is loaded, so this does not exist
+
         if (entries[i] == NULL) {
             if (g_conf.dbro == 1 && i == DEPTH_OBJECT && path[DEPTH_OBJECT] != NULL) {
                 if (qry_dbro_cache(path, entries[DEPTH_TYPE]) != EXIT_SUCCESS) {
@@ -241,6 +282,8 @@ static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
              } else
                 qry_any(i, entries[DEPTH_SCHEMA], entries[DEPTH_TYPE]);
 
+            if (i == DEPTH_OBJECT)
+                fs_vfs_pending(path, entries[DEPTH_TYPE]);
             entries[i] = vfs_entry_search((i == 0 ? g_vfs : entries[i-1]), path[i]);
         }
         if (entries[i] == NULL) {
@@ -249,8 +292,8 @@ static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
         }
     }
 
-    // free cached vfs contents of the other (previous) schema...
-    if (entries[DEPTH_SCHEMA] != NULL) {
+    // free cached vfs contents of the other (previous) schema (with dbro, whole tree is kept, see vfs_snapshot_save)...
+    if (entries[DEPTH_SCHEMA] != NULL && g_conf.dbro != 1) {
         if ( (g_vfs_last_schema != NULL) && (strcmp(g_vfs_last_schema->fname, entries[DEPTH_SCHEMA]->fname) != 0)) {
             logmsg(LOG_DEBUG, "Clearing VFS for [%s] in favour of [%s]", g_vfs_last_schema->fname, entries[DEPTH_SCHEMA]->fname);
             vfs_entry_free(g_vfs_last_schema, 1);
@@ -264,13 +307,12 @@ static t_fsentry* fs_vfs_by_path(char **path, int loadFound) {
 int fs_getattr(	const char *path,
                 DDLFS_STRUCT_STAT *st)
 {
-    char **part;
-    int depth = fs_path_create(&part, path);
+    t_fs_path fp;
+    int depth = fs_path_split(&fp, path);
+    char **part = fp.part;
 	if (depth == -1)
 		return -ENOENT;
 
-    t_fsentry *entry = fs_vfs_by_path(part, 0);
-
     if (strcmp(path, "/ddlfs.log") == 0) {
         st->st_uid = getuid();
         st->st_gid = getgid();
@@ -284,15 +326,61 @@ int fs_getattr(	const char *path,
         st->st_nlink = 1;
         st->st_mode = S_IFREG | 0444;
         st->st_size = (off_t) (g_ddl_log_buf == NULL ? 0 : g_ddl_log_len);
-        fs_path_free(part);
+        return 0;
+    }
+
+    if (strcmp(path, "/ddlfs.status") == 0) {
+        char status[FS_STATUS_SIZE];
+        st->st_uid = getuid();
+        st->st_gid = getgid();
+        st->st_nlink = 1;
+        st->st_mode = S_IFREG | 0444;
+        st->st_size = (off_t) st_status(status, FS_STATUS_SIZE);
         return 0;
     }
 
     logmsg(LOG_DEBUG, "fuse-getattr: [%s]", path);
 
+    // editor/vcs scratch files are never looked up in database
+    if (ovl_is_scratch(path)) {
+        struct stat ovl_st;
+        int r = ovl_getattr(path, &ovl_st);
+        if (r != 0)
+            return r;
+
+#ifndef _MSC_VER
+        st->st_uid = getuid();
+        st->st_gid = getgid();
+        st->st_atime = ovl_st.st_atime;
+        st->st_mtime = ovl_st.st_mtime;
+        st->st_ctime = ovl_st.st_ctime;
+#else
+        struct timespec tmp;
+        tmp.tv_sec = ovl_st.st_mtime;
+        tmp.tv_nsec = 0;
+        st->st_atim = tmp;
+        st->st_mtim = tmp;
+        st->st_ctim = tmp;
+#endif
+        st->st_nlink = 1;
+        st->st_mode = S_IFREG | 0644;
+        st->st_size = ovl_st.st_size;
+        return 0;
+    }
+
+    // mountpoint itself is available right away, anything else waits for database connection
+    t_fsentry *entry = NULL;
+    if (depth == 0 && st_connected() == 0) {
+        entry = g_vfs;
+    } else {
+        if (st_wait() != EXIT_SUCCESS) {
+            return -EIO;
+        }
+        entry = fs_vfs_by_path(part, 0);
+    }
+
     if (entry == NULL) {
         logmsg(LOG_INFO, "fuse-getattr: File not found [%s]\n\n", path);
-        fs_path_free(part);
         return -ENOENT;
     }
 
@@ -300,10 +388,9 @@ int fs_getattr(	const char *path,
     tmp_st.st_size = g_conf.filesize;
 
     if (depth == DEPTH_MAX) {
-        char *fname;
-        qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &fname);
-        stat(fname, &tmp_st);
-        free(fname);
+        char fname[DDLFS_PATH_MAX];
+        if (qry_object_fname_buf(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], fname, sizeof(fname)) == EXIT_SUCCESS)
+            stat(fname, &tmp_st);
     }
 
 #ifndef _MSC_VER
@@ -335,9 +422,9 @@ int fs_getattr(	const char *path,
             // https://github.com/usrecnik/ddlfs/issues/11
             st->st_mode = S_IFREG | 0444;
         } else {
-            if ((depth == DEPTH_MAX) &&
-                ((strcasecmp(part[DEPTH_TYPE], "TABLE") == 0) || (strcasecmp(part[DEPTH_TYPE], "MATERIALIZED_VIEW") == 0))) {
-                // tables and materialized views are always read only as they cannot be "create or REPLACEd"
+            const t_objtype *ot = ot_get(entry->otype);
+            if (depth == DEPTH_MAX && ot != NULL && ot->writable == 0) {
+                // e.g. tables and materialized views are always read only as they cannot be "create or REPLACEd"
                 st->st_mode = S_IFREG | 0444;
             } else {
                 if (entry->ftype == 'F')
@@ -351,7 +438,6 @@ int fs_getattr(	const char *path,
         st->st_size = tmp_st.st_size;
     }
 
-    fs_path_free(part);
     return 0;
 }
 
@@ -376,16 +462,22 @@ int fs_readdir(	const char *path,
 {
     logmsg(LOG_DEBUG, "fuse-readdir: [%s]", path);
 
-    char **part;
-    int depth = fs_path_create(&part, path);
+    t_fs_path fp;
+    int depth = fs_path_split(&fp, path);
+    char **part = fp.part;
 	if (depth == -1)
 		return -ENOENT;
 
+    if (st_wait() != EXIT_SUCCESS) {
+        return -EIO;
+    }
+
+    pf_interactive_begin();
     t_fsentry *entry = fs_vfs_by_path(part, 1);
+    pf_interactive_end();
 
     if (entry == NULL) {
         logmsg(LOG_DEBUG, "File not found for path [%s]", path);
-        fs_path_free(part);
         return -ENOENT;
     }
 
@@ -402,7 +494,25 @@ int fs_readdir(	const char *path,
         filler(buffer, entry->children[i]->fname, NULL, 0, 0);
 #endif
 
-    fs_path_free(part);
+    if (depth == DEPTH_OBJECT) {
+        char **ovl_names = NULL;
+        int ovl_count = 0;
+        ovl_list(path, &ovl_names, &ovl_count);
+        for (int i = 0; i < ovl_count; i++) {
+#ifdef _MSC_VER
+            filler(buffer, ovl_names[i], NULL, 0);
+#else
+            filler(buffer, ovl_names[i], NULL, 0, 0);
+#endif
+            free(ovl_names[i]);
+        }
+        free(ovl_names);
+    }
+
+    // objects listed are likely to be opened soon
+    if (depth == DEPTH_OBJECT)
+        pf_enqueue_dir(part[DEPTH_SCHEMA], part[DEPTH_TYPE], entry);
+
     
     return 0;
 }
@@ -426,30 +536,145 @@ int fs_readdir_lnx(const char *path,
 }
 #endif
 
-// return file handle or -1 on error
+#ifndef _MSC_VER
+void* fs_init_lnx(struct fuse_conn_info *conn,
+                  struct fuse_config *cfg) {
+    // threads must be started after fuse has daemonized the process
+    if (pf_start() != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "fs_init() - unable to start prefetch workers, prefetch is disabled.");
+
+    if (stm_start() != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "fs_init() - unable to start stream workers, objects are fetched before they're opened.");
+
+    if (cmp_start() != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "fs_init() - unable to start compile worker, DDL is executed synchronously.");
+
+    // database connection and cache validation are done in background, see ddlfs.status
+    if (st_start() != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "fs_init() - unable to start startup thread, filesystem is not usable.");
+    return NULL;
+}
+#endif
+
+// per-open state (fi->fh), identity of the object is resolved once, by fs_open
+typedef struct {
+    int   fd;
+    int   scratch;  // 1=file is stored in overlay (see overlay.h)
+    int   dirty;    // 1=written or truncated through this handle, its DDL is queued by fs_release
+    const t_objtype *ot;  // NULL for scratch files (and unsupported types)
+    char *schema;   // database names of schema and object (only for handles opened for writing)
+    char *object;
+    char *cache_fn;
+    t_stm_job *stream;  // object is still being fetched (read-only handles only, see stream.h)
+    char *writer;   // path registered by cmp_writer_open (handles opened for writing)
+} t_fs_handle;
+
+#define FS_HANDLE(fi) ((t_fs_handle*) (uintptr_t) (fi)->fh)
+
+static void fs_handle_free(t_fs_handle *h) {
+    if (h->stream != NULL)
+        stm_release(h->stream);
+    if (h->writer != NULL)
+        cmp_writer_close(h->writer);
+    free(h->writer);
+    free(h->schema);
+    free(h->object);
+    free(h->cache_fn);
+    free(h);
+}
+
+// return file handle or -1 on error, h (if not NULL) is filled with object identity
 static int fake_open(const char *path,
-                     struct fuse_file_info *fi) {
+                     struct fuse_file_info *fi,
+                     t_fs_handle *h) {
 
     logmsg(LOG_DEBUG, "fake-open: [%s]", path);
-    char **part;
-    int depth = fs_path_create(&part, path);
+    t_fs_path fp;
+    int depth = fs_path_split(&fp, path);
+    char **part = fp.part;
 	if (depth == -1)
 		return -1;
 
     if (depth != DEPTH_MAX) {
         logmsg(LOG_ERROR, "Unable to open file at depth=%d (%s).", depth, path);
-        fs_path_free(part);
         return -1;
     }
 
+    if (ovl_is_scratch(path)) {
+        int ovl_fh = -1;
+        if (ovl_open(path, (fi == NULL ? O_RDONLY : fi->flags), &ovl_fh) != 0)
+            return -1;
+        if (h != NULL)
+            h->scratch = 1;
+        return ovl_fh;
+    }
+
+    if (st_wait() != EXIT_SUCCESS) {
+        return -1;
+    }
+
+    int writable = (fi != NULL && (fi->flags & O_ACCMODE) != O_RDONLY);
+
+    // queued DDL is served from cache file, but not while it is being executed (and it is not
+    // executed while the file is open for writing, released by fs_handle_free)
+    if (writable && h != NULL) {
+        if ((h->writer = strdup(path)) == NULL)
+            return -1;
+        if (cmp_writer_open(path) != EXIT_SUCCESS) {
+            free(h->writer);
+            h->writer = NULL;
+            return -1;
+        }
+    } else {
+        cmp_wait(path);
+    }
+
+    // object opened for reading can be read while it's still being fetched
+    if (h != NULL && fi != NULL && !writable && !cmp_created(path)) {
+        int stm_fh = stm_open(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &h->stream);
+        if (stm_fh >= 0) {
+            pf_enqueue_related(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT]);
+            h->ot = ot_by_fs(part[DEPTH_TYPE]);
+            return stm_fh;
+        }
+    }
+
     char *fname = NULL;
-    if (qry_object(part[0], part[1], part[2], &fname) != EXIT_SUCCESS) {
-        if (fname != NULL)
-            free(fname);
-        fs_path_free(part);
+    if (cmp_created(path)) {
+        // object does not exist in database (yet), local cache file is all there is
+        if (qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &fname) != EXIT_SUCCESS) {
+            return -1;
+        }
+    } else {
+        if (qry_object(part[0], part[1], part[2], &fname) != EXIT_SUCCESS) {
+            if (fname != NULL)
+                free(fname);
+            return -1;
+        }
+
+        // e.g. package body is likely to be opened right after its spec
+        if (fi != NULL)
+            pf_enqueue_related(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT]);
+    }
+
+    // cache file may be hard link to content shared with other objects (dedup=1)
+    if (writable && tfs_unshare(fname) != EXIT_SUCCESS) {
+        free(fname);
         return -1;
     }
-    
+
+    // names of the object are only needed to queue its DDL
+    if (h != NULL) {
+        h->ot = ot_by_fs(part[DEPTH_TYPE]);
+        if ((writable && (str_fn2obj(&h->schema, part[DEPTH_SCHEMA], NULL) != EXIT_SUCCESS ||
+                          str_fn2obj(&h->object, part[DEPTH_OBJECT], part[DEPTH_TYPE]) != EXIT_SUCCESS))) {
+            logmsg(LOG_ERROR, "fake_open() - unable to convert file name to object [%s]", path);
+            free(fname);
+            return -1;
+        }
+        h->dirty = (writable && (fi->flags & O_TRUNC) ? 1 : 0);
+    }
+
     int fh;
     if (fi != NULL)
         fh = open(fname, O_RDWR);
@@ -461,13 +686,13 @@ static int fake_open(const char *path,
             fname, errno);
         if (fname != NULL)
             free(fname);
-        fs_path_free(part);
         return -1;
     }
 
-    if (fname != NULL)
+    if (h != NULL)
+        h->cache_fn = fname;
+    else
         free(fname);
-    fs_path_free(part);
 
     return fh;
 }
@@ -475,41 +700,50 @@ static int fake_open(const char *path,
 int fs_open(const char *path,
             struct fuse_file_info *fi) {
 
-    if (strcmp(path, "/ddlfs.log") == 0) {
+    if (strcmp(path, "/ddlfs.log") == 0 || strcmp(path, "/ddlfs.status") == 0) {
         fi->direct_io = 1;
+        fi->fh = 0;
         return 0;
     }
 
     logmsg(LOG_INFO, "fuse-open: [%s], [%s]", path, get_flagstr(fi->flags));
 
-    int fh = fake_open(path, fi);
-    if (fh < 0) {
+    t_fs_handle *h = calloc(1, sizeof(t_fs_handle));
+    if (h == NULL)
+        return -ENOMEM;
+
+    pf_interactive_begin();
+    h->fd = fake_open(path, fi, h);
+    pf_interactive_end();
+    if (h->fd < 0) {
         logmsg(LOG_ERROR, "Unable to fs_open(%s).", path);
+        fs_handle_free(h);
         return -ENOENT;
     }
     fi->direct_io = 1;
-    fi->fh = fh;
+    fi->fh = (uint64_t) (uintptr_t) h;
 
     return 0;
 }
 
-static size_t fs_read_ddl_log(char *buf, size_t size, off_t offset, struct fuse_file_info *fi) {
-    if (g_ddl_log_buf == NULL)
+static size_t fs_read_status(char *buf, size_t size, off_t offset) {
+    char status[FS_STATUS_SIZE];
+    size_t len = st_status(status, FS_STATUS_SIZE);
+    if ((size_t) offset >= len)
         return 0;
 
-    size_t len = strlen(g_ddl_log_buf);
-    if ((int) offset >= (int) len)
-        return 0;
+    if (offset + size > len)
+        size = len - offset;
 
-    if (offset + size > len) {
-        memcpy(buf, g_ddl_log_buf + offset, len - offset);
-        return len - offset;
-    }
-
-    memcpy(buf, g_ddl_log_buf + offset, size);
+    memcpy(buf, status + offset, size);
     return size;
 }
 
+static size_t fs_read_ddl_log(char *buf, size_t size, off_t offset, struct fuse_file_info *fi) {
+    // log is also written by compile worker
+    return logddl_read(buf, size, (size_t) offset);
+}
+
 int fs_read(const char *path, 
 			char *buffer, 
 			size_t size, 
@@ -526,16 +760,25 @@ int fs_read(const char *path,
     if (strcmp(path, "/ddlfs.log") == 0)        
         return (int) fs_read_ddl_log(buffer, size, offset, fi);
 
+    if (strcmp(path, "/ddlfs.status") == 0)
+        return (int) fs_read_status(buffer, size, offset);
+
     if (fi == NULL)
-        fd = fake_open(path, NULL);
+        fd = fake_open(path, NULL, NULL);
     else
-        fd = (int) fi->fh;
+        fd = FS_HANDLE(fi)->fd;
 
     if (fd < 0) {
         logmsg(LOG_ERROR, "fuse-read failed, fd is negative (%d)", fd);
         return -ENOENT;
     }
 
+    // read only what is already fetched, unless fetch has completed
+    if (fi != NULL && FS_HANDLE(fi)->stream != NULL && stm_wait(FS_HANDLE(fi)->stream, offset + (off_t) size) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "fuse-read: fetch of [%s] failed", path);
+        return -EIO;
+    }
+
     res = pread(fd, buffer, size, offset);
     if (res == -1) {
         logmsg(LOG_ERROR, "pread returned error.");
@@ -564,9 +807,11 @@ int fs_write(const char *path,
              off_t offset,
              struct fuse_file_info *fi) {
     logmsg(LOG_INFO, "fuse-write: [%s]", path);
-    int res = pwrite((int) fi->fh, buf, size, offset);
+    t_fs_handle *h = FS_HANDLE(fi);
+    int res = pwrite(h->fd, buf, size, offset);
     if (res == -1)
         return -errno;
+    h->dirty = 1;
     return res;
 }
 #ifdef _MSC_VER
@@ -579,155 +824,85 @@ int fs_write_win(const char* path,
 }
 #endif
 
+// content of new (empty) file, from which its object is created (schema and object are database names)
+static int fs_template(const t_objtype *ot, const char *schema, const char *object, char *buf, size_t size) {
+    if (ot == NULL || ot->create_tpl == NULL)
+        return EXIT_FAILURE;
+    snprintf(buf, size, ot->create_tpl, schema, object);
+    return EXIT_SUCCESS;
+}
+
 int fs_release(const char *path,
                struct fuse_file_info *fi) {
 
     int retval = 0;
-    char **part = NULL;
-    char *fname = NULL;
-    char *object_name = NULL;
-    char *object_schema = NULL;
+    t_fs_handle *h = FS_HANDLE(fi);
     struct stat tmp_stat;
-    size_t buf_len = 0;
-    char *buf = NULL;
-    int fd = -1;
-    // int cache_already_removed = 0;
 
-    if (strcmp(path, "/ddlfs.log") == 0)
+    if (strcmp(path, "/ddlfs.log") == 0 || strcmp(path, "/ddlfs.status") == 0)
         return 0;
 
     logmsg(LOG_INFO, "fuse-release: [%s], [%s]", path, get_flagstr(fi->flags));    
 
-    int depth = fs_path_create(&part, path);
-	if (depth == -1)
-		return -ENOENT;
-
-    qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &fname);
-
-    int is_java_source = (strcmp(part[DEPTH_TYPE], "JAVA_SOURCE") == 0 ? 1 : 0);
-    int is_table_source = (strcmp(part[DEPTH_TYPE], "TABLE") == 0 ? 1 : 0);
-    int is_mview_source = (strcmp(part[DEPTH_TYPE], "MATERIALIZED_VIEW") == 0 ? 1 : 0);
-
-    if (close((int) fi->fh) != 0) {
-        // closing also flushes metadata, such as mtime
-        logmsg(LOG_DEBUG, "Unable to close underlying file (%s), error=%d", fname, errno);
-        fs_path_free(part);
-        free(fname);
-        return -errno;
+    // size is only needed if file was written, it is taken while descriptor is still open
+    if (h->dirty && fstat(h->fd, &tmp_stat) != 0) {
+        logmsg(LOG_ERROR, "fs_release() - fstat failed for [%s]", path);
+        h->dirty = 0;
+        retval = -EIO;
     }
-		
-	// read file to buffer
-    if (fi->flags & O_RDWR || fi->flags & O_WRONLY) {
 
-		if (stat(fname, &tmp_stat) != 0) {
-            logmsg(LOG_ERROR, "fs_release() - fstat failed for [%s]", fname);
-            retval = -1;
-            goto fs_release_final;
-        }
-        if (tmp_stat.st_mtime == 0) {
-            logmsg(LOG_DEBUG, "fs_release() - no write occured even though file was opened as r/w.");
-        } else if (is_table_source || is_mview_source) {
-            logmsg(LOG_ERROR, "fs_release() - write not supported for TABLE and MATERIALIZED_VIEW types.");
-        } else {
-            logmsg(LOG_DEBUG, "(temp file size is %d bytes)", tmp_stat.st_size);
-
-            buf_len = ((tmp_stat.st_size + (is_java_source * 350)) * sizeof(char)) + 1;
-            buf = malloc(buf_len);
-            if (buf == NULL) {
-                logmsg(LOG_ERROR, "fs_release() - unable to malloc buf (buf_len=[%d])", buf_len);
-                retval = -ENOMEM;
-                goto fs_release_final;
-            }
-
-             // determine object name/schema
-            if (str_fn2obj(&object_name, part[DEPTH_OBJECT], part[DEPTH_TYPE]) != EXIT_SUCCESS) {
-                logmsg(LOG_ERROR, "fs_create() - unable to convert object to file name");
-                return -ENOMEM;
-            }
-
-            if (str_fn2obj(&object_schema, part[DEPTH_SCHEMA], NULL) != EXIT_SUCCESS) {
-                logmsg(LOG_ERROR, "fs_create() - unable to convert schema to file name");
-                return -ENOMEM;
-            }
+    if (close(h->fd) != 0) {
+        logmsg(LOG_DEBUG, "Unable to close underlying file (%s), error=%d", path, errno);
+        retval = -errno;
+        fs_handle_free(h);
+        return retval;
+    }
 
-            logmsg(LOG_DEBUG, "Reading %d in buffer size %d, FD=%d", tmp_stat.st_size, buf_len, fi->fh);
+    // scratch file has no object (and no DDL)
+    if (h->scratch || h->dirty == 0) {
+        fs_handle_free(h);
+        return retval;
+    }
 
+    // new file closed without content (e.g. touch), its object is created from template
+    if (tmp_stat.st_size == 0 && cmp_created(path)) {
+        char empty_ddl[1024] = "";
+        if (fs_template(h->ot, h->schema, h->object, empty_ddl, sizeof(empty_ddl)) == EXIT_SUCCESS) {
 #ifdef _MSC_VER
-            fd = open(fname, O_RDONLY | O_BINARY);
+            int fd = open(h->cache_fn, O_WRONLY | O_TRUNC | O_BINARY);
 #else
-            fd = open(fname, O_RDONLY);
+            int fd = open(h->cache_fn, O_WRONLY | O_TRUNC);
 #endif
-            if (fd == -1) {
-                logmsg(LOG_ERROR, "fs_release() - unable to re-open temp file as r/o.");
-                retval = -1;
-                goto fs_release_final;
-            }
-            buf[0] = '\0';
-
-            size_t newLenJava = 0;
-            if (is_java_source == 1)
-                newLenJava = sprintf(buf, "CREATE OR REPLACE AND COMPILE JAVA SOURCE NAMED \"%s\".\"%s\" AS\n",
-                    object_schema, object_name);
-
-            ssize_t newLen = read(fd, buf+strlen(buf), tmp_stat.st_size);
-            if (newLen == -1 || newLen != tmp_stat.st_size) {
-                logmsg(LOG_ERROR, "fs_release() - unable to read() [%s], errno=%d (%s) [%d]!=[%d]", fname, errno, strerror(errno), newLen, tmp_stat.st_size);
-                retval = -1;
-                goto fs_release_final;
-            }
-            logmsg(LOG_DEBUG, "Read %d bytes", newLen);
-            // newLen++;
-            if (is_java_source == 1)
-              buf[newLen+newLenJava-1] = '\0';
-            else
-              buf[newLen] = '\0';
-
-            if (newLen == 0)
-                logmsg(LOG_DEBUG, "Skipping execution of DDL as input file size is 0.");
-            else
-                qry_exec_ddl(object_schema, object_name, buf);
-
-            if (close(fd) == -1) // windows won't allow deleting of open file
-                logmsg(LOG_ERROR, "fs_release() - unable to close underlying r/o file");            
-            fd = -1;
-
-            if (tfs_rmfile(fname) != EXIT_SUCCESS)
-                logmsg(LOG_ERROR, "fs_release - unable to remove cache file [%s] after DDL.", fname);
-            
-            // cache_already_removed = 1;
+            if (fd == -1 || write(fd, empty_ddl, strlen(empty_ddl)) != (ssize_t) strlen(empty_ddl) ||
+                close(fd) != 0 || stat(h->cache_fn, &tmp_stat) != 0)
+                logmsg(LOG_ERROR, "fs_release() - unable to write template to [%s], errno=%d", h->cache_fn, errno);
         }
     }
 
-/* 
-    // @todo - consider *never* deleting this file here (and delete all temp files on umount).
-    if (g_conf.filesize != -1) {
-        // delete temp file. g_conf.filesie=-1 means exact filesizes. deleting this file would
-        // invalidate cached files (which would be cause a bit of performance degradation,
-        // functionally it wold be ok)
-
-        if ((cache_already_removed == 0) && (tfs_rmfile(fname) != EXIT_SUCCESS))
-            logmsg(LOG_ERROR, "fs_release - unable to remove cached file [%s] fd=[%d]", fname, fd);
+    logmsg(LOG_DEBUG, "(temp file size is %d bytes)", tmp_stat.st_size);
+
+    if (h->ot == NULL || h->ot->writable == 0) {
+        logmsg(LOG_ERROR, "fs_release() - write not supported for objects in [%s] (e.g. TABLE and MATERIALIZED_VIEW).", path);
+    } else if (tmp_stat.st_size == 0) {
+        logmsg(LOG_DEBUG, "Skipping execution of DDL as input file size is 0.");
+        if (tfs_rmfile(h->cache_fn) != EXIT_SUCCESS)
+            logmsg(LOG_ERROR, "fs_release - unable to remove cache file [%s].", h->cache_fn);
+    } else if (tfs_unchanged(h->cache_fn) == EXIT_SUCCESS && cmp_discard(path) == 0) {
+        // e.g. editor saved without changes or git checkout of identical file, cache file is still up2date.
+        // DDL of an earlier save (still waiting for debounce) is cancelled, as content is the same as in database again.
+        // Changed content replaces queued DDL instead (see cmp_enqueue), keeping the time it was queued first
+        logmsg(LOG_INFO, "fs_release() - content of [%s] is unchanged, DDL is not executed.", path);
+        logddl("Skipping DDL for [%s], content is unchanged.\n", path);
+    } else {
+        // DDL is read from cache file (and the file removed) by compile worker, these are freed by it
+        if (cmp_enqueue(path, h->ot, h->schema, h->object, h->cache_fn) != EXIT_SUCCESS)
+            retval = -ENOMEM;
+        h->schema = NULL;
+        h->object = NULL;
+        h->cache_fn = NULL;
     }
-*/
-
-fs_release_final:
-
-    if (fd != -1)
-        if (close(fd) == -1)
-            logmsg(LOG_ERROR, "fs_release() - unable to close underlying r/o file");
-
-    if (buf != NULL)
-        free(buf);
-
-    if (object_schema != NULL)
-        free(object_schema);
-
-    if (object_name != NULL)
-        free(object_name);
-
-    fs_path_free(part);
-    free(fname);
 
+    fs_handle_free(h);
     return retval;
 }
 
@@ -737,93 +912,84 @@ int fs_create (const char *path,
                struct fuse_file_info *fi) {
 
     DDLFS_STRUCT_STAT st;
-    char **part;
+    t_fs_path fp;
+    char **part = fp.part;
     int depth;
-    char *object_type = NULL;
-    char *object_name = NULL;
-    char *object_schema = NULL;
+    int created = 0;
+    char *fname = NULL;
     char empty_ddl[1024] = "";
     logmsg(LOG_INFO, "fs_create() - [%s]", path);
 
+    // e.g. vim swap file, it is kept locally and doesn't need database
+    if (ovl_is_scratch(path)) {
+        t_fs_handle *h = calloc(1, sizeof(t_fs_handle));
+        if (h == NULL)
+            return -ENOMEM;
+        int r = ovl_create(path, &h->fd);
+        if (r != 0) {
+            fs_handle_free(h);
+            return r;
+        }
+        h->scratch = 1;
+        fi->direct_io = 1;
+        fi->fh = (uint64_t) (uintptr_t) h;
+        return 0;
+    }
+
+    if (st_wait() != EXIT_SUCCESS)
+        return -EIO;
 
     if (fs_getattr(path, &st) == -ENOENT) {
-        logmsg(LOG_INFO, "fs_create() - creating empty object for [%s]", path);
+        logmsg(LOG_INFO, "fs_create() - creating local file for [%s]", path);
 
-        depth = fs_path_create(&part, path);
+        depth = fs_path_split(&fp, path);
 		if (depth == -1)
 			return -EINVAL;
 
-        if (str_fn2obj(&object_type, part[DEPTH_TYPE], NULL) != EXIT_SUCCESS) {
-            logmsg(LOG_ERROR, "fs_create() - unable to convert object to file name");
-            fs_path_free(part);
-            return -ENOMEM;
-        }
-
-        if (str_fn2obj(&object_name, part[DEPTH_OBJECT], part[DEPTH_TYPE]) != EXIT_SUCCESS) {
-            logmsg(LOG_ERROR, "fs_create() - unable to convert object to file name");
-            fs_path_free(part);
-            return -ENOMEM;
-        }
-
-        if (str_fn2obj(&object_schema, part[DEPTH_SCHEMA], NULL) != EXIT_SUCCESS) {
-            logmsg(LOG_ERROR, "fs_create() - unable to convert schema to file name");
-            fs_path_free(part);
-            return -ENOMEM;
-        }
-
         if (depth != 3) {
             logmsg(LOG_ERROR, "Creating of new objects is only allowed on depth level 3");
-            fs_path_free(part);
             return -EINVAL;
         }
 
-        if (strcmp(object_type, "PROCEDURE") == 0)
-            snprintf(empty_ddl, 1023, "CREATE PROCEDURE \"%s\".\"%s\" AS\nBEGIN\n    NULL;\nEND;",
-                object_schema, object_name);
-        else if (strcmp(object_type, "FUNCTION") == 0)
-            snprintf(empty_ddl, 1023, "CREATE FUNCTION \"%s\".\"%s\" RETURN NUMBER AS\nBEGIN\n    RETURN NULL;\nEND;",
-                object_schema, object_name);
-        else if (strcmp(object_type, "VIEW") == 0)
-            snprintf(empty_ddl, 1023, "CREATE VIEW \"%s\".\"%s\" AS\nSELECT * FROM dual",
-                object_schema, object_name);
-        else if (strcmp(object_type, "TYPE") == 0)
-            snprintf(empty_ddl, 1023, "CREATE TYPE \"%s\".\"%s\" AS OBJECT(\nn NUMBER)",
-                object_schema, object_name);
-        else if (strcmp(object_type, "TYPE_BODY") == 0)
-            snprintf(empty_ddl, 1023, "CREATE TYPE BODY \"%s\".\"%s\" AS\n\nEND;",
-                object_schema, object_name);
-        else if (strcmp(object_type, "PACKAGE_SPEC") == 0)
-            snprintf(empty_ddl, 1023, "CREATE PACKAGE \"%s\".\"%s\" AS\n\nEND;",
-                object_schema, object_name);
-        else if (strcmp(object_type, "PACKAGE_BODY") == 0)
-            snprintf(empty_ddl, 1023, "CREATE PACKAGE BODY \"%s\".\"%s\" AS\n\nEND;",
-                object_schema, object_name);
-        else if (strcmp(object_type, "JAVA_SOURCE") == 0)
-            snprintf(empty_ddl, 1023, "CREATE AND COMPILE JAVA SOURCE NAMED \"%s\".\"%s\" AS\npublic class %s {\n}",
-                object_schema, object_name, object_name);
-        else {
+        // only type is checked here, template itself is written by fs_release
+        if (fs_template(ot_by_fs(part[DEPTH_TYPE]), part[DEPTH_SCHEMA], part[DEPTH_OBJECT], empty_ddl, sizeof(empty_ddl)) != EXIT_SUCCESS) {
             logmsg(LOG_ERROR, "Cannot create empty object of type [%s]- this is not supported.", part[DEPTH_TYPE]);
 
-            fs_path_free(part);
             // @todo - support other object types
             return -EINVAL; // invalid argument
         }
 
-        qry_exec_ddl(object_schema, object_name, empty_ddl);
+        // object is created by the first DDL written to this file (see fs_release), until then it only exists locally
+        if (qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &fname) != EXIT_SUCCESS) {
+            return -ENOMEM;
+        }
+        if (access(fname, F_OK) == 0)
+            tfs_rmfile(fname);
 
-        fs_path_free(part);
-    }
+        int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            logmsg(LOG_ERROR, "fs_create() - unable to create cache file [%s], errno=%d", fname, errno);
+            free(fname);
+            return -EIO;
+        }
+        close(fd);
 
-    if (object_type != NULL)
-        free(object_type);
+        if (cmp_create(path) != EXIT_SUCCESS) {
+            tfs_rmfile(fname);
+            free(fname);
+            return -ENOMEM;
+        }
 
-    if (object_name != NULL)
-        free(object_name);
+        free(fname);
+        created = 1;
+    }
 
-    if (object_schema != NULL)
-        free(object_schema);
+    int r = fs_open(path, fi);
 
-    return fs_open(path, fi);
+    // even if nothing is written, its object is created (from template) on release
+    if (r == 0 && created)
+        FS_HANDLE(fi)->dirty = 1;
+    return r;
 }
 
 int fs_truncate(const char *path,
@@ -831,48 +997,68 @@ int fs_truncate(const char *path,
     logmsg(LOG_INFO, "fs_truncate() - [%s] to [%d] bytes", path, size);
 	
 	char *fname;
-    char **part;
-    int depth = fs_path_create(&part, path);
+    t_fs_path fp;
+    char **part = fp.part;
+
+    if (ovl_is_scratch(path))
+        return ovl_truncate(path, size);
+
+    int depth = fs_path_split(&fp, path);
 	if (depth == -1)
 		return -ENOENT;
 
     if (depth != DEPTH_MAX) {
         logmsg(LOG_ERROR, "fs_truncate() - you can only truncate files in depth 3 (sql files)");
-        fs_path_free(part);
         return -1;
     }
 
+    if (st_wait() != EXIT_SUCCESS) {
+        return -EIO;
+    }
+
+    // queued DDL of the file must not be read while it is being truncated
+    if (cmp_writer_open(path) != EXIT_SUCCESS)
+        return -ENOMEM;
+
     qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &fname);
+
+    if (tfs_unshare(fname) != EXIT_SUCCESS) {
+        free(fname);
+        cmp_writer_close(path);
+        return -EIO;
+    }
 	
 #ifdef _MSC_VER
 	int fd = open(fname, O_RDWR);
 	
 	if (fd < 0) {
 		logmsg(LOG_ERROR, "fs_truncate(), unable to open file descriptor for file to be truncated");
-		fs_path_free(part);
 		free(fname);
+		cmp_writer_close(path);
 		return -1;
 	}
 
 	if (_chsize(fd, size) == -1) {
 		logmsg(LOG_ERROR, "fs_truncate(), unable to call _chsize(%d, %d), ", fd, size);
-		fs_path_free(part);
+		close(fd);
 		free(fname);
+		cmp_writer_close(path);
 		return -1;
 	}
 
 	close(fd);
 #else
 	if (truncate(fname, size) == -1) {
-		logmsg(LOG_ERROR, "fs_truncate() - unable to truncate [%s], errno=[%d]", fname, errno);
-		fs_path_free(part);
+        int err = errno;
+		logmsg(LOG_ERROR, "fs_truncate() - unable to truncate [%s], errno=[%d]", fname, err);
 		free(fname);
-		return -errno;
+        cmp_writer_close(path);
+		return -err;
 	}
 #endif
 
-    fs_path_free(part);
     free(fname);
+    cmp_writer_close(path);
     return 0;
 }
 
@@ -886,75 +1072,75 @@ int fs_truncate_win(const char* path,
 int fs_truncate_lnx(const char* path,
                     off_t size,
                     struct fuse_file_info* fi) {
-    return fs_truncate(path, size);
+    int r = fs_truncate(path, size);
+    // e.g. ftruncate of file opened for writing
+    if (r == 0 && fi != NULL && FS_HANDLE(fi) != NULL)
+        FS_HANDLE(fi)->dirty = 1;
+    return r;
 }
 #endif
 
 
+// remove file entry (without reloading its directory), see fs_unlink
+static void fs_vfs_remove(char **part) {
+    t_fsentry *vfs_schema = vfs_entry_search(g_vfs, part[DEPTH_SCHEMA]);
+    t_fsentry *vfs_type = (vfs_schema == NULL ? NULL : vfs_entry_search(vfs_schema, part[DEPTH_TYPE]));
+    if (vfs_type != NULL && vfs_entry_remove(vfs_type, part[DEPTH_OBJECT]) == EXIT_SUCCESS)
+        logmsg(LOG_DEBUG, "fs_unlink() - removed [%s] from vfs", part[DEPTH_OBJECT]);
+}
+
 int fs_unlink(const char *path) {
     logmsg(LOG_INFO, "fs_unlink() - [%s]", path);
+
+    if (ovl_is_scratch(path))
+        return ovl_unlink(path);
 	
     char drop_ddl[1024] = "";
-    char *object_type = NULL;
     char *object_name = NULL;
     char *object_schema = NULL;
 
-	char **part;
-	int depth = fs_path_create(&part, path);
+	t_fs_path fp;
+	int depth = fs_path_split(&fp, path);
+	char **part = fp.part;
 	if (depth == -1)
 		return -ENOENT;
 	
     if (depth != 3) {
         logmsg(LOG_ERROR, "fs_unlink() - Cannot unlink objects which are not at level 3");
-        fs_path_free(part);
         return -EINVAL;
     }
-    if (str_fn2obj(&object_type, part[DEPTH_TYPE], NULL) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "fs_unlink() - unable to convert object to file name");
-        fs_path_free(part);
-        return -ENOMEM;
+
+    if (st_wait() != EXIT_SUCCESS) {
+        return -EIO;
+    }
+    if (cmp_cancel(path) == 1) {
+        // object was never created in database, only local file is removed
+        logmsg(LOG_INFO, "fs_unlink() - [%s] only existed locally, nothing to drop.", path);
+        char *cache_fn = NULL;
+        if (qry_object_fname(part[DEPTH_SCHEMA], part[DEPTH_TYPE], part[DEPTH_OBJECT], &cache_fn) == EXIT_SUCCESS &&
+            access(cache_fn, F_OK) == 0)
+            tfs_rmfile(cache_fn);
+        free(cache_fn);
+
+        fs_vfs_remove(part);
+        return 0;
+    }
+
+    const t_objtype *ot = ot_by_fs(part[DEPTH_TYPE]);
+    if (ot == NULL || ot->droppable == 0) {
+        logmsg(LOG_ERROR, "fs_unlink() - Cannot drop object %s.%s, operation not (yet?) supported.",
+            part[DEPTH_SCHEMA], part[DEPTH_OBJECT]);
+        return -EINVAL;
     }
     if (str_fn2obj(&object_name, part[DEPTH_OBJECT], part[DEPTH_TYPE]) != EXIT_SUCCESS) {
         logmsg(LOG_ERROR, "fs_unlink() - unable to convert object to file name");
-        fs_path_free(part);
         return -ENOMEM;
     }
     if (str_fn2obj(&object_schema, part[DEPTH_SCHEMA], NULL) != EXIT_SUCCESS) {
         logmsg(LOG_ERROR, "fs_unlink() - unable to convert schema to file name");
-        fs_path_free(part);
         return -ENOMEM;
     }
-
-    if (strcmp(object_type, "PROCEDURE") == 0)
-        snprintf(drop_ddl, 1023, "DROP PROCEDURE \"%s\".\"%s\"",            object_schema, object_name);
-    else if (strcmp(object_type, "FUNCTION") == 0)
-        snprintf(drop_ddl, 1023, "DROP FUNCTION \"%s\".\"%s\"",             object_schema, object_name);
-    else if (strcmp(object_type, "VIEW") == 0)
-        snprintf(drop_ddl, 1023, "DROP VIEW \"%s\".\"%s\"",                 object_schema, object_name);
-    else if (strcmp(object_type, "TYPE") == 0)
-        snprintf(drop_ddl, 1023, "DROP TYPE \"%s\".\"%s\"",                 object_schema, object_name);
-    else if (strcmp(object_type, "TYPE_BODY") == 0)
-        snprintf(drop_ddl, 1023, "DROP TYPE BODY \"%s\".\"%s\"",            object_schema, object_name);
-    else if (strcmp(object_type, "PACKAGE_SPEC") == 0)
-        snprintf(drop_ddl, 1023, "DROP PACKAGE \"%s\".\"%s\"",              object_schema, object_name);
-    else if (strcmp(object_type, "PACKAGE_BODY") == 0)
-        snprintf(drop_ddl, 1023, "DROP PACKAGE BODY \"%s\".\"%s\"",         object_schema, object_name);
-    else if (strcmp(object_type, "JAVA_SOURCE") == 0)
-        snprintf(drop_ddl, 1023, "DROP JAVA SOURCE \"%s\".\"%s\"",          object_schema, object_name);
-    else if (strcmp(object_type, "TRIGGER") == 0)
-        snprintf(drop_ddl, 1023, "DROP TRIGGER \"%s\".\"%s\"",              object_schema, object_name);
-    else if (strcmp(object_type, "TABLE") == 0)
-        snprintf(drop_ddl, 1023, "DROP TABLE \"%s\".\"%s\"",                object_schema, object_name);
-    else if (strcmp(object_type, "MATERIALIZED_VIEW") == 0)
-        snprintf(drop_ddl, 1023, "DROP MATERIALIZED VIEW \"%s\".\"%s\"",    object_schema, object_name);
-    else {
-        logmsg(LOG_ERROR, "fs_unlink() - Cannot drop object %s.%s, operation not (yet?) supported.",
-            part[DEPTH_SCHEMA], part[DEPTH_OBJECT]);
-        fs_path_free(part);
-        return -EINVAL;
-    }
-
-    qry_exec_ddl(object_schema, object_name, drop_ddl);
+    snprintf(drop_ddl, sizeof(drop_ddl), "DROP %s \"%s\".\"%s\"", ot->ora_name, object_schema, object_name);
 
     // delete cache file
     char *cache_fn = NULL;
@@ -965,24 +1151,17 @@ int fs_unlink(const char *path) {
     if (access(cache_fn, F_OK) == 0)
         tfs_rmfile(cache_fn);
 
-    // remove vfs vfs_etry
-    t_fsentry *vfs_schema = vfs_entry_search(g_vfs, part[DEPTH_SCHEMA]);
-    if (vfs_schema != NULL) {
-        t_fsentry *vfs_type = vfs_entry_search(vfs_schema, part[DEPTH_TYPE]);
-        if (vfs_type != NULL) {
-            vfs_entry_free(vfs_type, 1);
-            logmsg(LOG_DEBUG, "fs_unlink() - cleared vfs for [%s]/[%s]", vfs_schema->fname, vfs_type->fname);
-        }
-    }
+    // file is gone right away, DROP is executed by compile worker along with other DROPs (e.g. rm *)
+    fs_vfs_remove(part);
+    if (cmp_drop(path, ot, object_schema, object_name, strdup(drop_ddl)) != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "fs_unlink() - unable to queue [%s]", drop_ddl);
+    object_schema = NULL;
+    object_name = NULL;
 
     // cleanup
-    fs_path_free(part);
     if (cache_fn != NULL)
         free(cache_fn);
 
-    if (object_type != NULL)
-        free(object_type);
-
     if (object_schema != NULL)
         free(object_schema);
 
@@ -91,3 +91,8 @@ int fs_truncate_lnx(const char* path,
  
 int fs_unlink(const char *path);
 
+#ifndef _MSC_VER
+void* fs_init_lnx(struct fuse_conn_info *conn,
+                  struct fuse_config *cfg);
+#endif
+
@@ -9,6 +9,7 @@
 #include <time.h>
 #ifndef  _MSC_VER
 	#include <syslog.h>
+	#include <pthread.h>
 #else
 	#pragma warning(disable:4996) // Disable warnings like: "This function or variable may be unsafe. Consider using sscanf_s instead."
 #endif
@@ -19,8 +20,13 @@
 
 static void get_datestr(char* datestr, unsigned long bufsize) {
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(datestr, bufsize, "%Y-%m-%d %H:%M:%S", t);
+    struct tm t;
+#ifndef _MSC_VER
+    localtime_r(&now, &t); // logmsg is also called from worker threads
+#else
+    localtime_s(&t, &now);
+#endif
+    strftime(datestr, bufsize, "%Y-%m-%d %H:%M:%S", &t);
 }
 
 static const char* get_levelstr(int level) {
@@ -45,18 +51,17 @@ static int get_levelint(char* level) {
 }
 
 void logmsg(int level, const char *msg, ...) {
+    // debug messages are on every fuse call, they must not cost anything unless they're written
+    if (level != LOG_ERROR && level > get_levelint(g_conf.loglevel))
+        return;
+
     char datestr[100];
     get_datestr(datestr, sizeof(datestr)-1);
     
     va_list args;
     va_start(args, msg);
     
-    char *format = calloc(200, sizeof(char));
-    if (format == NULL) {
-        fprintf(stderr, "logmsg() - unable to calloc!");
-        fprintf(stderr, "last message: [%s]", msg);
-        return;
-    }
+    char format[200];
     strcpy(format, datestr);
     strcat(format, " ");
     strcat(format, get_levelstr(level)); // "2017-07-20 16:58:39 INFO "
@@ -81,17 +86,27 @@ void logmsg(int level, const char *msg, ...) {
 #endif
     }
 
-    free(format);
-    
     va_end(args);
 }
 
+// ddlfs.log is written by compile worker (see compile.h) and read by fuse thread
+#ifndef _MSC_VER
+static pthread_mutex_t logddl_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define LOGDDL_LOCK   pthread_mutex_lock(&logddl_mutex)
+#define LOGDDL_UNLOCK pthread_mutex_unlock(&logddl_mutex)
+#else
+#define LOGDDL_LOCK
+#define LOGDDL_UNLOCK
+#endif
+
 void logddl(const char *msg, ...) { 
     
+    LOGDDL_LOCK;
     if (g_ddl_log_buf == NULL) {
         g_ddl_log_buf = calloc(DDL_LOG_SIZE, sizeof(char));
         g_ddl_log_len = 0;
         if (g_ddl_log_buf == NULL) {
+            LOGDDL_UNLOCK;
             logmsg(LOG_ERROR, "logddl() - Unable to allocate memory for in-memory contents of ddlfs.log, size=[%d]", DDL_LOG_SIZE);
             logmsg(LOG_ERROR, msg);
             return;
@@ -105,8 +120,10 @@ void logddl(const char *msg, ...) {
     if (DDL_LOG_SIZE - g_ddl_log_len < 500) {
         char *temp = calloc(DDL_LOG_SIZE, sizeof(char));
         if (temp == NULL) {
+            LOGDDL_UNLOCK;
             logmsg(LOG_ERROR, "logddl() - Unable to re-allocate memory for in-memory contents of ddlfs.log, size=[%d]", DDL_LOG_SIZE);
             logmsg(LOG_ERROR, msg);
+            va_end(args);
             return;
         }
         int half = DDL_LOG_SIZE / 2;
@@ -122,8 +139,25 @@ void logddl(const char *msg, ...) {
     strcat(g_ddl_log_buf, "\n");
 
     g_ddl_log_len = strlen(g_ddl_log_buf);
+    g_ddl_log_time = time(NULL);
+    LOGDDL_UNLOCK;
     //logmsg(LOG_DEBUG, "ddlfs.log len=[%d]", g_ddl_log_len);
     free(line);
     va_end(args);
 }
 
+size_t logddl_read(char *buf, size_t size, size_t offset) {
+    LOGDDL_LOCK;
+    if (g_ddl_log_buf == NULL || offset >= g_ddl_log_len) {
+        LOGDDL_UNLOCK;
+        return 0;
+    }
+
+    if (offset + size > g_ddl_log_len)
+        size = g_ddl_log_len - offset;
+
+    memcpy(buf, g_ddl_log_buf + offset, size);
+    LOGDDL_UNLOCK;
+    return size;
+}
+
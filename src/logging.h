@@ -24,3 +24,6 @@ void logmsg(int level, const char *msg, ...);
 // log message to g_ddl_log circular log buffer
 void logddl(const char *msg, ...);
 
+// copy up to size bytes of g_ddl_log (starting at offset) to buf, return number of bytes copied
+size_t logddl_read(char *buf, size_t size, size_t offset);
+
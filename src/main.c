@@ -20,7 +20,13 @@
 #include "oracle.h"
 #include "query.h"
 #include "vfs.h"
+#include "util.h"
 #include "tempfs.h"
+#include "prefetch.h"
+#include "startup.h"
+#include "compile.h"
+#include "overlay.h"
+#include "stream.h"
 #include "dbro_refresh.h"
 
 #define DDLFS_VERSION "3.0-RC2"
@@ -65,6 +71,7 @@ int main(int argc, char *argv[]) {
 	strcpy(g_conf.loglevel, "INFO");
 
     g_ddl_log_time = time(NULL);
+    utl_time_init();
 
     logmsg(LOG_INFO, "DDL Filesystem v%s for Oracle Database, FUSE v%d.%d", DDLFS_VERSION, FUSE_MAJOR_VERSION, FUSE_MINOR_VERSION);
 
@@ -109,6 +116,7 @@ int main(int argc, char *argv[]) {
     };
     #else
     struct fuse_operations oper = {
+        .init     = fs_init_lnx,
         .getattr  = fs_getattr_lnx,
         .readdir  = fs_readdir_lnx,
         .read     = fs_read,
@@ -121,43 +129,14 @@ int main(int argc, char *argv[]) {
     };
 	#endif
 
-    if (ora_connect(g_conf.username, g_conf.password, g_conf.database) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "Unable to connect to database.");
-        return EXIT_FAILURE;
-    }
-
-    logmsg(LOG_DEBUG, "is_sysdba=[%d]", g_conf._isdba);
-	
-    if (g_conf.dbro == -1) {
-        if (g_conf._isdba == 1) {
-            logmsg(LOG_DEBUG, "neither dbro nor dbrw parameter given, thus trying 'select open_mode from v$database'");
-            g_conf.dbro = ora_get_open_mode();
-            if (g_conf.dbro == -1) {
-                logmsg(LOG_DEBUG, ".. unable to query v$database, assuming the database is opened as read/write");
-                g_conf.dbro = 0;
-            }
-        } else {
-            logmsg(LOG_DEBUG, "assuming database opened as read/write because this user has no (sys)dba privileges (needed to obtain this info).");
-            g_conf.dbro = 0;
-        }
-    }
-    logmsg(LOG_DEBUG, "dbro=[%d]", g_conf.dbro);
+    g_vfs = vfs_entry_create('D', "/", time(NULL), time(NULL));
+    ovl_start();
 
-    if (tfs_mkdir() != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "Unable to initialize temp directory (%s)", g_conf.temppath);
+#ifdef _MSC_VER
+    // connection and cache validation are done before mount (on Linux, they're started by fs_init_lnx)
+    if (st_start() != EXIT_SUCCESS)
         return EXIT_FAILURE;
-    }
-
-    if (g_conf._temppath_reused == 1 && g_conf.dbro == 1) {
-        logmsg(LOG_INFO, "Cache validation started because temppath_reused=[%d] and dbro=[%d]", g_conf._temppath_reused, g_conf.dbro);
-        if (dbr_refresh_cache() != EXIT_SUCCESS) {
-            logmsg(LOG_ERROR, "Cache validation failed");
-            return EXIT_FAILURE;
-        }
-        logmsg(LOG_INFO, "Cache validation completed.");
-    }
-
-    g_vfs = vfs_entry_create('D', "/", time(NULL), time(NULL));
+#endif
 
     logmsg(LOG_DEBUG, " ");
     logmsg(LOG_DEBUG, "-> event-loop <-");
@@ -166,13 +145,31 @@ int main(int argc, char *argv[]) {
 
     logmsg(LOG_DEBUG, " ");
     logmsg(LOG_DEBUG, "-> umount <-");
-    ora_disconnect();
+    st_stop();
+    pf_stop();
+    stm_stop();
+    cmp_stop();
+    ovl_stop();
+    if (st_connected() == 1)
+        ora_disconnect();
+
+    // directory tree is consistent with cache entries (see dbr_refresh_prepare), so the next mount can start with it
+    if (g_conf._temppath_ready == 1 && g_conf.dbro == 1 && g_conf.keepcache == 1 && g_conf.sharedcache == 0) {
+        char snapshot_fn[4096];
+        snprintf(snapshot_fn, sizeof(snapshot_fn), "%s%s%s", g_conf._temppath, PATH_SEP, VFS_SNAPSHOT_FILE);
+        long long mount_pid, mount_stamp;
+        dbr_generation(&mount_pid, &mount_stamp);
+        vfs_invalidate_pending();
+        vfs_snapshot_save(snapshot_fn, mount_pid, mount_stamp);
+    }
 
-    if (g_conf.keepcache == 0) {
+    if (g_conf._temppath_ready == 0) {
+        logmsg(LOG_DEBUG, "Cache directory was never initialized.");
+    } else if (g_conf.keepcache == 0) {
         if (tfs_rmdir(0) != EXIT_SUCCESS)
             logmsg(LOG_ERROR, "Unable to remove cache directory [%s] after mount (config keepcache=%d).", g_conf._temppath, g_conf.keepcache);
         else
-            logmsg(LOG_INFO, "Cache directory [%s] successfully removed (config keepcache=%d)", g_conf._temppath, g_conf.keepcache);        
+            logmsg(LOG_INFO, "Cache directory [%s] moved to trash and is being removed in background (config keepcache=%d)", g_conf._temppath, g_conf.keepcache);        
     } else {
         logmsg(LOG_INFO, "Cache directory [%s] left intact (config keepcache=%d)", g_conf._temppath, g_conf.keepcache);
     }
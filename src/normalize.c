@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "normalize.h"
+
+// SSE2 is part of x86-64, so no compiler flags (and no runtime detection) are needed for it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define NRM_SSE2
+    #include <emmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+static int nrm_is_space(char c) {
+    return (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+}
+
+#ifdef NRM_SSE2
+// index of lowest set bit, mask must not be 0
+static int nrm_ctz(int mask) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, (unsigned long) mask);
+    return (int) idx;
+#else
+    return __builtin_ctz((unsigned int) mask);
+#endif
+}
+#endif
+
+void nrm_upper(char *s, size_t len) {
+    size_t i = 0;
+#ifdef NRM_SSE2
+    // bytes >= 0x80 are negative in signed comparison, so they are never within 'a'..'z'
+    const __m128i lo = _mm_set1_epi8('a' - 1);
+    const __m128i hi = _mm_set1_epi8('z' + 1);
+    const __m128i bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+        __m128i is_lower = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        if (_mm_movemask_epi8(is_lower) != 0)
+            _mm_storeu_si128((__m128i*) (s + i), _mm_xor_si128(v, _mm_and_si128(is_lower, bit)));
+    }
+#endif
+    for (; i < len; i++)
+        if (s[i] >= 'a' && s[i] <= 'z')
+            s[i] = (char) (s[i] - ('a' - 'A'));
+}
+
+size_t nrm_squeeze(char *s, size_t len) {
+    size_t r = 0, w = 0;
+#ifdef NRM_SSE2
+    // chunks without two adjacent spaces are moved as they are (or skipped, if nothing was removed yet)
+    const __m128i sp = _mm_set1_epi8(' ');
+    while (r + 17 <= len) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (s + r));
+        __m128i b = _mm_loadu_si128((const __m128i*) (s + r + 1));
+        if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, sp), _mm_cmpeq_epi8(b, sp))) == 0) {
+            if (w != r)
+                memmove(s + w, s + r, 16);
+            w += 16;
+            r += 16;
+            continue;
+        }
+        for (size_t end = r + 16; r < end; r++)
+            if (s[r] != ' ' || s[r+1] != ' ')
+                s[w++] = s[r];
+    }
+#endif
+    for (; r < len; r++)
+        if (s[r] != ' ' || r+1 >= len || s[r+1] != ' ')
+            s[w++] = s[r];
+    s[w] = '\0';
+    return w;
+}
+
+// check whether candidate at s[i] is the keyword as a whole word
+static int nrm_word_at(const char *s, size_t len, size_t i, const char *kw, size_t kw_len) {
+    return i + kw_len < len &&
+           memcmp(s + i, kw, kw_len) == 0 &&
+           nrm_is_space(s[i + kw_len]) &&
+           (i == 0 || nrm_is_space(s[i - 1]));
+}
+
+char* nrm_find_word(char *s, size_t len, const char *kw) {
+    size_t kw_len = strlen(kw);
+    size_t i = 0;
+    if (kw_len == 0)
+        return NULL;
+#ifdef NRM_SSE2
+    // look for first character of keyword 16 bytes at a time, compare the rest only for candidates
+    const __m128i first = _mm_set1_epi8(kw[0]);
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (s + i)), first));
+        while (mask != 0) {
+            size_t c = i + nrm_ctz(mask);
+            if (nrm_word_at(s, len, c, kw, kw_len))
+                return s + c;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < len; i++)
+        if (s[i] == kw[0] && nrm_word_at(s, len, i, kw, kw_len))
+            return s + i;
+    return NULL;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Normalization of source text fetched from all_source (see qry_object_all_source).
+ * Everything works in place on the fetch buffer, 16 bytes at a time with SSE2 where it is
+ * available (any x86-64 build) and byte by byte otherwise. Only ASCII letters are case folded,
+ * which is all keyword matching needs (and what toupper() did in "C" locale).
+ * */
+
+/**
+ * Convert ASCII letters of s (len bytes) to uppercase.
+ * */
+void nrm_upper(char *s, size_t len);
+
+/**
+ * Replace runs of spaces in s (len bytes) with single space, returns new length (s is terminated with '\0').
+ * */
+size_t nrm_squeeze(char *s, size_t len);
+
+/**
+ * Return first occurrence of uppercase keyword kw in s (len bytes) as a whole word (preceded by start of
+ * text or whitespace and followed by whitespace), NULL if there is none. s must be uppercase already.
+ * */
+char* nrm_find_word(char *s, size_t len, const char *kw);
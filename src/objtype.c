@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "objtype.h"
+
+// rows are in order of their ids (see objtype.h)
+static const t_objtype ot_types[OT_COUNT] = {
+    { OT_FUNCTION, "FUNCTION", "FUNCTION", ".SQL", 1, 1, 1, 2, 8, OT_FETCH_SOURCE, OT_RELATED_NONE, NULL,
+        "CREATE FUNCTION \"%s\".\"%s\" RETURN NUMBER AS\nBEGIN\n    RETURN NULL;\nEND;" },
+    // CREATE AND COMPILE JAVA SOURCE is prepended (and last character dropped) when DDL is executed, schema is not used (%.0s)
+    { OT_JAVA_SOURCE, "JAVA_SOURCE", "JAVA SOURCE", ".JAVA", 1, 1, 1, 4, 28, OT_FETCH_JAVA, OT_RELATED_NONE, NULL,
+        "public class %.0s%s {\n}\n" },
+    { OT_MATERIALIZED_VIEW, "MATERIALIZED_VIEW", "MATERIALIZED VIEW", ".SQL", 1, 0, 1, 4, 42, OT_FETCH_MVIEW, OT_RELATED_NONE, NULL,
+        NULL },
+    { OT_PACKAGE_BODY, "PACKAGE_BODY", "PACKAGE BODY", ".SQL", 1, 1, 1, 5, 11, OT_FETCH_SOURCE, OT_RELATED_NAME, "'PACKAGE', 'PACKAGE BODY'",
+        "CREATE PACKAGE BODY \"%s\".\"%s\" AS\n\nEND;" },
+    { OT_PACKAGE_SPEC, "PACKAGE_SPEC", "PACKAGE", ".SQL", 1, 1, 1, 1, 9, OT_FETCH_SOURCE, OT_RELATED_NAME, "'PACKAGE', 'PACKAGE BODY'",
+        "CREATE PACKAGE \"%s\".\"%s\" AS\n\nEND;" },
+    { OT_PROCEDURE, "PROCEDURE", "PROCEDURE", ".SQL", 1, 1, 1, 2, 7, OT_FETCH_SOURCE, OT_RELATED_NONE, NULL,
+        "CREATE PROCEDURE \"%s\".\"%s\" AS\nBEGIN\n    NULL;\nEND;" },
+    { OT_TABLE, "TABLE", "TABLE", ".SQL", 1, 0, 1, 4, 2, OT_FETCH_TABLE, OT_RELATED_TRIGGERS, NULL,
+        NULL },
+    { OT_TRIGGER, "TRIGGER", "TRIGGER", ".SQL", 1, 1, 1, 4, 12, OT_FETCH_TRIGGER, OT_RELATED_NONE, NULL,
+        NULL },
+    { OT_TYPE, "TYPE", "TYPE", ".SQL", 1, 1, 1, 0, 13, OT_FETCH_SOURCE, OT_RELATED_NAME, "'TYPE', 'TYPE BODY'",
+        "CREATE TYPE \"%s\".\"%s\" AS OBJECT(\nn NUMBER)" },
+    { OT_TYPE_BODY, "TYPE_BODY", "TYPE BODY", ".SQL", 1, 1, 1, 5, 14, OT_FETCH_SOURCE, OT_RELATED_NAME, "'TYPE', 'TYPE BODY'",
+        "CREATE TYPE BODY \"%s\".\"%s\" AS\n\nEND;" },
+    { OT_VIEW, "VIEW", "VIEW", ".SQL", 1, 1, 1, 3, 4, OT_FETCH_VIEW, OT_RELATED_NONE, NULL,
+        "CREATE VIEW \"%s\".\"%s\" AS\nSELECT * FROM dual" },
+    { OT_JAVA_CLASS, "JAVA_CLASS", "JAVA CLASS", ".CLASS", 0, 0, 0, 4, 29, OT_FETCH_SOURCE, OT_RELATED_NONE, NULL,
+        NULL },
+    // suffix might be anything really, like .properties, .xml, .ini, ...
+    { OT_JAVA_RESOURCE, "JAVA_RESOURCE", "JAVA RESOURCE", ".RES", 0, 0, 0, 4, 30, OT_FETCH_SOURCE, OT_RELATED_NONE, NULL,
+        NULL }
+};
+
+const t_objtype* ot_get(int id) {
+    if (id < 0 || id >= OT_COUNT)
+        return NULL;
+    return &ot_types[id];
+}
+
+const t_objtype* ot_by_fs(const char *fs_name) {
+    for (int i = 0; i < OT_COUNT; i++)
+        if (strcmp(ot_types[i].fs_name, fs_name) == 0)
+            return &ot_types[i];
+    return NULL;
+}
+
+const t_objtype* ot_by_ora(const char *ora_name) {
+    for (int i = 0; i < OT_COUNT; i++)
+        if (strcmp(ot_types[i].ora_name, ora_name) == 0)
+            return &ot_types[i];
+    return NULL;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * Object types supported by the filesystem, described by one static table.
+ * Everything that depends on object type (file suffix, Oracle name, templates of new objects, DROP,
+ * how source is fetched, ...) is looked up in this table, so a new type only needs a new row.
+ * Type directories (and objects within them) keep id of their type in t_fsentry.otype.
+ * */
+
+// ids are indexes into the table, OT_NONE is used for entries which aren't (in) type directories
+#define OT_NONE -1
+enum {
+    OT_FUNCTION,
+    OT_JAVA_SOURCE,
+    OT_MATERIALIZED_VIEW,
+    OT_PACKAGE_BODY,
+    OT_PACKAGE_SPEC,
+    OT_PROCEDURE,
+    OT_TABLE,
+    OT_TRIGGER,
+    OT_TYPE,
+    OT_TYPE_BODY,
+    OT_VIEW,
+    OT_JAVA_CLASS,
+    OT_JAVA_RESOURCE,
+    OT_COUNT
+};
+
+// how source of object is fetched from database (see qry_object)
+typedef enum {
+    OT_FETCH_SOURCE,   // all_source, prefixed with CREATE OR REPLACE
+    OT_FETCH_JAVA,     // all_source, as it is
+    OT_FETCH_TRIGGER,  // all_source, with header of trigger replaced
+    OT_FETCH_VIEW,     // all_views
+    OT_FETCH_MVIEW,    // all_mviews
+    OT_FETCH_TABLE     // assembled from table metadata (see query_tables.c)
+} t_ot_fetch;
+
+// objects which are likely to be opened after object of this type, they're prefetched (see qry_related)
+typedef enum {
+    OT_RELATED_NONE,
+    OT_RELATED_NAME,     // objects of the same name with one of related_types, e.g. package body of package spec
+    OT_RELATED_TRIGGERS  // triggers on the table
+} t_ot_related;
+
+typedef struct {
+    int         id;
+    const char *fs_name;     // name of type directory, e.g. PACKAGE_BODY
+    const char *ora_name;    // all_objects.object_type, e.g. PACKAGE BODY
+    const char *suffix;      // suffix of object files, e.g. .SQL
+    int         listed;      // 1=type directory is shown in every schema (see qry_types)
+    int         writable;    // 0=DDL is not executed on close, as object cannot be "create or replace"d
+    int         droppable;   // 1=DROP <ora_name> is executed when file is removed
+    int         rank;        // order of DDL within compile batch (see compile.c)
+    int         obj_type_num; // sys.obj$.type# (see qry_last_ddl_time)
+    t_ot_fetch  fetch;
+    t_ot_related related;    // see qry_related
+    const char *related_types; // SQL list of related all_objects.object_type (only for OT_RELATED_NAME)
+    const char *create_tpl;  // content of new (empty) file, formatted with schema and object name; NULL=not supported
+} t_objtype;
+
+/**
+ * Return type by its id, NULL for OT_NONE (or invalid id).
+ * */
+const t_objtype* ot_get(int id);
+
+/**
+ * Return type by filesystem name (e.g. PACKAGE_BODY), NULL if it's not supported.
+ * */
+const t_objtype* ot_by_fs(const char *fs_name);
+
+/**
+ * Return type by Oracle name (e.g. PACKAGE BODY), NULL if it's not supported.
+ * */
+const t_objtype* ot_by_ora(const char *ora_name);
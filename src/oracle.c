@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #ifdef _MSC_VER
 	#pragma warning(disable:4996)
 #endif
@@ -13,6 +14,19 @@
 #define MAJOR_NUMVSN(v) ((sword)(((v) >> 24) & 0x000000FF))      /* version number */ 
 #define MINOR_NUMRLS(v) ((sword)(((v) >> 20) & 0x0000000F))      /* release number */
 
+#ifdef _MSC_VER
+	#define ORA_THREAD_LOCAL __declspec(thread)
+#else
+	#define ORA_THREAD_LOCAL _Thread_local
+#endif
+
+// connection used by calling thread, NULL means g_connection (main thread)
+static ORA_THREAD_LOCAL struct s_connection *ora_conn_tls = NULL;
+
+static inline struct s_connection* ora_conn() {
+    return (ora_conn_tls == NULL ? &g_connection : ora_conn_tls);
+}
+
 sword ora_check(sword status) {
     text errbuf[512];
     sb4 errcode;
@@ -23,7 +37,7 @@ sword ora_check(sword status) {
   
         case OCI_SUCCESS_WITH_INFO:
             OCIErrorGet(
-                g_connection.err, (ub4) 1, (text *) NULL, &errcode, errbuf, 
+                ora_conn()->err, (ub4) 1, (text *) NULL, &errcode, errbuf, 
                 (ub4) sizeof(errbuf), (ub4) OCI_HTYPE_ERROR);
             if (errcode != 24347) //ORA-24347: Warning of a NULL column in an aggregate function (any query on user_role_privs will produce this warning on 11.2.0.3
                 logmsg(LOG_ERROR, "OCI_SUCCESS_WITH_INFO: ORA-%d: %s", errcode, (char *)errbuf);
@@ -39,7 +53,7 @@ sword ora_check(sword status) {
 
         case OCI_ERROR:
             OCIErrorGet(
-                g_connection.err, (ub4) 1, (text *) NULL, &errcode, errbuf, 
+                ora_conn()->err, (ub4) 1, (text *) NULL, &errcode, errbuf, 
                 (ub4) sizeof(errbuf), (ub4) OCI_HTYPE_ERROR);
             logmsg(LOG_ERROR, "errcode=%d||%s", errcode, (char *)errbuf);
             break;
@@ -102,15 +116,53 @@ qry_catalog_role_cleanup:
     return retval;
 }
 
-int ora_connect(char* username, char* password, char* database) {
+// identity of the database (and pluggable database) we're connected to, used to name shared cache
+static int qry_dbid() {
+    const char *query_fmt =
+"select sys_context('USERENV', 'DBID') as dbid, %s as con_dbid from dual";
+
+    char query[200];
+    int retval = EXIT_SUCCESS;
+
+    // CON_DBID is only available since 12.1
+    if (g_conf._server_version <= 1102)
+        snprintf(query, 200, query_fmt, "null");
+    else
+        snprintf(query, 200, query_fmt, "sys_context('USERENV', 'CON_DBID')");
+
+    ORA_STMT_PREPARE(qry_dbid);
+    ORA_STMT_DEFINE_STR_I(qry_dbid, 1, dbid,     40);
+    ORA_STMT_DEFINE_STR_I(qry_dbid, 2, con_dbid, 40);
+    ORA_STMT_EXECUTE(qry_dbid, 1);
+
+    snprintf(g_conf._dbid, 100, "%s.%s", ORA_NVL(dbid, "0"), ORA_NVL(con_dbid, "0"));
+    logmsg(LOG_DEBUG, ".. database identity is [%s]", g_conf._dbid);
+
+qry_dbid_cleanup:
+    ORA_STMT_FREE;
+    return retval;
+}
+
+// use threaded OCI environment when other threads (prefetch workers) have their own database sessions
+// on Linux, database is used by background threads (startup.c, prefetch.c) as well
+static ub4 ora_env_mode() {
+#ifndef _MSC_VER
+    return OCI_THREADED;
+#else
+    return (g_conf.prefetch > 0 ? OCI_THREADED : OCI_DEFAULT);
+#endif
+}
+
+// allocate handles and start new database session in conn (this includes switch to g_conf.pdb)
+static int ora_session_open(struct s_connection *conn, char* username, char* password, char* database) {
 	sword r = 0;
 
-	g_connection.env = 0;
-	g_connection.err = 0;
-	g_connection.srv = 0;
-	g_connection.svc = 0;
-	g_connection.ses = 0;
-	g_connection.read_only = 0;
+	conn->env = 0;
+	conn->err = 0;
+	conn->srv = 0;
+	conn->svc = 0;
+	conn->ses = 0;
+	conn->read_only = 0;
     
     // https://docs.oracle.com/cd/E11882_01/appdev.112/e10646/oci16rel001.htm#LNOCI17121
     ub4 auth_type = OCI_CRED_RDBMS;
@@ -119,11 +171,8 @@ int ora_connect(char* username, char* password, char* database) {
     if (strncmp(username, "/", 1) == 0)
         auth_type = OCI_CRED_EXT;
 
-    g_conf._isdba = 0;
-    if (g_conf.userrole != NULL && strcmp(g_conf.userrole, "SYSDBA") == 0) {
+    if (g_conf.userrole != NULL && strcmp(g_conf.userrole, "SYSDBA") == 0)
         user_role = OCI_SYSDBA;
-        g_conf._isdba = 1;
-    }
 
     if (g_conf.userrole != NULL && strcmp(g_conf.userrole, "SYSOPER") == 0)
         user_role = OCI_SYSOPER;
@@ -134,30 +183,30 @@ int ora_connect(char* username, char* password, char* database) {
     if (auth_type == OCI_CRED_EXT)
         logmsg(LOG_DEBUG, ".. using external authentication.");
 
-    r = OCIEnvCreate(&g_connection.env, OCI_DEFAULT, 0, 0, 0, 0, 0, 0);
+    r = OCIEnvCreate(&conn->env, ora_env_mode(), 0, 0, 0, 0, 0, 0);
     if (ora_check(r) != OCI_SUCCESS)
         return EXIT_FAILURE;
 
     logmsg(LOG_DEBUG, ".. allocating handles.");
-    OCIHandleAlloc(g_connection.env, (dvoid**)&g_connection.err, OCI_HTYPE_ERROR,   0, 0);
-    OCIHandleAlloc(g_connection.env, (dvoid**)&g_connection.srv, OCI_HTYPE_SERVER,  0, 0);
-    OCIHandleAlloc(g_connection.env, (dvoid**)&g_connection.svc, OCI_HTYPE_SVCCTX,  0, 0);
-    OCIHandleAlloc(g_connection.env, (dvoid**)&g_connection.ses, OCI_HTYPE_SESSION, 0, 0);
+    OCIHandleAlloc(conn->env, (dvoid**)&conn->err, OCI_HTYPE_ERROR,   0, 0);
+    OCIHandleAlloc(conn->env, (dvoid**)&conn->srv, OCI_HTYPE_SERVER,  0, 0);
+    OCIHandleAlloc(conn->env, (dvoid**)&conn->svc, OCI_HTYPE_SVCCTX,  0, 0);
+    OCIHandleAlloc(conn->env, (dvoid**)&conn->ses, OCI_HTYPE_SESSION, 0, 0);
     
     if (strcmp(g_conf.database, "/") == 0) {
         logmsg(LOG_DEBUG, ".. attaching to server process to *DEFAULT* host.");
         if (auth_type == OCI_CRED_EXT)
             r = OCIServerAttach(
-                g_connection.srv,
-                g_connection.err,
+                conn->srv,
+                conn->err,
                 NULL,
                 0,
                 (ub4) OCI_DEFAULT);
     } else {
         logmsg(LOG_DEBUG, ".. attaching server process.");
         r = OCIServerAttach(
-            g_connection.srv, 
-            g_connection.err, 
+            conn->srv, 
+            conn->err, 
             (text*) database, 
             (sb4) (strlen(database)),
             (ub4) OCI_DEFAULT);
@@ -167,37 +216,23 @@ int ora_connect(char* username, char* password, char* database) {
         return EXIT_FAILURE;
     
     logmsg(LOG_DEBUG, ".. setting session attributes (username=%s).", username);
-    OCIAttrSet(g_connection.svc, OCI_HTYPE_SVCCTX, g_connection.srv, 0, OCI_ATTR_SERVER, g_connection.err);
+    OCIAttrSet(conn->svc, OCI_HTYPE_SVCCTX, conn->srv, 0, OCI_ATTR_SERVER, conn->err);
 
     if (auth_type == OCI_CRED_RDBMS) {
-        OCIAttrSet(g_connection.ses, OCI_HTYPE_SESSION, username, (sb4) (strlen(username)), OCI_ATTR_USERNAME, g_connection.err); 
-        OCIAttrSet(g_connection.ses, OCI_HTYPE_SESSION, password, (sb4) (strlen(password)), OCI_ATTR_PASSWORD, g_connection.err);
+        OCIAttrSet(conn->ses, OCI_HTYPE_SESSION, username, (sb4) (strlen(username)), OCI_ATTR_USERNAME, conn->err); 
+        OCIAttrSet(conn->ses, OCI_HTYPE_SESSION, password, (sb4) (strlen(password)), OCI_ATTR_PASSWORD, conn->err);
     }
 
     logmsg(LOG_DEBUG, ".. starting [%s] database session.", (g_conf.userrole[0] == '\0' ? "default" : g_conf.userrole));
     if (ora_check(OCISessionBegin (
-        g_connection.svc, 
-        g_connection.err, 
-        g_connection.ses,
+        conn->svc, 
+        conn->err, 
+        conn->ses,
         auth_type, user_role)))
             return EXIT_FAILURE;
 
     logmsg(LOG_DEBUG, ".. registering database session.");
-    OCIAttrSet(g_connection.svc, OCI_HTYPE_SVCCTX, g_connection.ses, 0, OCI_ATTR_SESSION, g_connection.err);
-
-    logmsg(LOG_DEBUG, ".. determining database version.");
-    char version_str[20] = "";
-    ub4 version_int = 0;
-    if (ora_check(OCIServerRelease( g_connection.svc, g_connection.err,  
-                         (OraText*) version_str, 20, OCI_HTYPE_SVCCTX, 
-                         &version_int)))
-        return EXIT_FAILURE;
-    
-    int major = MAJOR_NUMVSN(version_int);
-    int minor = MINOR_NUMRLS(version_int);
-    g_conf._server_version = major*100+minor;
-    logmsg(LOG_DEBUG, ".. connected to server version [%s] [%d]", version_str, g_conf._server_version);
-
+    OCIAttrSet(conn->svc, OCI_HTYPE_SVCCTX, conn->ses, 0, OCI_ATTR_SESSION, conn->err);
 
     if (g_conf.pdb != NULL && g_conf.pdb[0] != '\0') {
         OCIStmt *o_stm = NULL;
@@ -220,6 +255,31 @@ int ora_connect(char* username, char* password, char* database) {
             ora_stmt_free(o_stm);
     }
 
+    return EXIT_SUCCESS;
+}
+
+int ora_connect(char* username, char* password, char* database) {
+
+    g_conf._isdba = 0;
+    if (g_conf.userrole != NULL && strcmp(g_conf.userrole, "SYSDBA") == 0)
+        g_conf._isdba = 1;
+
+    if (ora_session_open(&g_connection, username, password, database) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    logmsg(LOG_DEBUG, ".. determining database version.");
+    char version_str[20] = "";
+    ub4 version_int = 0;
+    if (ora_check(OCIServerRelease( g_connection.svc, g_connection.err,  
+                         (OraText*) version_str, 20, OCI_HTYPE_SVCCTX, 
+                         &version_int)))
+        return EXIT_FAILURE;
+    
+    int major = MAJOR_NUMVSN(version_int);
+    int minor = MINOR_NUMRLS(version_int);
+    g_conf._server_version = major*100+minor;
+    logmsg(LOG_DEBUG, ".. connected to server version [%s] [%d]", version_str, g_conf._server_version);
+
     if (g_conf._isdba == 1)
         g_conf._has_catalog_role = 1;
     else {
@@ -234,6 +294,11 @@ int ora_connect(char* username, char* password, char* database) {
             logmsg(LOG_INFO, "Current user does not have access to dba_* views.");
     }
 
+    if (g_conf.sharedcache == 1 && qry_dbid() != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "Unable to query database identity (needed for sharedcache).");
+        return EXIT_FAILURE;
+    }
+
     logmsg(LOG_INFO, ".. connected to database server.");
 
     return EXIT_SUCCESS;
@@ -256,26 +321,62 @@ int ora_disconnect() {
     return 0;
 }
 
+int ora_connect_session(struct s_connection *conn) {
+    ora_conn_tls = conn;
+    if (ora_session_open(conn, g_conf.username, g_conf.password, g_conf.database) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "ora_connect_session() - unable to start additional database session.");
+        ora_disconnect_session(conn);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void ora_disconnect_session(struct s_connection *conn) {
+    if (conn->ses != NULL && conn->svc != NULL)
+        OCISessionEnd(conn->svc, conn->err, conn->ses, OCI_DEFAULT);
+    if (conn->srv != NULL)
+        OCIServerDetach(conn->srv, conn->err, OCI_DEFAULT);
+
+    if (conn->ses != NULL)
+        OCIHandleFree(conn->ses, OCI_HTYPE_SESSION);
+    if (conn->svc != NULL)
+        OCIHandleFree(conn->svc, OCI_HTYPE_SVCCTX);
+    if (conn->srv != NULL)
+        OCIHandleFree(conn->srv, OCI_HTYPE_SERVER);
+    if (conn->err != NULL)
+        OCIHandleFree(conn->err, OCI_HTYPE_ERROR);
+    if (conn->env != NULL)
+        OCIHandleFree(conn->env, OCI_HTYPE_ENV);
+    memset(conn, 0, sizeof(struct s_connection));
+
+    if (ora_conn_tls == conn)
+        ora_conn_tls = NULL;
+}
+
 
 sword ora_stmt_prepare(OCIStmt **stm, const char *query) {
+    return ora_stmt_prepare_len(stm, query, strlen(query));
+}
+
+sword ora_stmt_prepare_len(OCIStmt **stm, const char *query, size_t len) {
     sword r;
 
     sb4 prefetch_memory = ORA_PREFETCH_MEMORY;
     sb4 prefetch_rows = ORA_PREFETCH_ROWS;
 
-    r = OCIHandleAlloc(g_connection.env, (void **) stm, OCI_HTYPE_STMT, 0, 0);
+    r = OCIHandleAlloc(ora_conn()->env, (void **) stm, OCI_HTYPE_STMT, 0, 0);
     if (ora_check(r))
         return r;
 
-    r = OCIStmtPrepare(*stm, g_connection.err, (text*) query, (sb4) strlen(query), OCI_NTV_SYNTAX, OCI_DEFAULT);
+    r = OCIStmtPrepare(*stm, ora_conn()->err, (text*) query, (sb4) len, OCI_NTV_SYNTAX, OCI_DEFAULT);
     if (ora_check(r))
         return r;
     
-    r = OCIAttrSet(*stm, OCI_HTYPE_STMT, &prefetch_memory, sizeof(prefetch_memory), OCI_ATTR_PREFETCH_MEMORY, g_connection.err);
+    r = OCIAttrSet(*stm, OCI_HTYPE_STMT, &prefetch_memory, sizeof(prefetch_memory), OCI_ATTR_PREFETCH_MEMORY, ora_conn()->err);
     if (ora_check(r))
         return r;
 
-    r = OCIAttrSet(*stm, OCI_HTYPE_STMT, &prefetch_rows, sizeof(prefetch_rows), OCI_ATTR_PREFETCH_ROWS, g_connection.err);
+    r = OCIAttrSet(*stm, OCI_HTYPE_STMT, &prefetch_rows, sizeof(prefetch_rows), OCI_ATTR_PREFETCH_ROWS, ora_conn()->err);
     if (ora_check(r))
         return r;
     
@@ -284,47 +385,99 @@ sword ora_stmt_prepare(OCIStmt **stm, const char *query) {
 
 sword ora_stmt_define(OCIStmt *stm, OCIDefine **def, ub4 pos, void *value, sb4 value_size, ub2 dty) {
     sword r = OCIDefineByPos(
-        stm, def, g_connection.err, pos, value, value_size, dty,  
+        stm, def, ora_conn()->err, pos, value, value_size, dty,  
         0, 0, 0, OCI_DEFAULT);
     return ora_check(r);
 }
 
 sword ora_stmt_define_i(OCIStmt *stm, OCIDefine **def, ub4 pos, void *value, sb4 value_size, ub2 dty, dvoid *indp) {
     sword r = OCIDefineByPos(
-        stm, def, g_connection.err, pos, value, value_size, dty, indp, 0, 0, OCI_DEFAULT);
+        stm, def, ora_conn()->err, pos, value, value_size, dty, indp, 0, 0, OCI_DEFAULT);
     return ora_check(r);
 }
 
 sword ora_stmt_bind(OCIStmt *stm, OCIBind **bnd, ub4 pos, void *value, sb4 value_size, ub2 dty) {
     sword r = OCIBindByPos(
-        stm, bnd, g_connection.err, pos, value, value_size, dty, 
+        stm, bnd, ora_conn()->err, pos, value, value_size, dty, 
         0, 0, 0, 0, 0, OCI_DEFAULT);
     return ora_check(r);
 }
 
 sword ora_stmt_execute(OCIStmt *stm, ub4 iters) {
     sword r = OCIStmtExecute(
-        g_connection.svc, stm, g_connection.err, iters,
+        ora_conn()->svc, stm, ora_conn()->err, iters,
         0, 0, 0, OCI_DEFAULT);
     return ora_check(r);
 }
 
 sword ora_stmt_fetch(OCIStmt *stm) {
     sword r = OCIStmtFetch2(
-        stm, g_connection.err, 1, OCI_FETCH_NEXT,
+        stm, ora_conn()->err, 1, OCI_FETCH_NEXT,
         0, OCI_DEFAULT);
     if (r == OCI_NO_DATA)
         return r;
     return ora_check(r);
 }
 
+// write piece returned by previous callback (its actual length is set by OCI)
+static void ora_piece_flush(t_ora_piecewise *pw) {
+    if (pw->pending == 0)
+        return;
+    pw->pending = 0;
+    if (pw->ind == -1 || pw->len == 0)
+        return;
+    errno = 0;
+    if (fwrite(pw->buf, 1, pw->len, pw->fp) != pw->len) {
+        if (pw->error == 0)
+            pw->error = (errno != 0 ? errno : EIO);
+        return;
+    }
+    pw->total += pw->len;
+    if (pw->progress != NULL)
+        pw->progress(pw->fp);
+}
+
+static sb4 ora_piece_cb(dvoid *ctx, OCIDefine *def, ub4 iter, dvoid **bufpp, ub4 **alenpp, ub1 *piecep, dvoid **indpp, ub2 **rcodepp) {
+    t_ora_piecewise *pw = (t_ora_piecewise*) ctx;
+    ora_piece_flush(pw);
+
+    pw->len = ORA_PIECE_SIZE;
+    pw->ind = 0;
+    pw->rcode = 0;
+    pw->pending = 1;
+    *bufpp = pw->buf;
+    *alenpp = &pw->len;
+    *indpp = &pw->ind;
+    *rcodepp = &pw->rcode;
+    return OCI_CONTINUE;
+}
+
+sword ora_stmt_define_piecewise(OCIStmt *stm, OCIDefine **def, ub4 pos, t_ora_piecewise *pw) {
+    pw->pending = 0;
+    sword r = OCIDefineByPos(
+        stm, def, ora_conn()->err, pos, NULL, (sb4) SB4MAXVAL, SQLT_CHR, NULL, NULL, NULL, OCI_DYNAMIC_FETCH);
+    if (ora_check(r) != OCI_SUCCESS)
+        return r;
+    r = OCIDefineDynamic(*def, ora_conn()->err, (dvoid*) pw, ora_piece_cb);
+    return ora_check(r);
+}
+
+sword ora_stmt_fetch_piecewise(OCIStmt *stm, t_ora_piecewise *pw) {
+    pw->total = 0;
+    pw->error = 0;
+    pw->pending = 0;
+    sword r = ora_stmt_fetch(stm);
+    ora_piece_flush(pw); // last piece
+    return r;
+}
+
 sword ora_stmt_free(OCIStmt *stm) {
     sword r = OCIHandleFree(stm, OCI_HTYPE_STMT);
     return ora_check(r);
 }
 
 sword ora_lob_alloc(OCILobLocator **lob) {
-    sword r = OCIDescriptorAlloc(g_connection.env, (void **) lob, OCI_DTYPE_LOB, 0, 0);
+    sword r = OCIDescriptorAlloc(ora_conn()->env, (void **) lob, OCI_DTYPE_LOB, 0, 0);
     return ora_check(r);
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdio.h>
 #include <oci.h>
 
 #define ORA_PREFETCH_MEMORY 1024*1024 // 1 MB
@@ -26,6 +27,18 @@ int ora_connect(char* username, char* password, char* database);
 
 int ora_disconnect();
 
+/**
+ * Start additional database session (using the same parameters as g_connection) and make it
+ * current connection of calling thread - all ora_* functions called from this thread will use it.
+ * This is meant for worker threads, g_connection must only be used by the main thread.
+ * */
+int ora_connect_session(struct s_connection *conn);
+
+/**
+ * End session started by ora_connect_session() and free its handles.
+ * */
+void ora_disconnect_session(struct s_connection *conn);
+
 int ora_is_dba(int *dba);
 
 
@@ -35,6 +48,9 @@ sword ora_lob_free(OCILobLocator *lob);
 
 sword ora_stmt_prepare(OCIStmt **stm, const char *query);
 
+// same as ora_stmt_prepare, but query is len bytes (not null terminated, e.g. mapped file, see tfs_map)
+sword ora_stmt_prepare_len(OCIStmt **stm, const char *query, size_t len);
+
 sword ora_stmt_define(OCIStmt *stm, OCIDefine **def, ub4 pos, void *value, sb4 value_size, ub2 dty);
 
 sword ora_stmt_define_i(OCIStmt *stm, OCIDefine **def, ub4 pos, void *value, sb4 value_size, ub2 dty, dvoid *indp);
@@ -47,6 +63,34 @@ sword ora_stmt_fetch(OCIStmt *stm);
 
 sword ora_stmt_free(OCIStmt *stm);
 
+#define ORA_PIECE_SIZE 64*1024
+
+/**
+ * State of piecewise (OCI_DYNAMIC_FETCH) fetch of LONG column, see ora_stmt_define_piecewise.
+ * */
+typedef struct {
+    FILE  *fp;       // every piece is written here as soon as it's fetched
+    void (*progress)(FILE *fp); // called after every piece written to fp (NULL=none), e.g. stm_progress
+    size_t total;    // bytes written for current row, 0 if value is null
+    int    error;    // errno of failed write to fp (OCI calls which follow may change errno), 0=none
+    char   buf[ORA_PIECE_SIZE];
+    ub4    len;
+    sb2    ind;
+    ub2    rcode;
+    int    pending;  // buf holds a piece which is not written yet
+} t_ora_piecewise;
+
+/**
+ * Define LONG column (or any character column) to be fetched piece by piece straight into pw->fp, so that value
+ * of any size is fetched completely, with ORA_PIECE_SIZE of memory. pw must stay valid until statement is freed.
+ * */
+sword ora_stmt_define_piecewise(OCIStmt *stm, OCIDefine **def, ub4 pos, t_ora_piecewise *pw);
+
+/**
+ * Same as ora_stmt_fetch, for statement with piecewise column (pw->fp must be set before calling this).
+ * */
+sword ora_stmt_fetch_piecewise(OCIStmt *stm, t_ora_piecewise *pw);
+
 
 // query: select open_mode from v$database
 // @return: -1=error (probably due to insuficient privileges), 0=rw, 1=ro
@@ -91,6 +135,24 @@ int ora_get_open_mode();
                                                         goto PROC##_cleanup;\
                                                     }
 
+// DATE column as seconds since 1970-01-01 00:00:00 (wall clock, converted to time_t with utl_epoch2time)
+#define ORA_EPOCH(COL)                              "round((" COL " - date '1970-01-01') * 86400)"
+
+#define ORA_STMT_DEFINE_TIME(PROC, I, NAME)         long long o_##NAME = 0;\
+                                                    if (ora_stmt_define(o_stm, &o_def, I, &o_##NAME, sizeof(long long), SQLT_INT)) {\
+                                                        logmsg(LOG_ERROR, "%s(): Unable to define %s", #PROC, #NAME);\
+                                                        retval = EXIT_FAILURE;\
+                                                        goto PROC##_cleanup;\
+                                                    }
+
+#define ORA_STMT_DEFINE_TIME_I(PROC, I, NAME)       long long o_##NAME = 0;\
+                                                    sb2 i_##NAME = 0;\
+                                                    if (ora_stmt_define_i(o_stm, &o_def, I, &o_##NAME, sizeof(long long), SQLT_INT, (dvoid*) &i_##NAME)) {\
+                                                        logmsg(LOG_ERROR, "%s(): Unable to define %s", #PROC, #NAME);\
+                                                        retval = EXIT_FAILURE;\
+                                                        goto PROC##_cleanup;\
+                                                    }
+
 #define ORA_STMT_BIND_STR(PROC, I, NAME)            OCIBind *o_bn##I = NULL;\
                                                     if (ora_stmt_bind(o_stm, &o_bn##I, I, (void*) NAME, (sb4) (strlen(NAME)+1), SQLT_STR)) {\
                                                         logmsg(LOG_ERROR, "%s(): Unable to bind %d", #PROC, #NAME);\
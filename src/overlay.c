@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+	#include <unistd.h>
+	#include <strings.h>
+	#include <dirent.h>
+	#include <signal.h>
+#else
+	#include <windows.h>
+	#include <io.h>
+	#include <process.h>
+	#include <direct.h>
+	#pragma warning(disable:4996)
+	#define getpid _getpid
+	#define strcasecmp _stricmp
+	#define O_ACCMODE (_O_RDONLY|_O_WRONLY|_O_RDWR)
+	#define O_NOFOLLOW 0
+#endif
+
+#include "config.h"
+#include "logging.h"
+#include "util.h"
+#include "overlay.h"
+
+// overlay file, content is stored in fname (within ovl_dir)
+typedef struct {
+    char *path;  // e.g. /SCHEMA/VIEW/.MY_VIEW.SQL.swp
+    char *fname;
+} t_ovl_file;
+
+static t_ovl_file *ovl_files = NULL;
+static int ovl_count = 0;
+static int ovl_seq = 0;
+static char ovl_dir[2048] = "";
+
+int ovl_is_scratch(const char *path) {
+    int depth = 0;
+    for (const char *c = path; *c != '\0'; c++)
+        if (*c == '/')
+            depth++;
+    if (depth != 3)
+        return 0;
+
+    const char *name = strrchr(path, '/') + 1;
+    if (*name == '\0')
+        return 0;
+
+    const char *suffix = strrchr(name, '.');
+    if (suffix != NULL && (strcasecmp(suffix, ".SQL") == 0 || strcasecmp(suffix, ".JAVA") == 0))
+        return 0;
+    return 1;
+}
+
+static t_ovl_file* ovl_search(const char *path) {
+    for (int i = 0; i < ovl_count; i++)
+        if (strcmp(ovl_files[i].path, path) == 0)
+            return &ovl_files[i];
+    return NULL;
+}
+
+// overlay directory is created when it is needed for the first time (it doesn't need database, unlike cache directory).
+// temppath may be shared with other users, so its name is unique (and it is private) rather than just predictable
+static int ovl_mkdir() {
+    if (ovl_dir[0] != '\0')
+        return 0;
+
+    char dir[2048];
+#ifndef _MSC_VER
+    snprintf(dir, sizeof(dir), "%s%sddlfs-ovl.%d.XXXXXX", g_conf.temppath, PATH_SEP, (int) getpid());
+    if (mkdtemp(dir) == NULL) {
+#else
+    snprintf(dir, sizeof(dir), "%s%sddlfs-ovl.%d", g_conf.temppath, PATH_SEP, (int) getpid());
+    if (CreateDirectory(dir, NULL) == 0 && GetLastError() != ERROR_ALREADY_EXISTS) {
+#endif
+        logmsg(LOG_ERROR, "ovl_mkdir() - unable to create overlay directory [%s]: %d - %s", dir, errno, strerror(errno));
+        return -EIO;
+    }
+    strcpy(ovl_dir, dir);
+    logmsg(LOG_DEBUG, "ovl_mkdir() - created overlay directory [%s]", ovl_dir);
+    return 0;
+}
+
+#ifndef _MSC_VER
+// remove overlay directory dir with files in it (there are no subdirectories)
+static void ovl_rmdir(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d != NULL) {
+        struct dirent *ent;
+        char fname[4096];
+        while ((ent = readdir(d)) != NULL) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+                continue;
+            snprintf(fname, sizeof(fname), "%s/%s", dir, ent->d_name);
+            unlink(fname);
+        }
+        closedir(d);
+    }
+    if (rmdir(dir) != 0)
+        logmsg(LOG_ERROR, "ovl_rmdir() - unable to remove overlay directory [%s]: %d - %s", dir, errno, strerror(errno));
+}
+#endif
+
+void ovl_start() {
+#ifndef _MSC_VER
+    // overlay directories of our processes which are gone (e.g. killed instead of unmounted)
+    DIR *d = opendir(g_conf.temppath);
+    if (d == NULL)
+        return;
+
+    struct dirent *ent;
+    char dir[4096];
+    while ((ent = readdir(d)) != NULL) {
+        int pid;
+        if (strncmp(ent->d_name, "ddlfs-ovl.", 10) != 0 || sscanf(ent->d_name + 10, "%d", &pid) != 1 ||
+            pid == (int) getpid() || kill(pid, 0) == 0 || errno != ESRCH)
+            continue;
+
+        struct stat st;
+        snprintf(dir, sizeof(dir), "%s/%s", g_conf.temppath, ent->d_name);
+        if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid())
+            continue;
+
+        logmsg(LOG_DEBUG, "ovl_start() - removing stale overlay directory [%s]", dir);
+        ovl_rmdir(dir);
+    }
+    closedir(d);
+#endif
+}
+
+int ovl_getattr(const char *path, struct stat *st) {
+    t_ovl_file *f = ovl_search(path);
+    if (f == NULL)
+        return -ENOENT;
+    if (stat(f->fname, st) != 0)
+        return -errno;
+    return 0;
+}
+
+int ovl_create(const char *path, int *fd) {
+    t_ovl_file *f = ovl_search(path);
+    int created = (f == NULL);
+    if (f == NULL) {
+        int r = ovl_mkdir();
+        if (r != 0)
+            return r;
+
+        t_ovl_file *tmp = realloc(ovl_files, (ovl_count+1) * sizeof(t_ovl_file));
+        if (tmp == NULL)
+            return -ENOMEM;
+        ovl_files = tmp;
+
+        char fname[2100];
+        snprintf(fname, sizeof(fname), "%s%s%d", ovl_dir, PATH_SEP, ++ovl_seq);
+        f = &ovl_files[ovl_count];
+        f->path = strdup(path);
+        f->fname = strdup(fname);
+        if (f->path == NULL || f->fname == NULL) {
+            free(f->path);
+            free(f->fname);
+            return -ENOMEM;
+        }
+        ovl_count++;
+        logmsg(LOG_DEBUG, "ovl_create() - [%s] is stored in overlay as [%s]", path, fname);
+    }
+
+    // new file must not exist yet (let alone be a symlink), existing one is only ever a regular file of ours
+    int flags = (created ? O_CREAT | O_EXCL : O_TRUNC) | O_NOFOLLOW;
+#ifndef _MSC_VER
+    *fd = open(f->fname, O_RDWR | flags, 0600);
+#else
+    *fd = open(f->fname, O_RDWR | flags | O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+    if (*fd < 0)
+        return -errno;
+    return 0;
+}
+
+int ovl_open(const char *path, int flags, int *fd) {
+    t_ovl_file *f = ovl_search(path);
+    if (f == NULL)
+        return -ENOENT;
+
+    // O_CREAT and the like don't apply, file exists already, but editors rely on O_TRUNC and O_APPEND
+#ifndef _MSC_VER
+    *fd = open(f->fname, (flags & (O_ACCMODE | O_TRUNC | O_APPEND)) | O_NOFOLLOW);
+#else
+    *fd = open(f->fname, (flags & (O_ACCMODE | O_TRUNC | O_APPEND)) | O_BINARY);
+#endif
+    if (*fd < 0)
+        return -errno;
+    return 0;
+}
+
+int ovl_truncate(const char *path, off_t size) {
+    t_ovl_file *f = ovl_search(path);
+    if (f == NULL)
+        return -ENOENT;
+
+#ifndef _MSC_VER
+    if (truncate(f->fname, size) != 0)
+        return -errno;
+#else
+    int fd = open(f->fname, O_RDWR);
+    if (fd < 0)
+        return -errno;
+    int r = _chsize(fd, (long) size);
+    close(fd);
+    if (r != 0)
+        return -EIO;
+#endif
+    return 0;
+}
+
+int ovl_unlink(const char *path) {
+    t_ovl_file *f = ovl_search(path);
+    if (f == NULL)
+        return -ENOENT;
+
+    if (unlink(f->fname) != 0)
+        logmsg(LOG_ERROR, "ovl_unlink() - unable to remove [%s]: %d - %s", f->fname, errno, strerror(errno));
+    free(f->path);
+    free(f->fname);
+    *f = ovl_files[--ovl_count];
+    return 0;
+}
+
+int ovl_list(const char *dir, char ***names, int *count) {
+    size_t dir_len = strlen(dir);
+    *names = NULL;
+    *count = 0;
+    if (ovl_count == 0)
+        return EXIT_SUCCESS;
+
+    *names = calloc(ovl_count, sizeof(char*));
+    if (*names == NULL)
+        return EXIT_FAILURE;
+
+    for (int i = 0; i < ovl_count; i++) {
+        const char *path = ovl_files[i].path;
+        if (strncmp(path, dir, dir_len) != 0 || path[dir_len] != '/')
+            continue;
+        if (((*names)[*count] = strdup(path + dir_len + 1)) == NULL) {
+            for (int j = 0; j < *count; j++)
+                free((*names)[j]);
+            free(*names);
+            *names = NULL;
+            *count = 0;
+            return EXIT_FAILURE;
+        }
+        (*count)++;
+    }
+    return EXIT_SUCCESS;
+}
+
+void ovl_stop() {
+    for (int i = 0; i < ovl_count; i++) {
+        if (unlink(ovl_files[i].fname) != 0)
+            logmsg(LOG_ERROR, "ovl_stop() - unable to remove [%s]: %d - %s", ovl_files[i].fname, errno, strerror(errno));
+        free(ovl_files[i].path);
+        free(ovl_files[i].fname);
+    }
+    free(ovl_files);
+    ovl_files = NULL;
+    ovl_count = 0;
+
+    if (ovl_dir[0] != '\0' && rmdir(ovl_dir) != 0)
+        logmsg(LOG_ERROR, "ovl_stop() - unable to remove overlay directory [%s]: %d - %s", ovl_dir, errno, strerror(errno));
+    ovl_dir[0] = '\0';
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * Local scratch overlay for files which cannot be database objects.
+ *
+ * Editors and version control tools create swap, backup, lock and probe files next to the edited
+ * file (e.g. .MY_VIEW.SQL.swp, MY_VIEW.SQL~, 4913). Such files (in object directories, with a name
+ * that does not end with .SQL or .JAVA) are stored in a private per-mount directory within temppath
+ * and never reach the database: no DDL is executed and no listing is queried for them.
+ * Overlay is only used by the fuse thread and it is removed on umount (ovl_stop).
+ *
+ * Functions return 0 or -errno, like fuse operations.
+ * */
+
+/**
+ * Remove overlay directories left behind by processes of this user which are gone (e.g. killed). Called at mount.
+ * */
+void ovl_start();
+
+/**
+ * Return 1 if path belongs to overlay (file in object directory without a supported suffix).
+ * */
+int ovl_is_scratch(const char *path);
+
+/**
+ * Stat overlay file, -ENOENT if it does not exist.
+ * */
+int ovl_getattr(const char *path, struct stat *st);
+
+/**
+ * Create (or truncate) overlay file and open it for read/write, file descriptor is returned in fd.
+ * */
+int ovl_create(const char *path, int *fd);
+
+/**
+ * Open existing overlay file with flags (O_ACCMODE part of open flags).
+ * */
+int ovl_open(const char *path, int flags, int *fd);
+
+int ovl_truncate(const char *path, off_t size);
+
+int ovl_unlink(const char *path);
+
+/**
+ * Return names of overlay files in directory dir (e.g. /SCHEMA/VIEW). Names and array must be freed by caller.
+ * */
+int ovl_list(const char *dir, char ***names, int *count);
+
+/**
+ * Remove all overlay files (and overlay directory).
+ * */
+void ovl_stop();
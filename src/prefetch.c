@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _MSC_VER
+	#include <pthread.h>
+#endif
+
+#include "config.h"
+#include "logging.h"
+#include "oracle.h"
+#include "query.h"
+#include "vfs.h"
+#include "objtype.h"
+#include "prefetch.h"
+
+#ifndef _MSC_VER
+
+#define PF_RELATED_MAX 32 // queued objects whose related objects should be prefetched
+#define PF_RELATED_OBJECTS 16  // max. related objects prefetched for a single object
+
+// object (recently opened) whose related objects should be prefetched
+typedef struct {
+    char *schema;
+    char *type;
+    char *object;
+} t_pf_related;
+
+// queue of objects to prefetch, all of them are from the same directory (schema & type)
+// plus queue of objects whose related objects should be prefetched (served first)
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t      *threads;
+    int             thread_count;
+    int             running;
+    int             interactive; // number of interactive requests in progress
+    char           *schema;
+    char           *type;
+    char          **objects;
+    int             count;
+    int             next;        // first object not yet taken by any worker
+    t_pf_related    related[PF_RELATED_MAX];
+    int             related_count;
+} pf = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static void pf_related_free(t_pf_related *r) {
+    free(r->schema);
+    free(r->type);
+    free(r->object);
+    r->schema = NULL;
+    r->type = NULL;
+    r->object = NULL;
+}
+
+// prefetch objects related to specified object (with worker's own database session)
+static void pf_prefetch_related(int id, const t_pf_related *job) {
+    t_related related[PF_RELATED_OBJECTS];
+    int count = 0;
+
+    if (qry_related(job->schema, job->type, job->object, related, PF_RELATED_OBJECTS, &count) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "pf_worker(%d) - unable to query objects related to [%s].[%s].[%s]", id, job->schema, job->type, job->object);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        logmsg(LOG_DEBUG, "pf_worker(%d) - prefetch [%s].[%s].[%s] (related to [%s])", id, job->schema, related[i].type, related[i].fname, job->object);
+        if (qry_object_prefetch(job->schema, related[i].type, related[i].fname, related[i].last_ddl_time) != EXIT_SUCCESS)
+            logmsg(LOG_ERROR, "pf_worker(%d) - unable to prefetch [%s].[%s].[%s]", id, job->schema, related[i].type, related[i].fname);
+    }
+}
+
+// drop queued objects, pf.mutex must be held by caller
+static void pf_clear() {
+    for (int i = 0; i < pf.count; i++)
+        free(pf.objects[i]);
+    free(pf.objects);
+    free(pf.schema);
+    free(pf.type);
+    pf.objects = NULL;
+    pf.schema = NULL;
+    pf.type = NULL;
+    pf.count = 0;
+    pf.next = 0;
+}
+
+static void* pf_worker(void *arg) {
+    int id = (int) (intptr_t) arg;
+    struct s_connection conn;
+    int connected = 0;
+    char *schema = NULL, *type = NULL, *object = NULL;
+
+    memset(&conn, 0, sizeof(struct s_connection));
+    logmsg(LOG_DEBUG, "pf_worker(%d) - started.", id);
+
+    pthread_mutex_lock(&pf.mutex);
+    while (pf.running) {
+        if ((pf.next >= pf.count && pf.related_count == 0) || pf.interactive > 0) {
+            pthread_cond_wait(&pf.cond, &pf.mutex);
+            continue;
+        }
+
+        t_pf_related job = { NULL, NULL, NULL };
+        if (pf.related_count > 0) {
+            // related objects are served first, they're most likely to be opened next
+            job = pf.related[0];
+            memmove(&pf.related[0], &pf.related[1], (--pf.related_count) * sizeof(t_pf_related));
+        } else {
+            schema = strdup(pf.schema);
+            type = strdup(pf.type);
+            object = strdup(pf.objects[pf.next++]);
+        }
+        pthread_mutex_unlock(&pf.mutex);
+
+        // database session is only opened once there's something to do
+        if (connected == 0) {
+            if (ora_connect_session(&conn) != EXIT_SUCCESS) {
+                logmsg(LOG_ERROR, "pf_worker(%d) - unable to connect, prefetch worker stopped.", id);
+                pf_related_free(&job);
+                free(schema);
+                free(type);
+                free(object);
+                return NULL;
+            }
+            connected = 1;
+        }
+
+        if (job.schema != NULL) {
+            pf_prefetch_related(id, &job);
+            pf_related_free(&job);
+            pthread_mutex_lock(&pf.mutex);
+            continue;
+        }
+
+        if (schema == NULL || type == NULL || object == NULL) {
+            logmsg(LOG_ERROR, "pf_worker(%d) - unable to allocate memory for job.", id);
+        } else {
+            logmsg(LOG_DEBUG, "pf_worker(%d) - prefetch [%s].[%s].[%s]", id, schema, type, object);
+            if (qry_object_prefetch(schema, type, object, 0) != EXIT_SUCCESS)
+                logmsg(LOG_ERROR, "pf_worker(%d) - unable to prefetch [%s].[%s].[%s]", id, schema, type, object);
+        }
+
+        free(schema);
+        free(type);
+        free(object);
+        schema = NULL;
+        type = NULL;
+        object = NULL;
+        pthread_mutex_lock(&pf.mutex);
+    }
+    pthread_mutex_unlock(&pf.mutex);
+
+    if (connected == 1)
+        ora_disconnect_session(&conn);
+
+    logmsg(LOG_DEBUG, "pf_worker(%d) - stopped.", id);
+    return NULL;
+}
+
+int pf_start() {
+    if (g_conf.prefetch <= 0)
+        return EXIT_SUCCESS;
+
+    pf.threads = calloc(g_conf.prefetch, sizeof(pthread_t));
+    if (pf.threads == NULL) {
+        logmsg(LOG_ERROR, "pf_start() - unable to allocate memory for %d threads.", g_conf.prefetch);
+        return EXIT_FAILURE;
+    }
+
+    pf.running = 1;
+    for (int i = 0; i < g_conf.prefetch; i++) {
+        if (pthread_create(&pf.threads[i], NULL, pf_worker, (void*) (intptr_t) i) != 0) {
+            logmsg(LOG_ERROR, "pf_start() - unable to start prefetch worker %d.", i);
+            break;
+        }
+        pf.thread_count++;
+    }
+
+    logmsg(LOG_INFO, "Started %d prefetch worker(s).", pf.thread_count);
+    return EXIT_SUCCESS;
+}
+
+void pf_stop() {
+    if (pf.threads == NULL)
+        return;
+
+    pthread_mutex_lock(&pf.mutex);
+    pf.running = 0;
+    pf_clear();
+    for (int i = 0; i < pf.related_count; i++)
+        pf_related_free(&pf.related[i]);
+    pf.related_count = 0;
+    pthread_cond_broadcast(&pf.cond);
+    pthread_mutex_unlock(&pf.mutex);
+
+    for (int i = 0; i < pf.thread_count; i++)
+        pthread_join(pf.threads[i], NULL);
+
+    free(pf.threads);
+    pf.threads = NULL;
+    pf.thread_count = 0;
+}
+
+void pf_enqueue_dir(const char *schema, const char *type, t_fsentry *dir) {
+    if (pf.thread_count == 0 || dir == NULL)
+        return;
+
+    pthread_mutex_lock(&pf.mutex);
+
+    // this directory is still being prefetched
+    if (pf.next < pf.count && strcmp(pf.schema, schema) == 0 && strcmp(pf.type, type) == 0) {
+        pthread_mutex_unlock(&pf.mutex);
+        return;
+    }
+
+    // cancel prefetch of previous directory (jobs already taken by workers will complete)
+    pf_clear();
+
+    pf.schema = strdup(schema);
+    pf.type = strdup(type);
+    pf.objects = calloc(dir->count > 0 ? dir->count : 1, sizeof(char*));
+    if (pf.schema == NULL || pf.type == NULL || pf.objects == NULL) {
+        logmsg(LOG_ERROR, "pf_enqueue_dir() - unable to allocate memory for [%s].[%s]", schema, type);
+        pf_clear();
+        pthread_mutex_unlock(&pf.mutex);
+        return;
+    }
+
+    // children are sorted by name
+    for (int i = 0; i < dir->count; i++) {
+        if (dir->children[i]->ftype == 'D')
+            continue;
+        pf.objects[pf.count] = strdup(dir->children[i]->fname);
+        if (pf.objects[pf.count] == NULL) {
+            logmsg(LOG_ERROR, "pf_enqueue_dir() - unable to allocate memory for [%s]", dir->children[i]->fname);
+            break;
+        }
+        pf.count++;
+    }
+    logmsg(LOG_DEBUG, "pf_enqueue_dir() - queued %d objects from [%s].[%s]", pf.count, schema, type);
+
+    pthread_cond_broadcast(&pf.cond);
+    pthread_mutex_unlock(&pf.mutex);
+}
+
+void pf_enqueue_related(const char *schema, const char *type, const char *object) {
+    if (pf.thread_count == 0)
+        return;
+
+    // see qry_related()
+    const t_objtype *ot = ot_by_fs(type);
+    if (ot == NULL || ot->related == OT_RELATED_NONE)
+        return;
+
+    pthread_mutex_lock(&pf.mutex);
+
+    for (int i = 0; i < pf.related_count; i++) {
+        if (strcmp(pf.related[i].schema, schema) == 0 && strcmp(pf.related[i].type, type) == 0 && strcmp(pf.related[i].object, object) == 0) {
+            pthread_mutex_unlock(&pf.mutex);
+            return; // already queued
+        }
+    }
+
+    // queue is full, forget the oldest one
+    if (pf.related_count == PF_RELATED_MAX) {
+        pf_related_free(&pf.related[0]);
+        memmove(&pf.related[0], &pf.related[1], (--pf.related_count) * sizeof(t_pf_related));
+    }
+
+    t_pf_related *r = &pf.related[pf.related_count];
+    r->schema = strdup(schema);
+    r->type = strdup(type);
+    r->object = strdup(object);
+    if (r->schema == NULL || r->type == NULL || r->object == NULL) {
+        logmsg(LOG_ERROR, "pf_enqueue_related() - unable to allocate memory for [%s].[%s].[%s]", schema, type, object);
+        pf_related_free(r);
+    } else {
+        pf.related_count++;
+        pthread_cond_broadcast(&pf.cond);
+    }
+
+    pthread_mutex_unlock(&pf.mutex);
+}
+
+void pf_interactive_begin() {
+    if (pf.thread_count == 0)
+        return;
+
+    pthread_mutex_lock(&pf.mutex);
+    pf.interactive++;
+    pthread_mutex_unlock(&pf.mutex);
+}
+
+void pf_interactive_end() {
+    if (pf.thread_count == 0)
+        return;
+
+    pthread_mutex_lock(&pf.mutex);
+    if (--pf.interactive == 0)
+        pthread_cond_broadcast(&pf.cond);
+    pthread_mutex_unlock(&pf.mutex);
+}
+
+#else
+
+int pf_start() {
+    return EXIT_SUCCESS;
+}
+
+void pf_stop() {
+}
+
+void pf_enqueue_dir(const char *schema, const char *type, t_fsentry *dir) {
+}
+
+void pf_enqueue_related(const char *schema, const char *type, const char *object) {
+}
+
+void pf_interactive_begin() {
+}
+
+void pf_interactive_end() {
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vfs.h"
+
+/**
+ * Background prefetch of objects into local cache (see prefetch= parameter).
+ *
+ * When a directory with objects is listed (readdir), its objects are fetched into local
+ * cache, in name order, by a small pool of worker threads. Each worker has its own
+ * database session. Objects related to opened objects (see pf_enqueue_related) are
+ * prefetched the same way. Listing another directory cancels whatever was still queued and
+ * workers pause while an interactive request (open, release, ..) is being served.
+ *
+ * Not available on Windows, where all these functions do nothing.
+ * */
+
+/**
+ * Start worker threads. Must be called after fuse has daemonized the process (fuse init).
+ * */
+int pf_start();
+
+/**
+ * Cancel queued jobs, stop worker threads and close their database sessions.
+ * */
+void pf_stop();
+
+/**
+ * Queue all objects in dir (children of /schema/type directory) for prefetch. This replaces
+ * previously queued objects, unless they're from the same directory.
+ * */
+void pf_enqueue_dir(const char *schema, const char *type, t_fsentry *dir);
+
+/**
+ * Queue prefetch of objects related to specified object (which was just opened), e.g. package
+ * body for package spec or triggers for a table, see qry_related(). These are served before
+ * objects queued by pf_enqueue_dir().
+ * */
+void pf_enqueue_related(const char *schema, const char *type, const char *object);
+
+/**
+ * Interactive request (from fuse thread) started, workers won't start new jobs until
+ * pf_interactive_end() is called.
+ * */
+void pf_interactive_begin();
+
+/**
+ * Interactive request (from fuse thread) completed.
+ * */
+void pf_interactive_end();
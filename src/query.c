@@ -22,13 +22,18 @@
 #include "oracle.h"
 #include "tempfs.h"
 #include "util.h"
+#include "normalize.h"
+#include "stream.h"
 #include "query_tables.h"
+#include "query.h"
+#include "objtype.h"
+#include "compile.h"
 
-#define DDLFS_PATH_MAX 8192
 #define LOB_BUFFER_SIZE 8192
+#define QRY_SOURCE_LINE_MAX 32*1024 // all_source.text is varchar2(4000), converted to client character set
 
 
-static int str_append(char **dst, char *src) {
+static int str_append(char **dst, const char *src) {
     size_t len = (*dst == NULL ? strlen(src) : strlen(*dst) + strlen(src));
     char *tmp = malloc(len+2);
     if (tmp == NULL) {
@@ -47,34 +52,30 @@ static int str_append(char **dst, char *src) {
 }
 
 int str_suffix(char **dst, const char *objectType) {
-    char *suffix = calloc(10, sizeof(char));
-    char *type = strdup(objectType);
-    if (suffix == NULL || type == NULL) {
-        logmsg(LOG_ERROR, "str_suffix() - unable to malloc suffix and/or type.");
-        if (suffix != NULL)
-            free(suffix);
-        if (type != NULL)
-            free(type);
+    const t_objtype *ot = ot_by_fs(objectType);
+    *dst = strdup(ot == NULL ? ".SQL" : ot->suffix);
+    if (*dst == NULL) {
+        logmsg(LOG_ERROR, "str_suffix() - unable to malloc suffix.");
         return EXIT_FAILURE;
     }
-
-    if (strcmp(type, "JAVA_SOURCE") == 0)
-        strcpy(suffix, ".JAVA");
-    else if (strcmp(type, "JAVA_CLASS") == 0)
-        strcpy(suffix, ".CLASS");
-    else if (strcmp(type, "JAVA_RESOURCE") == 0)
-        strcpy(suffix, ".RES"); // might be anything really, like .properties, .xml, .ini, ...
-    else
-        strcpy(suffix, ".SQL");
-    free(type);
-    // logmsg(LOG_DEBUG, "str_suffix() - returning suffix [%s] for type [%s]", suffix, type);
-
-    *dst = suffix;
-
     return EXIT_SUCCESS;
 }
 
 // @todo: this function should probably go to tempfs.c
+int qry_object_fname_buf(const char *schema,
+                         const char *type,
+                         const char *object,
+                         char *buf,
+                         size_t size) {
+    int len = snprintf(buf, size, "%s%sddlfs-%s.%s.%s.tmp",
+        g_conf._temppath, PATH_SEP, schema, type, object);
+    if (len < 0 || (size_t) len >= size) {
+        logmsg(LOG_ERROR, "qry_object_fname_buf() - cache filename for [%s].[%s] is too long", schema, object);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int qry_object_fname(const char *schema,
                      const char *type,
                      const char *object,
@@ -84,12 +85,10 @@ int qry_object_fname(const char *schema,
         logmsg(LOG_ERROR, "Unable to malloc fname (size=%d)", DDLFS_PATH_MAX);
         return EXIT_FAILURE;
     }
-    snprintf(*fname, DDLFS_PATH_MAX, "%s%sddlfs-%s.%s.%s.tmp",
-        g_conf._temppath, PATH_SEP, schema, type, object);
-    return EXIT_SUCCESS;
+    return qry_object_fname_buf(schema, type, object, *fname, DDLFS_PATH_MAX);
 }
 
-int str_fn2obj(char **dst, char *src, const char *objectType) {
+int str_fn2obj(char **dst, const char *src, const char *objectType) {
     *dst = strdup(src);
     if (*dst == NULL) {
         logmsg(LOG_ERROR, "str_fn2obj() - Unable to malloc for dst string.");
@@ -145,37 +144,156 @@ int str_fn2obj(char **dst, char *src, const char *objectType) {
     return 0;
 }
 
-static int qry_object_all_source(const char *schema,
-                                       char *type,
-                                 const char *object,
-                                 const char *fname,
-                                 const  int is_java_source,
-                                 const  int is_trigger_source) {
+// all_objects.editionable column was introduced in 12.1
+static const char* qry_editionable() {
+    return (g_conf._server_version <= 1102 ? "null as e" : "o.\"EDITIONABLE\" as e");
+}
+
+// write text of view (all_views.text) or materialized view (all_mviews.query) to pw->fp, both are LONG
+static int qry_view_text(const char *schema, const char *object, int is_mview, t_ora_piecewise *pw) {
+    int retval = EXIT_SUCCESS;
+    char query[256] = "";
+
+    if (is_mview)
+        strcpy(query, "select w.query from all_mviews w where w.mview_name=:bind_object and w.owner=:bind_schema");
+    else
+        strcpy(query, "select w.text from all_views w where w.view_name=:bind_object and w.owner=:bind_schema");
+    ora_replace_all_dba(query);
+
+    ORA_STMT_PREPARE(qry_view_text);
+    if (ora_stmt_define_piecewise(o_stm, &o_def, 1, pw)) {
+        logmsg(LOG_ERROR, "qry_view_text(): Unable to define text");
+        retval = EXIT_FAILURE;
+        goto qry_view_text_cleanup;
+    }
+    ORA_STMT_BIND_STR(qry_view_text, 1, object);
+    ORA_STMT_BIND_STR(qry_view_text, 2, schema);
+    ORA_STMT_EXECUTE(qry_view_text, 0);
 
-    int is_view_source = ((strcmp(type, "VIEW") == 0) ? 1 : 0);
-    int is_mview_source = ((strcmp(type, "MATERIALIZED VIEW") == 0) ? 1 : 0);
+    if (ora_stmt_fetch_piecewise(o_stm, pw) != OCI_SUCCESS) {
+        logmsg(LOG_ERROR, "qry_view_text(): Unable to fetch text of [%s].[%s]", schema, object);
+        retval = EXIT_FAILURE;
+    } else if (pw->error) {
+        logmsg(LOG_ERROR, "qry_view_text(): Unable to write text of [%s].[%s]: %d - %s", schema, object, pw->error, strerror(pw->error));
+        retval = EXIT_FAILURE;
+    }
+
+qry_view_text_cleanup:
+    ORA_STMT_FREE;
+    return retval;
+}
+
+// view and materialized view source, text is fetched piece by piece straight into fname (see qry_view_text)
+static int qry_object_view_source(const char *schema,
+                                  const char *type,
+                                  const char *object,
+                                  const char *fname,
+                                         int is_mview,
+                                         int *o_validity) {
     int retval = EXIT_SUCCESS;
-    char query_fmt[1024] = "";
     char query[1024] = "";
+    char tmpstr[4096];
+    char editionable[30] = "";
+    FILE *fp = NULL;
+    t_ora_piecewise *pw = NULL;
 
-    if (is_view_source)
-        strcpy(query_fmt, // ALL_VIEWS
-"select w.text as s,\
- o.status,\
- %s\
- from all_views w\
- join all_objects o on o.owner=w.owner and o.object_name=w.view_name and o.object_type=:bind_type\
- where w.view_name=:bind_object and w.owner=:bind_schema");
-    else if (is_mview_source)
+    *o_validity = -1;
+    if (is_mview)
         strcpy(query, // ALL_MVIEWS, always non-editionable
-"select w.query as s,\
- o.status,\
+"select o.status,\
  null as e\
  from all_mviews w\
  join all_objects o on o.owner=w.owner and o.object_name=w.mview_name and o.object_type=:bind_type\
  where w.mview_name=:bind_object and w.owner=:bind_schema");
     else
-        strcpy(query_fmt, // ALL_OBJECTS
+        snprintf(query, 1024, // ALL_VIEWS
+"select o.status,\
+ %s\
+ from all_views w\
+ join all_objects o on o.owner=w.owner and o.object_name=w.view_name and o.object_type=:bind_type\
+ where w.view_name=:bind_object and w.owner=:bind_schema", qry_editionable());
+    ora_replace_all_dba(query);
+
+    ORA_STMT_PREPARE(qry_object_view_source);
+    ORA_STMT_DEFINE_STR_I(qry_object_view_source, 1, valid,       10);
+    ORA_STMT_DEFINE_STR_I(qry_object_view_source, 2, editionable, 2);
+    ORA_STMT_BIND_STR(qry_object_view_source, 1, type);
+    ORA_STMT_BIND_STR(qry_object_view_source, 2, object);
+    ORA_STMT_BIND_STR(qry_object_view_source, 3, schema);
+    ORA_STMT_EXECUTE(qry_object_view_source, 0);
+
+    fp = fopen(fname, "w");
+    if (fp == NULL) {
+        logmsg(LOG_ERROR, "Unable to open %s. Error=%d (%s).", fname, errno, strerror(errno));
+        retval = EXIT_FAILURE;
+        goto qry_object_view_source_cleanup;
+    }
+
+    if (!(ORA_STMT_FETCH)) {
+        // see qry_object_all_source()
+        logmsg(LOG_ERROR, "There is no source in all_source for [%s] [%s].[%s]", type, schema, object);
+        char empty_msg[] = "-- source for this object not found in all_source view.\n";
+        fwrite(empty_msg, 1, strlen(empty_msg), fp);
+        goto qry_object_view_source_cleanup;
+    }
+
+    *o_validity = (strcmp(ORA_NVL(valid, "INVALID"), "VALID") == 0 ? 0 : 1);
+
+    if (strcmp(ORA_NVL(editionable, "X"), "Y") == 0)
+        strcpy(editionable, " EDITIONABLE");
+    else if (strcmp(ORA_NVL(editionable, "X"), "N") == 0)
+        strcpy(editionable, " NONEDITIONABLE");
+
+    if (is_mview)
+        snprintf(tmpstr, sizeof(tmpstr), "CREATE %s \"%s\".\"%s\" AS \n", type, schema, object);
+    else
+        snprintf(tmpstr, sizeof(tmpstr), "CREATE OR REPLACE FORCE%s %s \"%s\".\"%s\" AS \n", editionable, type, schema, object);
+    fwrite(tmpstr, 1, strlen(tmpstr), fp);
+
+    // Windows won't allow to allocate large arrays on stack
+    if ((pw = malloc(sizeof(t_ora_piecewise))) == NULL) {
+        logmsg(LOG_ERROR, "qry_object_view_source(): Unable to allocate memory for text.");
+        retval = EXIT_FAILURE;
+        goto qry_object_view_source_cleanup;
+    }
+    pw->fp = fp;
+    pw->progress = stm_progress; // readers of streamed view follow the text as it's fetched
+    if (qry_view_text(schema, object, is_mview, pw) != EXIT_SUCCESS) {
+        retval = EXIT_FAILURE;
+    } else if (pw->total == 0) {
+        // TEXT (datatype=LONG): View text. This column returns the correct value only when the row originates
+        // from the current container. The BEQUEATH clause will not appear as part of the TEXT column in
+        // this view.
+        strcpy(tmpstr, "   -- this view source is stored in another container /\n   select * from dual"); // @todo, comment in comment
+        fwrite(tmpstr, 1, strlen(tmpstr), fp);
+    }
+
+qry_object_view_source_cleanup:
+    ORA_STMT_FREE;
+    free(pw);
+    if ( (fp != NULL) && (fclose(fp) != 0) ) {
+        logmsg(LOG_ERROR, "qry_object_view_source() - Unable to close FILE*");
+        retval = EXIT_FAILURE;
+    }
+    return retval;
+}
+
+static int qry_object_all_source(const char *schema,
+                                       char *type,
+                                 const char *object,
+                                 const char *fname,
+                                 t_ot_fetch fetch,
+                                        int *o_validity) {
+
+    int is_java_source = (fetch == OT_FETCH_JAVA ? 1 : 0);
+    int is_trigger_source = (fetch == OT_FETCH_TRIGGER ? 1 : 0);
+    int retval = EXIT_SUCCESS;
+    char query[1024] = "";
+
+    if (fetch == OT_FETCH_VIEW || fetch == OT_FETCH_MVIEW)
+        return qry_object_view_source(schema, type, object, fname, (fetch == OT_FETCH_MVIEW), o_validity);
+
+    snprintf(query, 1024, // ALL_OBJECTS
 "select nvl(s.\"TEXT\", '\n') as s,\
  o.status,\
  %s\
@@ -183,15 +301,7 @@ static int qry_object_all_source(const char *schema,
  join all_objects o on o.\"OWNER\"=s.\"OWNER\" and o.object_name=s.\"NAME\" and o.object_type=s.\"TYPE\"\
  and (o.object_type != 'TYPE' or o.subobject_name IS NULL)\
  where s.\"TYPE\"=:bind_type and s.\"NAME\"=:bind_object and s.\"OWNER\"=:bind_schema\
- order by s.\"LINE\"");
-
-    if (!is_mview_source) {
-        // all_objects.editionable column was introduced in 12.1
-        if (g_conf._server_version <= 1102)
-            snprintf(query, 1024, query_fmt, "null as e");
-        else
-            snprintf(query, 1024, query_fmt, "o.\"EDITIONABLE\" as e");
-    }
+ order by s.\"LINE\"", qry_editionable());
 
     ora_replace_all_dba(query);
 
@@ -200,16 +310,16 @@ static int qry_object_all_source(const char *schema,
     ORA_STMT_PREPARE (qry_object_all_source);
 
     //---
-    // Windows won't allow to allocate large arrays on stack (yes, it seems it considers 4mb large)
-    // ORA_STMT_DEFINE_STR_I(qry_object_all_source, 1, text,        4*1024*1024);
-    char *o_text = calloc(4*1024*1024, sizeof(char));
+    // Windows won't allow to allocate large arrays on stack
+    // ORA_STMT_DEFINE_STR_I(qry_object_all_source, 1, text,        QRY_SOURCE_LINE_MAX);
+    char *o_text = calloc(QRY_SOURCE_LINE_MAX, sizeof(char));
     if (o_text == NULL) {
-        logmsg(LOG_ERROR, "qry_object_all_source(): Unable to allocate 4mb memory for o_text.");
+        logmsg(LOG_ERROR, "qry_object_all_source(): Unable to allocate memory for o_text.");
         retval = EXIT_FAILURE;
         goto qry_object_all_source_cleanup;
     }
     sb2 i_text = 0;
-    if (ora_stmt_define_i(o_stm, &o_def, 1, o_text, (4*1024*1024)*sizeof(char), SQLT_STR, (dvoid*) &i_text)) {
+    if (ora_stmt_define_i(o_stm, &o_def, 1, o_text, QRY_SOURCE_LINE_MAX*sizeof(char), SQLT_STR, (dvoid*) &i_text)) {
         logmsg(LOG_ERROR, "%s(): Unable to define %s", "qry_object_all_source", "text");
         retval = EXIT_FAILURE;
         goto qry_object_all_source_cleanup;
@@ -228,7 +338,6 @@ static int qry_object_all_source(const char *schema,
     int first = 1;
     int type_spaces = 0;
     char *tmp = type;
-    char *org = NULL;
     char editionable[30] = "";
     int row_count = 0;
     int validity = -1; // -1=unknown, 0=>valid, 1=>invalid;
@@ -239,6 +348,8 @@ static int qry_object_all_source(const char *schema,
 
     while (ORA_STMT_FETCH) {
         row_count++;
+        if (i_text < 0) // TEXT is null
+            o_text[0] = '\0';
 
         if (first) {
 
@@ -261,30 +372,13 @@ static int qry_object_all_source(const char *schema,
                 goto qry_object_all_source_cleanup;
             }
 
-            if (!is_java_source && !is_trigger_source && !is_view_source && !is_mview_source) {
+            if (!is_java_source && !is_trigger_source) {
                 sprintf(tmpstr, "CREATE OR REPLACE%s %s \"%s\".", editionable, type, schema);
                 fwrite(tmpstr, 1, strlen(tmpstr), fp);
             }
 
         }
 
-        if (first && (is_view_source || is_mview_source)) {
-            if (is_view_source)
-                sprintf(tmpstr, "CREATE OR REPLACE FORCE%s %s \"%s\".\"%s\" AS \n", editionable, type, schema, object);
-            else
-                sprintf(tmpstr, "CREATE %s \"%s\".\"%s\" AS \n", type, schema, object);
-            fwrite(tmpstr, 1, strlen(tmpstr), fp);
-
-            if (i_text < 0) { // TEXT is null
-                // TEXT (datatype=LONG): View text. This column returns the correct value only when the row originates
-                // from the current container. The BEQUEATH clause will not appear as part of the TEXT column in
-                // this view.
-                strcpy(tmpstr, "   -- this view source is stored in another container /\n   select * from dual"); // @todo, comment in comment
-                fwrite(tmpstr, 1, strlen(tmpstr), fp);
-                break;
-            }
-        }
-
         if (first && is_trigger_source) {
             sprintf(tmpstr, "CREATE OR REPLACE%s %s \"%s\".\"%s\" ", editionable, type, schema, object);
             fwrite(tmpstr, 1, strlen(tmpstr), fp);
@@ -292,47 +386,16 @@ static int qry_object_all_source(const char *schema,
             // replace everything before 'BEFORE', 'AFTER', 'INSTEAD' with:
             // 'create or replace <editionable> trigger "<owner>"."<trigger-name>" '
             // DEBUG: trigger bucket_racuni_instead instead of update or delete or insert on bucket_racuni
-            char *kw_all[3] = {"BEFORE", "AFTER", "INSTEAD"};
-            char *kw_which = NULL; // which keyword out of kw_all was found, one of the 3 strings in kw_all
-            char *kw_found = NULL; // return value form strcasestr, where did we found the kw_which
-            char *kw_after = NULL; // char after keyword (it must be whitespace char, otherwise we found something that is not really a keyword)
-            char *kw_before = NULL;
+            const char *kw_all[3] = {"BEFORE", "AFTER", "INSTEAD"};
+            char *kw_found = NULL; // where (in o_text) was the first of kw_all found as a whole word
+            size_t kw_len = 0;
             int line = 1;
             while (kw_found == NULL) {
-
-                for (int i = 0; i < 3; i++) {
-
-                    char *kw_haystack = ORA_NVL(text, " ");
-					char *kw_haystack_u = strdup(kw_haystack);
-					if (kw_haystack_u == NULL) {
-						logmsg(LOG_ERROR, "qry_object_all_source(): Unable to copy kw_haystack");
-						goto qry_object_all_source_cleanup;
-					}
-					for (size_t j = 0; j < strlen(kw_haystack_u); j++)
-						kw_haystack_u[j] = (char) toupper(kw_haystack_u[j]);
-
-                    trigger_retry_keyword:
-                    // kw_found = strcasestr(kw_haystack, kw_all[i]); // strcasestr is not available on Windows
-					kw_found = strstr(kw_haystack_u, kw_all[i]);
-                    if (kw_found != NULL) {
-                        kw_which = kw_all[i];
-                        kw_after = kw_found + strlen(kw_which);
-                        kw_before = (kw_found == kw_haystack_u ? NULL : kw_found - 1);
-
-                        if ((kw_after[0] != ' ' && kw_after[0] != '\n' && kw_after[0] != '\r' && kw_after[0] != '\t') ||
-                            (kw_before != NULL && kw_before[0] != ' ' && kw_before[0] != '\n' && kw_before[0] != '\r' && kw_before[0] != '\t')) {
-                            // so, this is not really a keyword
-                            kw_haystack_u += strlen(kw_which);
-                            kw_which = NULL;
-                            kw_after = NULL;
-                            kw_before = NULL;
-                            kw_found = NULL;
-                            goto trigger_retry_keyword;
-                        }
-                    }
-                    if (kw_found != NULL)
-                        break;
-                }
+                // line with keyword is written in uppercase (as it always was), so it is folded in place
+                kw_len = (i_text < 0 ? 0 : strlen(o_text));
+                nrm_upper(o_text, kw_len);
+                for (int i = 0; i < 3 && kw_found == NULL; i++)
+                    kw_found = nrm_find_word(o_text, kw_len, kw_all[i]);
 
                 if (kw_found == NULL) {
                     // none of 3 keywords was found on this line, fetch next line
@@ -345,33 +408,18 @@ static int qry_object_all_source(const char *schema,
                     goto qry_object_all_source_cleanup;
                 }
             }
-            if (kw_found == NULL) {
-                logmsg(LOG_ERROR, "qry_object_all_source: Unable to find keyword for trigger [%s][%s]", schema, object);
-                if (o_text != NULL) // very unlikely case, let's do our best here (even though probably a bit off):
-                    fwrite(o_text, 1, strlen(o_text), fp);
-            } else {
-                fwrite(kw_found, 1, strlen(kw_found), fp);
-            }
+            fwrite(kw_found, 1, kw_len - (size_t) (kw_found - o_text), fp);
 
             first=0;
             continue;
         }
 
-        if (first && !is_view_source && !is_java_source && !is_trigger_source && !is_mview_source) {
+        if (first && !is_java_source && !is_trigger_source) {
             // replace multiple spaces with single space
-            org = ORA_NVL(text, " ");
-            tmp = ORA_NVL(text, " ");
-            while (*tmp != '\0') {
-                while (*tmp == ' ' && *(tmp + 1) == ' ')
-                    tmp++;
-
-                *(org++) = *(tmp++);
-            }
-            *org = '\0';
+            size_t text_len = nrm_squeeze(o_text, strlen(o_text));
 
             // skip first word(s)
-            org = ORA_NVL(text, " ");
-            tmp = ORA_NVL(text, " ");
+            tmp = o_text;
             for (int i = 0; i < type_spaces+1; i++) {
                 while (*tmp != '\0' && *tmp != ' ')
                     tmp++;
@@ -379,31 +427,28 @@ static int qry_object_all_source(const char *schema,
                     tmp++;
             }
 
-            bytes_written = fwrite(tmp, 1, strlen(tmp), fp);
-            if (bytes_written != strlen(tmp)) {
+            size_t tmp_len = text_len - (size_t) (tmp - o_text);
+            bytes_written = fwrite(tmp, 1, tmp_len, fp);
+            if (bytes_written != tmp_len) {
                 retval = EXIT_FAILURE;
-                logmsg(LOG_ERROR, "qry_object_all_source() - Bytes written (%d) != Bytes read (%d)", bytes_written, strlen(tmp));
+                logmsg(LOG_ERROR, "qry_object_all_source() - Bytes written (%d) != Bytes read (%d)", bytes_written, tmp_len);
                 goto qry_object_all_source_cleanup;
             }
         } else {
-            bytes_written = fwrite(ORA_NVL(text, ""), 1, strlen(ORA_NVL(text, "")), fp);
-            if (bytes_written != strlen(ORA_NVL(text, ""))) {
+            size_t text_len = strlen(o_text);
+            bytes_written = fwrite(o_text, 1, text_len, fp);
+            if (bytes_written != text_len) {
                 retval = EXIT_FAILURE;
-                logmsg(LOG_ERROR, "qry_object_all_source() - Bytes written (%d) != Bytes read (%d)", bytes_written, strlen(ORA_NVL(text, "")));
+                logmsg(LOG_ERROR, "qry_object_all_source() - Bytes written (%d) != Bytes read (%d)", bytes_written, text_len);
                 goto qry_object_all_source_cleanup;
             }
 
-            if (is_java_source) {
-                // not every line of java source has nl character at the end.
-                // it seems that only empty lines include newline character.
-                char *java_line = ORA_NVL(text, "");
-                char java_last = 'x';
-                if (strlen(java_line) > 0)
-                    java_last = java_line[strlen(java_line)-1];
-                if (java_last != 10)
-                  fwrite("\n", 1, 1, fp);
-            }
+            // not every line of java source has nl character at the end.
+            // it seems that only empty lines include newline character.
+            if (is_java_source && (text_len == 0 || o_text[text_len-1] != '\n'))
+                fwrite("\n", 1, 1, fp);
         }
+        stm_progress(fp);
 
         first=0;
     }
@@ -430,10 +475,7 @@ static int qry_object_all_source(const char *schema,
         fwrite(empty_msg, 1, strlen(empty_msg), fp);
     }
 
-#ifndef _MSC_VER
-	// this makes no sense on Windows anyway
-    chmod(fname, validity == 0 ? 0744 : 0644);
-#endif
+    *o_validity = validity;
 
 qry_object_all_source_cleanup:
     ORA_STMT_FREE;
@@ -441,8 +483,10 @@ qry_object_all_source_cleanup:
     if (o_text != NULL)
         free(o_text);
     
-    if ( (fp != NULL) && (fclose(fp) != 0) )
+    if ( (fp != NULL) && (fclose(fp) != 0) ) {
         logmsg(LOG_ERROR, "qry_object_all_source() - Unable to close FILE* (qry_object_cleanup)");
+        retval = EXIT_FAILURE;
+    }
 
     return retval;
   
@@ -455,11 +499,11 @@ static int qry_last_ddl_time(const char *schema,
                              time_t *last_ddl_time /* out */) {
 
     char query_user[] =
-"select to_char(last_ddl_time, 'yyyy-mm-dd hh24:mi:ss') as last_ddl_time\
+"select " ORA_EPOCH("last_ddl_time") " as last_ddl_time\
  from all_objects where owner=:schema and object_type=:type and object_name=:name";
 
     const char *query_dba =
-"select to_char(o.mtime, 'yyyy-mm-dd hh24:mi:ss') as last_ddl_time\
+"select " ORA_EPOCH("o.mtime") " as last_ddl_time\
  from sys.obj$ o\
  join sys.user$ u on u.user# = o.owner#\
  where u.name=:schema and o.type#=:type and o.name=:name";
@@ -469,37 +513,14 @@ static int qry_last_ddl_time(const char *schema,
     const char *query = (g_conf._isdba == 1 ? query_dba : query_user);
 
     int retval = EXIT_SUCCESS;
-    int type_id = 0;
-
-    if (strcmp(type, "TABLE") == 0)
-        type_id = 2;
-    else if (strcmp(type, "VIEW") == 0)
-        type_id = 4;
-    else if (strcmp(type, "PROCEDURE") == 0)
-        type_id = 7;
-    else if (strcmp(type, "FUNCTION") == 0)
-        type_id = 8;
-    else if (strcmp(type, "PACKAGE") == 0)
-        type_id = 9;
-    else if (strcmp(type, "PACKAGE BODY") == 0)
-        type_id = 11;
-    else if (strcmp(type, "TRIGGER") == 0)
-        type_id = 12;
-    else if (strcmp(type, "TYPE") == 0)
-        type_id = 13;
-    else if (strcmp(type, "TYPE BODY") == 0)
-        type_id = 14;
-    else if (strcmp(type, "JAVA SOURCE") == 0)
-        type_id = 28;
-    else if (strcmp(type, "MATERIALIZED VIEW") == 0)
-        type_id = 42;
-    else {
+    const t_objtype *ot = ot_by_ora(type);
+    int type_id = (ot == NULL ? 0 : ot->obj_type_num);
+    if (type_id == 0)
         logmsg(LOG_ERROR, "qry_last_ddl_time(): Unsupported type [%s]!", type);
-    }
 
     OCIBind *o_bn2;
     ORA_STMT_PREPARE(qry_last_ddl_time);
-    ORA_STMT_DEFINE_STR(qry_last_ddl_time, 1, last_str_time, 30);
+    ORA_STMT_DEFINE_TIME(qry_last_ddl_time, 1, last_epoch);
     ORA_STMT_BIND_STR(qry_last_ddl_time, 1, schema);
     int r = 0;
     if (g_conf._isdba == 1)
@@ -514,11 +535,7 @@ static int qry_last_ddl_time(const char *schema,
     ORA_STMT_BIND_STR(qry_last_ddl_time, 3, object);
     ORA_STMT_EXECUTE(qry_last_ddl_time, 0);
     if (ORA_STMT_FETCH) {        
-        *last_ddl_time = utl_str2time(ORA_VAL(last_str_time));
-        if (*last_ddl_time < 0) {
-            logmsg(LOG_ERROR, "qry_last_ddl_time: unable to parse last_str_time=[%s]", ORA_VAL(last_str_time));
-            retval = EXIT_FAILURE;
-        }
+        *last_ddl_time = utl_epoch2time(ORA_VAL(last_epoch));
     } else {
         logmsg(LOG_ERROR, "Unable to obtain last_ddl_time for [%s].[%s] (%s) -> no such object in all_objects", schema, object, type);
         retval = EXIT_FAILURE;
@@ -529,19 +546,25 @@ qry_last_ddl_time_cleanup:
     return retval;
 }
 
-int qry_object(char *schema,
-               char *type,
-               char *object,
-               char **fname) {
+// prefetch=1 => (re)fetch object only if it is missing or outdated and don't touch it otherwise
+// known_ldt is last_ddl_time of the object if caller already knows it (or 0 if it should be queried)
+static int qry_object_ex(const char *schema,
+                         const char *type,
+                         const char *object,
+                         char **fname,
+                         int prefetch,
+                         time_t known_ldt) {
 
     int retval = EXIT_SUCCESS;
     char *object_schema = NULL;
     char *object_type = NULL;
     char *object_name = NULL;
-    int is_java_source = 0;
-    int is_trigger_source = 0;
+    const t_objtype *ot = ot_by_fs(type);
+    t_ot_fetch fetch = (ot == NULL ? OT_FETCH_SOURCE : ot->fetch);
     struct utimbuf newtime;
     time_t last_ddl_time = 0;
+    t_tfs_meta meta;
+    int fetched = 0;
 
     // determine fname
     if (qry_object_fname(schema, type, object, fname) != EXIT_SUCCESS) {
@@ -582,39 +605,102 @@ int qry_object(char *schema,
         return EXIT_FAILURE;
     }
 
-    is_java_source = ((strcmp(object_type, "JAVA SOURCE") == 0) ? 1 : 0);
-    is_trigger_source = ((strcmp(object_type, "TRIGGER") == 0) ? 1 : 0);
-
     logmsg(LOG_DEBUG, "query %s: [%s].[%s]", object_type, object_schema, object_name);
     if (g_conf.dbro == 0 || (g_conf.dbro == 1 && tfs_quick_validate(*fname) != EXIT_SUCCESS)) {
 
-        qry_last_ddl_time(object_schema, object_type, object_name, &last_ddl_time);
-        if (tfs_validate2(*fname, last_ddl_time) == EXIT_SUCCESS) {
+        if (known_ldt != 0)
+            last_ddl_time = known_ldt;
+        else
+            qry_last_ddl_time(object_schema, object_type, object_name, &last_ddl_time);
+
+        // cache entry may be shared with other ddlfs processes (sharedcache=1)
+        tfs_lock(*fname);
+        struct stat cache_st;
+        char path[DDLFS_PATH_MAX];
+        snprintf(path, sizeof(path), "/%s/%s/%s", schema, type, object);
+        if (stat(*fname, &cache_st) == 0 && cache_st.st_mtime != 0 && (prefetch == 1 || cmp_pending(path))) {
+            // locally modified and its DDL not executed yet (see compile.h), it must not be overwritten
+            // (nor its last_ddl_time updated) even if object was changed in database meanwhile
+            logmsg(LOG_DEBUG, ".. cached file is modified, its DDL is pending");
+            tfs_unlock(*fname);
+            free(object_schema);
+            free(object_type);
+            free(object_name);
+            return retval;
+        } else if (tfs_validate2(*fname, last_ddl_time) == EXIT_SUCCESS) {
             logmsg(LOG_DEBUG, ".. got it from standard cache");
         } else {
-            if (strcmp(object_type, "TABLE") == 0) {
-                qry_object_all_tables(object_schema, object_name, *fname);
+            // write to staging file first, so that nobody ever sees partially written cache file
+            char staging_fn[DDLFS_PATH_MAX];
+            if (tfs_staging_fn(*fname, staging_fn, DDLFS_PATH_MAX) != EXIT_SUCCESS) {
+                tfs_unlock(*fname);
+                free(object_schema);
+                free(object_type);
+                free(object_name);
+                return EXIT_FAILURE;
+            }
+
+            // readers of streamed object (see stream.h) follow the staging file while it's being written
+            stm_staging(staging_fn);
+
+            meta.validity = -1;
+            int fetch_retval;
+            if (fetch == OT_FETCH_TABLE) {
+                fetch_retval = qry_object_all_tables(object_schema, object_name, staging_fn);
+                meta.validity = 0;
             } else {
-                qry_object_all_source(object_schema, object_type, object_name, *fname, is_java_source, is_trigger_source);
+                fetch_retval = qry_object_all_source(object_schema, object_type, object_name, staging_fn, fetch, &meta.validity);
+            }
+
+            // partial content must never be cached (nor its streamed readers told it's complete)
+            if (fetch_retval != EXIT_SUCCESS) {
+                logmsg(LOG_ERROR, "qry_object() - unable to fetch [%s].[%s].[%s]", object_schema, object_type, object_name);
+                remove(staging_fn);
+                tfs_unlock(*fname);
+                free(object_schema);
+                free(object_type);
+                free(object_name);
+                return EXIT_FAILURE;
             }
+
+            // identical content may already be cached for another schema, pdb or mount
+            if (tfs_dedup(staging_fn, &meta.content_hash) != EXIT_SUCCESS)
+                meta.content_hash = 0;
+
+            if (tfs_commit(staging_fn, *fname) != EXIT_SUCCESS)
+                retval = EXIT_FAILURE;
+            fetched = 1;
         }
 
-        // set standard file attributes on cached file (atime & mtime)
-        newtime.actime = time(NULL);
-        newtime.modtime = 0; // important. If this changes to anything else, we know that a write occured on
-                             // underlying filesystem. (if file was opened as R/W, that does not mean it actually changed
-                             // and that we need to execute DDL upon process closing it)
-        if (utime(*fname, &newtime) == -1) {
-            logmsg(LOG_ERROR, "qry_object() - unable to reset file modification time!");
-            retval = EXIT_FAILURE;
+        if (prefetch == 1 && fetched == 0) {
+            // entry is up2date, user may have it opened, so it has to be left alone
+            tfs_unlock(*fname);
+            free(object_schema);
+            free(object_type);
+            free(object_name);
+            return retval;
         }
 
-        if (tfs_setldt(*fname, last_ddl_time) != EXIT_SUCCESS) {
+        // set standard file attributes on freshly fetched cache file (atime & mtime), entry which was
+        // only validated keeps them. mtime=0 means that the file was not modified locally (it is not
+        // overwritten while its DDL is pending), writes through the filesystem are tracked by their handles (see fs_release)
+        if (fetched) {
+            newtime.actime = time(NULL);
+            newtime.modtime = 0;
+            if (utime(*fname, &newtime) == -1) {
+                logmsg(LOG_ERROR, "qry_object() - unable to reset file modification time!");
+                retval = EXIT_FAILURE;
+            }
+        }
+
+        meta.last_ddl_time = last_ddl_time;
+        if ((fetched ? tfs_setmeta(*fname, &meta) : tfs_setldt(*fname, last_ddl_time)) != EXIT_SUCCESS) {
             logmsg(LOG_ERROR, "qry_object() - unable to set last_ddl_time on [%s], caching won't work (= disabled)", *fname);
             // this is not a fatal error - it should only have impact on performance, not functionality.
         } else {
             // (this si too verbose) logmsg(LOG_DEBUG, "qry_object() - set LDT for [%s] to [%d]", *fname, last_ddl_time);
         }
+        tfs_unlock(*fname);
     } else {
         logmsg(LOG_DEBUG, ".. got it from quick cache");
     }
@@ -626,64 +712,194 @@ int qry_object(char *schema,
     return retval;
 }
 
-int qry_schemas() {
-    // variables
+int qry_object(const char *schema,
+               const char *type,
+               const char *object,
+               char **fname) {
+    return qry_object_ex(schema, type, object, fname, 0, 0);
+}
+
+int qry_object_prefetch(const char *schema,
+                        const char *type,
+                        const char *object,
+                        time_t last_ddl_time) {
+    char *fname = NULL;
+    int retval = qry_object_ex(schema, type, object, &fname, 1, last_ddl_time);
+    if (fname != NULL)
+        free(fname);
+    return retval;
+}
+
+int qry_related(const char *schema,
+                const char *type,
+                const char *object,
+                t_related *related,
+                int max,
+                int *count) {
+    char query[1024];
+    const char *query_fmt =
+"select o.object_type, o.object_name, " ORA_EPOCH("o.last_ddl_time") " as t_modified\
+ from all_objects o\
+ where o.owner=:bind_owner and o.generated='N' and %s and o.object_type != :bind_type";
+    char filter[512];
+    char *object_name = NULL;
     int retval = EXIT_SUCCESS;
-    char *query = NULL, *query_in = NULL, *query_like = NULL;
-    char *input = strdup(g_conf.schemas);
-    char *token;
-    char *bind_in[100], *bind_like[100];
+
+    *count = 0;
+    const t_objtype *ot = ot_by_fs(type);
+    if (ot == NULL || ot->related == OT_RELATED_NONE)
+        return EXIT_SUCCESS; // nothing is related to this type of objects
+
+    if (ot->related == OT_RELATED_NAME)
+        snprintf(filter, sizeof(filter), "o.object_name=:bind_name and o.object_type in (%s)", ot->related_types);
+    else
+        snprintf(filter, sizeof(filter), "o.object_type='TRIGGER' and o.object_name in (\
+select t.trigger_name from all_triggers t\
+ where t.owner=o.owner and t.table_owner=o.owner and t.table_name=:bind_name)");
+
+    snprintf(query, 1024, query_fmt, filter);
+    ora_replace_all_dba(query);
+
+    if (str_fn2obj(&object_name, object, type) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "qry_related() - unable to normalize object_name [%s].", object);
+        if (object_name != NULL)
+            free(object_name);
+        return EXIT_FAILURE;
+    }
+
+    const char *object_type = ot->ora_name;
+
+    ORA_STMT_PREPARE(qry_related);
+    ORA_STMT_DEFINE_STR(qry_related, 1, rel_type,   30);
+    ORA_STMT_DEFINE_STR(qry_related, 2, rel_name,   256);
+    ORA_STMT_DEFINE_TIME(qry_related, 3, t_modified);
+    ORA_STMT_BIND_STR(qry_related, 1, schema);
+    ORA_STMT_BIND_STR(qry_related, 2, object_name);
+    ORA_STMT_BIND_STR(qry_related, 3, object_type);
+    ORA_STMT_EXECUTE(qry_related, 0);
+
+    while (ORA_STMT_FETCH && *count < max) {
+        char *rel_type = strdup(ORA_VAL(rel_type));
+        char *suffix = NULL;
+        if (rel_type == NULL || utl_ora2fstype(&rel_type) != EXIT_SUCCESS || str_suffix(&suffix, rel_type) != EXIT_SUCCESS) {
+            logmsg(LOG_ERROR, "qry_related() - unable to convert type [%s]", ORA_VAL(rel_type));
+            if (rel_type != NULL)
+                free(rel_type);
+            retval = EXIT_FAILURE;
+            goto qry_related_cleanup;
+        }
+
+        if (strchr(ORA_VAL(rel_name), '/') == NULL) { // see qry_objects()
+            t_related *r = &related[(*count)++];
+            snprintf(r->type, sizeof(r->type), "%s", rel_type);
+            snprintf(r->fname, sizeof(r->fname), "%s%s", ORA_VAL(rel_name), suffix);
+            r->last_ddl_time = utl_epoch2time(ORA_VAL(t_modified));
+        }
+
+        free(rel_type);
+        free(suffix);
+    }
+
+qry_related_cleanup:
+    ORA_STMT_FREE;
+    free(object_name);
+    return retval;
+}
+
+int qry_schemas_filter(const char *column, char **filter, char **binds, int *bind_count) {
+    char *query_in = NULL, *query_like = NULL;
+    char *bind_in[QRY_SCHEMAS_MAX], *bind_like[QRY_SCHEMAS_MAX];
     int bind_in_i = 0, bind_like_i = 0;
-    int pos_in, pos_like;
-    int        o_bnd_idx = 0;
     char tmp[50]; // for converting int to char*
+    char *input = strdup(g_conf.schemas);
+    char *token;
+
+    *filter = NULL;
+    *bind_count = 0;
+    if (input == NULL) {
+        logmsg(LOG_ERROR, "qry_schemas_filter() - unable to allocate memory for schemas");
+        return EXIT_FAILURE;
+    }
 
-    // build query
-    pos_in = 0;
-    pos_like = 0;
     token = strtok(input, ":");
     while (token) {
+        if (bind_in_i >= QRY_SCHEMAS_MAX || bind_like_i >= QRY_SCHEMAS_MAX) {
+            logmsg(LOG_ERROR, "Specified more than maximum number of schemas (allowed: %dx like, %dx in; got %dx in, %dx like", 
+                QRY_SCHEMAS_MAX, QRY_SCHEMAS_MAX, bind_in_i, bind_like_i);
+            for (int i = 0; i < bind_in_i; i++)
+                free(bind_in[i]);
+            for (int i = 0; i < bind_like_i; i++)
+                free(bind_like[i]);
+            free(query_in);
+            free(query_like);
+            free(input);
+            return EXIT_FAILURE;
+        }
+
         if (strstr(token, "%") == NULL) {
-            if (pos_in != 0)
+            if (bind_in_i != 0)
                 str_append(&query_in, ", ");
             str_append(&query_in, ":bi_");
-            snprintf(tmp, 50, "%d",pos_in++);
+            snprintf(tmp, 50, "%d", bind_in_i);
             str_append(&query_in, tmp);
-            bind_in[bind_in_i] = strdup(token);
-            bind_in_i++;
+            bind_in[bind_in_i++] = strdup(token);
         } else {
-            if (pos_like != 0)
+            if (bind_like_i != 0)
                 str_append(&query_like, " OR ");
-            str_append(&query_like, "username LIKE :bl_");
-            snprintf(tmp, 50, "%d", pos_like++);
+            str_append(&query_like, column);
+            str_append(&query_like, " LIKE :bl_");
+            snprintf(tmp, 50, "%d", bind_like_i);
             str_append(&query_like, tmp);
-            bind_like[bind_like_i] = strdup(token);
-            bind_like_i++;
+            bind_like[bind_like_i++] = strdup(token);
         }
         token = strtok(NULL, ":");
-
-        if (bind_in_i >= 100 || bind_like_i >= 100) {
-            logmsg(LOG_ERROR, "Specified more than maximum number of schemas (allowed: 100x like, 100x in; got %dx in, %dx like", bind_in_i, bind_like_i);
-            return EXIT_FAILURE;
-        }
     }
-
-    str_append(&query, "SELECT username, to_char(created, 'yyyy-mm-dd hh24:mi:ss') as created FROM all_users WHERE");
-    if (pos_in != 0 && pos_like != 0) {
-        str_append(&query, " username IN (");
-        str_append(&query, query_in);
-        str_append(&query, " OR ");
-        str_append(&query, query_like);
-    } else if (pos_in == 0 && pos_like != 0) {
-        str_append(&query, " ");
-        str_append(&query, query_like);
-    } else if (pos_in != 0 && pos_like == 0) {
-        str_append(&query, " username IN (");
-        str_append(&query, query_in);
-        str_append(&query, ")");
-    } else {
+    free(input);
+
+    str_append(filter, "(");
+    if (bind_in_i != 0) {
+        str_append(filter, column);
+        str_append(filter, " IN (");
+        str_append(filter, query_in);
+        str_append(filter, ")");
+    }
+    if (bind_in_i != 0 && bind_like_i != 0)
+        str_append(filter, " OR ");
+    if (bind_like_i != 0)
+        str_append(filter, query_like);
+    if (bind_in_i == 0 && bind_like_i == 0) {
         logmsg(LOG_ERROR, "Seems like no schemas is given in parameter?!");
+        str_append(filter, "1=0");
     }
+    str_append(filter, ")");
+
+    // binds are in the same order as placeholders in filter
+    for (int i = 0; i < bind_in_i; i++)
+        binds[(*bind_count)++] = bind_in[i];
+    for (int i = 0; i < bind_like_i; i++)
+        binds[(*bind_count)++] = bind_like[i];
+
+    if (query_in != NULL)
+        free(query_in);
+    if (query_like != NULL)
+        free(query_like);
+
+    return (*filter == NULL ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int qry_schemas() {
+    // variables
+    int retval = EXIT_SUCCESS;
+    char *query = NULL, *filter = NULL;
+    char *binds[QRY_SCHEMAS_MAX*2];
+    int bind_count = 0;
+
+    // build query
+    if (qry_schemas_filter("username", &filter, binds, &bind_count) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    str_append(&query, "SELECT username, " ORA_EPOCH("created") " as created FROM all_users WHERE ");
+    str_append(&query, filter);
     str_append(&query, " ORDER BY username");
 
     // logmsg(LOG_DEBUG, "query=[%s]", query);
@@ -691,17 +907,11 @@ int qry_schemas() {
 
     ORA_STMT_PREPARE (qry_schemas);
     ORA_STMT_DEFINE_STR_I(qry_schemas, 1, username, 300);
-    ORA_STMT_DEFINE_STR_I(qry_schemas, 2, created,  30);
-
-    for (int i = 0; i < bind_in_i; i++) {
-        o_bnd_idx++;
-        ORA_STMT_BIND_STR(qry_schemas, o_bnd_idx, bind_in[i]);
-        //o_bnd_idx++;
-    }
+    ORA_STMT_DEFINE_TIME_I(qry_schemas, 2, created);
 
-    for (int i = 0; i < bind_like_i; i++) {
-        o_bnd_idx++;
-        ORA_STMT_BIND_STR(qry_schemas, o_bnd_idx, bind_like[i]);
+    for (int i = 0; i < bind_count; i++) {
+        int o_bnd_idx = i+1;
+        ORA_STMT_BIND_STR(qry_schemas, o_bnd_idx, binds[i]);
     }
 
     ORA_STMT_EXECUTE(qry_schemas, 0);
@@ -709,7 +919,6 @@ int qry_schemas() {
     // vfs_entry_free(g_vfs, 1);
 
     while (ORA_STMT_FETCH) {
-        // convert created date
         /*
 		struct tm *temptime = malloc(sizeof(struct tm));
         if (temptime == NULL) {
@@ -728,8 +937,7 @@ int qry_schemas() {
         time_t created_time = timegm(temptime);
         free(temptime);
 		*/
-		time_t created_time = utl_str2time(ORA_VAL(created));
-        // end of date conversion
+        time_t created_time = utl_epoch2time(ORA_VAL(created));
 
         t_fsentry *entry = vfs_entry_create('D', o_username, created_time, created_time);
         t_fsentry *exists = vfs_entry_search(g_vfs, entry->fname);
@@ -746,30 +954,28 @@ int qry_schemas() {
     else
         vfs_entry_free(ddllog, 0);
 
+    t_fsentry *status = vfs_entry_create('F', "ddlfs.status", time(NULL), time(NULL));
+    exists = vfs_entry_search(g_vfs, status->fname);
+    if (exists == NULL)
+        vfs_entry_add(g_vfs, status);
+    else
+        vfs_entry_free(status, 0);
+
     vfs_entry_sort(g_vfs);
 
 
 qry_schemas_cleanup:
-    if (input != NULL)
-        free(input);
-
     if (query != NULL)
         free(query);
 
-    if (query_in != NULL)
-        free(query_in);
-
-    if (query_like != NULL)
-        free(query_like);
+    if (filter != NULL)
+        free(filter);
 
     if (o_stm != NULL)
         ora_stmt_free(o_stm);
 
-    for (int i = 0; i < bind_in_i; i++)
-        free(bind_in[i]);
-
-     for (int i = 0; i < bind_like_i; i++)
-        free(bind_like[i]);
+    for (int i = 0; i < bind_count; i++)
+        free(binds[i]);
 
     return retval;
 }
@@ -777,24 +983,15 @@ qry_schemas_cleanup:
 int qry_types(t_fsentry *schema) {
     vfs_entry_free(schema, 1);
 
-    char *types[] = {
-        "FUNCTION",
-        "JAVA_SOURCE",
-        "MATERIALIZED_VIEW",
-        "PACKAGE_BODY",
-        "PACKAGE_SPEC",
-        "PROCEDURE",
-        "TABLE",
-        "TRIGGER",
-        "TYPE",
-        "TYPE_BODY",
-        "VIEW",
-        NULL
-    };
-
     time_t fixed_date = utl_str2time("1990-01-01 01:01:01");
-    for (int i = 0; types[i] != NULL; i++)
-        vfs_entry_add(schema, vfs_entry_create('D', types[i], fixed_date, fixed_date));
+    for (int i = 0; i < OT_COUNT; i++) {
+        const t_objtype *ot = ot_get(i);
+        if (ot->listed == 0)
+            continue;
+        t_fsentry *entry = vfs_entry_create('D', ot->fs_name, fixed_date, fixed_date);
+        entry->otype = ot->id;
+        vfs_entry_add(schema, entry);
+    }
 
     vfs_entry_sort(schema);
 
@@ -822,13 +1019,14 @@ static int qry_objects_filesize(t_fsentry *schema, t_fsentry *type) {
 int qry_objects(t_fsentry *schema, t_fsentry *type) {
     int retval = EXIT_SUCCESS;
     char query[500] = "select \
-o.object_name, to_char(o.last_ddl_time, 'yyyy-mm-dd hh24:mi:ss') as t_modified, o.status \
+o.object_name, " ORA_EPOCH("o.last_ddl_time") " as t_modified, o.status \
 from all_objects o where o.owner=:bind_owner and o.object_type=:bind_type and generated='N'";
 
     OCIStmt   *o_stm = NULL;
     OCIDefine *o_def[3] = {NULL, NULL, NULL};
     OCIBind   *o_bnd[2] = {NULL, NULL};
     char      *o_sel[3] = {NULL, NULL, NULL};
+    long long  o_modified = 0;
 
     char *schema_name = strdup(schema->fname);
     char *type_name = strdup(type->fname);
@@ -869,11 +1067,9 @@ where s.owner='SYS' and s.\"TYPE\"='TYPE' AND s.\"NAME\"=o.object_name)");
         return EXIT_FAILURE;
     }
 
-    struct tm *temptime = malloc(sizeof(struct tm));
-
     vfs_entry_free(type, 1);
 
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < 3; i += 2)
         if ((o_sel[i] = malloc(256*sizeof(char))) == NULL) {
             logmsg(LOG_ERROR, "Unable to allocate memory for sel[%d]", i);
             return EXIT_FAILURE;
@@ -889,7 +1085,7 @@ where s.owner='SYS' and s.\"TYPE\"='TYPE' AND s.\"NAME\"=o.object_name)");
         goto qry_objects_cleanup;
     }
 
-    if (ora_stmt_define(o_stm, &o_def[1], 2, (void*) o_sel[1], 256*sizeof(char), SQLT_STR)) {
+    if (ora_stmt_define(o_stm, &o_def[1], 2, (void*) &o_modified, sizeof(long long), SQLT_INT)) {
         retval = EXIT_FAILURE;
         goto qry_objects_cleanup;
     }
@@ -915,18 +1111,7 @@ where s.owner='SYS' and s.\"TYPE\"='TYPE' AND s.\"NAME\"=o.object_name)");
     }
 
     while (ora_stmt_fetch(o_stm) == OCI_SUCCESS) {
-		/*
-        memset(temptime, 0, sizeof(struct tm));
-        char* xx = strptime(((char*)o_sel[1]), "%Y-%m-%d %H:%M:%S", temptime);
-        if (*xx != '\0') {
-            logmsg(LOG_ERROR, "Unable to parse date!");
-            retval = EXIT_FAILURE;
-            goto qry_objects_cleanup;
-        }
-
-        time_t t_modified = timegm(temptime);
-		*/
-		time_t t_modified = utl_str2time((char*)o_sel[1]);
+        time_t t_modified = utl_epoch2time(o_modified);
         size_t fname_len = ((strlen((char*)o_sel[0])+strlen(suffix))+1)*sizeof(char);
         char *fname = malloc(fname_len);
         if (fname == NULL) {
@@ -972,9 +1157,6 @@ qry_objects_cleanup:
     if (type_name != NULL)
         free(type_name);
 
-    if (temptime != NULL)
-        free(temptime);
-
     if (suffix != NULL)
         free(suffix);
 
@@ -1045,15 +1227,99 @@ log_ddl_errors_cleanup:
     return retval;
 }
 
-int qry_exec_ddl(char *schema, char *object, char *ddl) {
+// last_ddl_time, status and errors (written to ddlfs.log) of object after its DDL, in a single PL/SQL round trip
+static int qry_ddl_result(const char *schema, const char *object, const char *type, t_ddl_result *result) {
+    char query[] =
+"declare\
+ l_owner varchar2(128) := :bind_owner;\
+ l_name varchar2(128) := :bind_name;\
+ l_type varchar2(30) := :bind_type;\
+ l_ldt number;\
+ l_status varchar2(10);\
+ l_errors varchar2(4000);\
+ begin\
+ for o in (select " ORA_EPOCH("last_ddl_time") " as ldt, status from all_objects\
+ where owner=l_owner and object_name=l_name and object_type=l_type) loop\
+ l_ldt := o.ldt;\
+ l_status := o.status;\
+ end loop;\
+ for e in (select attribute || ', line ' || line || ', column ' || position || ': ' || text as msg from all_errors\
+ where owner=l_owner and name=l_name and type=l_type order by sequence) loop\
+ exit when nvl(length(l_errors), 0) + length(e.msg) >= 3999;\
+ l_errors := l_errors || e.msg || chr(10);\
+ end loop;\
+ :bind_ldt := nvl(l_ldt, -1);\
+ :bind_status := nvl(l_status, '-');\
+ :bind_errors := nvl(l_errors, '-');\
+ end;";
+
+    int retval = EXIT_SUCCESS;
+    OCIStmt *o_stm = NULL;
+    OCIBind *o_bnd[6] = {NULL, NULL, NULL, NULL, NULL, NULL};
+    long long o_ldt = -1;
+    char o_status[10] = "";
+    char *o_errors = NULL;
+
+    result->last_ddl_time = 0;
+    result->valid = 0;
+
+    if ((o_errors = malloc(4001*sizeof(char))) == NULL) {
+        logmsg(LOG_ERROR, "qry_ddl_result() - Unable to allocate memory for o_errors.");
+        return EXIT_FAILURE;
+    }
+
+    ora_replace_all_dba(query);
+
+    if (ora_stmt_prepare(&o_stm, query) ||
+        ora_stmt_bind(o_stm, &o_bnd[0], 1, (void*) schema, (sb4) (strlen(schema)+1), SQLT_STR) ||
+        ora_stmt_bind(o_stm, &o_bnd[1], 2, (void*) object, (sb4) (strlen(object)+1), SQLT_STR) ||
+        ora_stmt_bind(o_stm, &o_bnd[2], 3, (void*) type, (sb4) (strlen(type)+1), SQLT_STR) ||
+        ora_stmt_bind(o_stm, &o_bnd[3], 4, (void*) &o_ldt, sizeof(o_ldt), SQLT_INT) ||
+        ora_stmt_bind(o_stm, &o_bnd[4], 5, (void*) o_status, sizeof(o_status), SQLT_STR) ||
+        ora_stmt_bind(o_stm, &o_bnd[5], 6, (void*) o_errors, 4001*sizeof(char), SQLT_STR) ||
+        ora_stmt_execute(o_stm, 1)) {
+        retval = EXIT_FAILURE;
+        goto qry_ddl_result_cleanup;
+    }
+
+    if (o_ldt >= 0)
+        result->last_ddl_time = utl_epoch2time(o_ldt);
+    result->valid = (strcmp(o_status, "VALID") == 0);
+
+    // one error per line
+    for (char *line = o_errors; strcmp(o_errors, "-") != 0 && *line != '\0'; ) {
+        char *eol = strchr(line, '\n');
+        if (eol != NULL)
+            *eol = '\0';
+        logddl(".. %s", line);
+        line = (eol == NULL ? line + strlen(line) : eol + 1);
+    }
+
+qry_ddl_result_cleanup:
+
+    if (o_stm != NULL)
+        ora_stmt_free(o_stm);
+
+    free(o_errors);
+
+    return retval;
+}
+
+int qry_exec_ddl(char *schema, char *object, const char *ddl, size_t len, const char *type, t_ddl_result *result) {
     int retval = EXIT_SUCCESS;
     OCIStmt *stm = NULL;
     char ddl_msg[120];
 
+    if (result != NULL) {
+        result->last_ddl_time = 0;
+        result->valid = 0;
+    }
+
     // prepare log message (first 120 characters without newlines)
-    strncpy(ddl_msg, ddl, 119);
-    ddl_msg[119] = '\0';
-    for (int i = 0; i < 120; i++) {
+    size_t msg_len = (len < 119 ? len : 119);
+    memcpy(ddl_msg, ddl, msg_len);
+    ddl_msg[msg_len] = '\0';
+    for (size_t i = 0; i < msg_len; i++) {
         switch (ddl_msg[i]) {
             case '\n':
             case '\r':
@@ -1063,11 +1329,11 @@ int qry_exec_ddl(char *schema, char *object, char *ddl) {
     }
     logddl(ddl_msg);
 
-    if (ora_stmt_prepare(&stm, ddl)) {
+    if (ora_stmt_prepare_len(&stm, ddl, len)) {
         return EXIT_FAILURE;
     }
 
-    logmsg(LOG_DEBUG, "Executing DDL (%s)", ddl); // @todo - remove this debug messages
+    logmsg(LOG_DEBUG, "Executing DDL (%.*s)", (int) msg_len, ddl); // @todo - remove this debug messages
 
     int ddlret = ora_stmt_execute(stm, 1);
     if (ddlret) {
@@ -1107,14 +1373,21 @@ int qry_exec_ddl(char *schema, char *object, char *ddl) {
                 break;
         }
         logddl(".. %s,", ociret);
-        if (log_ddl_errors(schema, object) != EXIT_SUCCESS)
+        if (result != NULL) {
+            if (qry_ddl_result(schema, object, type, result) != EXIT_SUCCESS)
+                logmsg(LOG_ERROR, "qry_exec_ddl() - Unable to log ddl errors to ddlfs.log");
+        } else if (log_ddl_errors(schema, object) != EXIT_SUCCESS) {
             logmsg(LOG_ERROR, "qry_exec_ddl() - Unable to log ddl errors to ddlfs.log");
+        }
         logddl(" ");
 
         goto qry_exec_ddl_cleanup;
     }
     logddl(".. SUCCESS\n");
 
+    if (result != NULL && qry_ddl_result(schema, object, type, result) != EXIT_SUCCESS)
+        logmsg(LOG_ERROR, "qry_exec_ddl() - Unable to query state of [%s].[%s] after DDL", schema, object);
+
 
 qry_exec_ddl_cleanup:
 
@@ -1123,3 +1396,176 @@ qry_exec_ddl_cleanup:
 
     return retval;
 }
+
+int qry_exec_drops(char **ddl, int count, int *failed) {
+    const char *block_begin = "declare\n l_errors varchar2(32000);\nbegin\n";
+    const char *block_stmt = " begin execute immediate '%s';\n exception when others then l_errors := substr(l_errors || '%d:' || sqlerrm || chr(10), 1, 32000);\n end;\n";
+    const char *block_end = " :bind_errors := nvl(l_errors, '-');\nend;";
+    int retval = EXIT_SUCCESS;
+    OCIStmt *o_stm = NULL;
+    OCIBind *o_bnd = NULL;
+    char *o_errors = NULL;
+    char *query = NULL;
+
+    // statements are embedded as literals, quotes are doubled
+    size_t query_size = strlen(block_begin) + strlen(block_end) + 1;
+    for (int i = 0; i < count; i++) {
+        failed[i] = 1;
+        query_size += strlen(block_stmt) + 20 + 2*strlen(ddl[i]);
+    }
+
+    query = malloc(query_size);
+    o_errors = malloc(32001*sizeof(char));
+    if (query == NULL || o_errors == NULL) {
+        logmsg(LOG_ERROR, "qry_exec_drops() - Unable to allocate memory for %d statements.", count);
+        retval = EXIT_FAILURE;
+        goto qry_exec_drops_cleanup;
+    }
+
+    size_t len = (size_t) sprintf(query, "%s", block_begin);
+    for (int i = 0; i < count; i++) {
+        char escaped[2048];
+        size_t e = 0;
+        for (const char *c = ddl[i]; *c != '\0' && e < sizeof(escaped)-2; c++) {
+            if (*c == '\'')
+                escaped[e++] = '\'';
+            escaped[e++] = *c;
+        }
+        escaped[e] = '\0';
+        len += (size_t) sprintf(query + len, block_stmt, escaped, i);
+    }
+    sprintf(query + len, "%s", block_end);
+
+    logddl("Dropping %d objects", count);
+    if (ora_stmt_prepare(&o_stm, query) ||
+        ora_stmt_bind(o_stm, &o_bnd, 1, (void*) o_errors, 32001*sizeof(char), SQLT_STR) ||
+        ora_stmt_execute(o_stm, 1)) {
+        logmsg(LOG_ERROR, "qry_exec_drops() - unable to execute %d DROP statements.", count);
+        logddl(".. FAILED (see ddlfs log for details)\n");
+        retval = EXIT_FAILURE;
+        goto qry_exec_drops_cleanup;
+    }
+
+    for (int i = 0; i < count; i++)
+        failed[i] = 0;
+
+    // one "<index>:<error>" per line
+    for (char *line = o_errors; strcmp(o_errors, "-") != 0 && *line != '\0'; ) {
+        char *eol = strchr(line, '\n');
+        if (eol != NULL)
+            *eol = '\0';
+        int i = atoi(line);
+        char *msg = strchr(line, ':');
+        if (i >= 0 && i < count && msg != NULL) {
+            failed[i] = 1;
+            logddl("%s .. %s", ddl[i], msg + 1);
+        }
+        line = (eol == NULL ? line + strlen(line) : eol + 1);
+    }
+
+    for (int i = 0; i < count; i++)
+        if (failed[i] == 0)
+            logddl("%s .. SUCCESS", ddl[i]);
+    logddl(" ");
+
+qry_exec_drops_cleanup:
+
+    if (o_stm != NULL)
+        ora_stmt_free(o_stm);
+
+    free(o_errors);
+    free(query);
+
+    return retval;
+}
+
+static int qry_dependencies_cmp(const void *a, const void *b) {
+    return strcmp(*(const char**) a, *(const char**) b);
+}
+
+int qry_dependencies(const char *schema, char **names, int name_count, t_dependency **deps, int *count) {
+    char query[1024] =
+"select d.name, d.type, d.referenced_name, d.referenced_type\
+ from all_dependencies d\
+ where d.owner=:bind_owner and d.referenced_owner=:bind_ref_owner\
+ and d.referenced_type in ('PACKAGE', 'TYPE', 'FUNCTION', 'PROCEDURE', 'VIEW')\
+ and d.name != d.referenced_name";
+    int retval = EXIT_SUCCESS;
+    int capacity = 0;
+
+    *deps = NULL;
+    *count = 0;
+    if (name_count < 2)
+        return EXIT_SUCCESS;
+
+    ora_replace_all_dba(query);
+    qsort(names, name_count, sizeof(char*), qry_dependencies_cmp);
+
+    ORA_STMT_PREPARE(qry_dependencies);
+    ORA_STMT_DEFINE_STR(qry_dependencies, 1, name,            256);
+    ORA_STMT_DEFINE_STR(qry_dependencies, 2, type,            30);
+    ORA_STMT_DEFINE_STR(qry_dependencies, 3, referenced_name, 256);
+    ORA_STMT_DEFINE_STR(qry_dependencies, 4, referenced_type, 30);
+    ORA_STMT_BIND_STR(qry_dependencies, 1, schema);
+    ORA_STMT_BIND_STR(qry_dependencies, 2, schema);
+    ORA_STMT_EXECUTE(qry_dependencies, 0);
+
+    while (ORA_STMT_FETCH) {
+        // whole schema is fetched, only dependencies among given objects are returned
+        const char *name = ORA_VAL(name);
+        const char *referenced_name = ORA_VAL(referenced_name);
+        if (bsearch(&name, names, name_count, sizeof(char*), qry_dependencies_cmp) == NULL ||
+            bsearch(&referenced_name, names, name_count, sizeof(char*), qry_dependencies_cmp) == NULL)
+            continue;
+
+        if (*count == capacity) {
+            capacity = (capacity == 0 ? 64 : capacity * 2);
+            t_dependency *tmp = realloc(*deps, capacity * sizeof(t_dependency));
+            if (tmp == NULL) {
+                logmsg(LOG_ERROR, "qry_dependencies() - unable to allocate memory for %d dependencies.", capacity);
+                retval = EXIT_FAILURE;
+                goto qry_dependencies_cleanup;
+            }
+            *deps = tmp;
+        }
+
+        t_dependency *d = &(*deps)[(*count)++];
+        snprintf(d->name, sizeof(d->name), "%s", ORA_VAL(name));
+        snprintf(d->type, sizeof(d->type), "%s", ORA_VAL(type));
+        snprintf(d->referenced_name, sizeof(d->referenced_name), "%s", ORA_VAL(referenced_name));
+        snprintf(d->referenced_type, sizeof(d->referenced_type), "%s", ORA_VAL(referenced_type));
+    }
+
+qry_dependencies_cleanup:
+    ORA_STMT_FREE;
+    if (retval != EXIT_SUCCESS) {
+        free(*deps);
+        *deps = NULL;
+        *count = 0;
+    }
+    return retval;
+}
+
+int qry_compile_invalid(const char *schema) {
+    const char *query = "begin dbms_utility.compile_schema(schema => :bind_schema, compile_all => false); end;";
+    int retval = EXIT_SUCCESS;
+    OCIStmt *o_stm = NULL;
+    OCIBind *o_bnd = NULL;
+
+    logddl("Recompiling invalid objects of schema [%s]", schema);
+
+    if (ora_stmt_prepare(&o_stm, query) ||
+        ora_stmt_bind(o_stm, &o_bnd, 1, (void*) schema, (sb4) (strlen(schema)+1), SQLT_STR) ||
+        ora_stmt_execute(o_stm, 1)) {
+        logmsg(LOG_ERROR, "qry_compile_invalid() - unable to recompile invalid objects of schema [%s]", schema);
+        logddl(".. FAILED (see ddlfs log for details)\n");
+        retval = EXIT_FAILURE;
+    } else {
+        logddl(".. SUCCESS\n");
+    }
+
+    if (o_stm != NULL)
+        ora_stmt_free(o_stm);
+
+    return retval;
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <time.h>
 #include "vfs.h"
 
+#define DDLFS_PATH_MAX 8192 // max. length of cache filename (and of path within filesystem)
+
 /**
  * String utility and query functions.
  * All functions returing an int return EXIT_SUCCESS on success and EXIT_FAILURE on failure.
@@ -16,12 +19,21 @@ int str_suffix(char **dst, const char *objectType);
 /**
  * Convert filename to correct case and optionally remove suffix (.sql)
  * */
-int str_fn2obj(char **dst, char *src, const char *expectedSuffix);
+int str_fn2obj(char **dst, const char *src, const char *expectedSuffix);
+
+#define QRY_SCHEMAS_MAX 100 // max. number of names (and separately, LIKE patterns) in g_conf.schemas
+
+/**
+ * Build where clause condition (filter) which matches column against g_conf.schemas, which is a list of
+ * schema names and/or LIKE patterns separated by ':'. Values to be bound to this filter (in order)
+ * are returned in binds (which must have room for 2*QRY_SCHEMAS_MAX entries). Caller must free filter and binds.
+ * */
+int qry_schemas_filter(const char *column, char **filter, char **binds, int *bind_count);
 
 /**
  * Populate g_vfs with list of schemas. Those are first-level folder entries.
  * */
-void qry_schemas();
+int qry_schemas();
 
 /**
  * Populate g_vfs with list of object types.
@@ -31,7 +43,7 @@ int qry_types(t_fsentry *schema);
 /**
  * Populate g_vfs with list of actual objects (.sql files).
  * */
-void qry_objects(t_fsentry *schema, t_fsentry *type);
+int qry_objects(t_fsentry *schema, t_fsentry *type);
 
 /**
  * Write DDL to of object specified by schema,type,object parameters to file name fname.
@@ -44,6 +56,38 @@ int qry_object(const char *schema,
                const char *object,
                char **fname);
 
+/**
+ * Same as qry_object, except that cached file is only written if it is missing or outdated, an
+ * up2date (or locally modified) cache entry is not touched at all. Meant for background prefetch.
+ * last_ddl_time may be given if caller already knows it, otherwise (0) it is queried.
+ * */
+int qry_object_prefetch(const char *schema,
+                        const char *type,
+                        const char *object,
+                        time_t last_ddl_time);
+
+/**
+ * Object which is likely to be opened after some other object is opened, see qry_related().
+ * */
+typedef struct {
+    char   type[30];     // filesystem type, e.g. PACKAGE_BODY
+    char   fname[300];   // file name, e.g. MY_PACKAGE.SQL
+    time_t last_ddl_time;
+} t_related;
+
+/**
+ * Find objects related to object specified by schema, type (filesystem type) and object (file name):
+ * package spec for its body (and vice versa), type for its type body (and vice versa) and triggers
+ * (owned by the same schema) for a table. All of them are found using a single query.
+ * Up to max objects are returned in related, count is set to number of objects found.
+ * */
+int qry_related(const char *schema,
+                const char *type,
+                const char *object,
+                t_related *related,
+                int max,
+                int *count);
+
 /**
  * Assemble temporary filename based on schema, type and object.
  * */
@@ -53,6 +97,56 @@ int qry_object_fname(const char *schema,
 					 char **fname);
 
 /**
- * Execute DDL statement.
+ * Same as qry_object_fname, but into buffer buf (e.g. DDLFS_PATH_MAX on stack), nothing is allocated.
+ * */
+int qry_object_fname_buf(const char *schema,
+						 const char *type,
+						 const char *object,
+						 char *buf,
+						 size_t size);
+
+/**
+ * Execute count DROP statements as a single anonymous PL/SQL block, error of each statement is
+ * caught separately (so that others are still executed) and written to ddlfs.log. failed[i] is set
+ * to 1 if ddl[i] failed (all of them, if the block itself could not be executed).
+ * */
+int qry_exec_drops(char **ddl, int count, int *failed);
+
+/**
+ * State of object right after its DDL was executed, see qry_exec_ddl().
+ * */
+typedef struct {
+    time_t last_ddl_time; // 0 if object does not exist (e.g. DDL creating it failed)
+    int    valid;         // 1=object is valid (compiled without errors)
+} t_ddl_result;
+
+/**
+ * Execute DDL statement of len bytes (ddl does not need to be null terminated, see tfs_map).
+ * If type (Oracle type) and result are given, new last_ddl_time and status of the object are
+ * returned in result and its errors are written to ddlfs.log, all in a single round trip.
+ * */
+int qry_exec_ddl(char *schema, char *object, const char *ddl, size_t len, const char *type, t_ddl_result *result);
+
+/**
+ * Dependency of one object on another object of the same schema (see qry_dependencies).
+ * Types are Oracle types (e.g. "PACKAGE BODY").
+ * */
+typedef struct {
+    char name[256];
+    char type[30];
+    char referenced_name[256];
+    char referenced_type[30];
+} t_dependency;
+
+/**
+ * Find dependencies (all_dependencies) among objects of schema whose names are given in names
+ * (name_count of them, this array is sorted by this function). *deps is allocated by this function
+ * and must be freed by caller, *count is set to number of dependencies found.
+ * */
+int qry_dependencies(const char *schema, char **names, int name_count, t_dependency **deps, int *count);
+
+/**
+ * Recompile invalid objects of schema (dbms_utility.compile_schema with compile_all=false).
+ * Result is logged to ddlfs.log.
  * */
-int qry_exec_ddl(char *schema, char *object, char *ddl);
+int qry_compile_invalid(const char *schema);
@@ -533,8 +533,10 @@ int qry_object_all_tables(const char *schema,
 
 
 qry_object_all_tables_cleanup:
-    if (fp != NULL && fclose(fp) != 0)
+    if (fp != NULL && fclose(fp) != 0) {
         logmsg(LOG_ERROR, "qry_object_all_tables(): Unable to close [%s]: %d %n", fname, errno, strerror(errno));
+        retval = EXIT_FAILURE;
+    }
 
     if (def != NULL) {
 
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _MSC_VER
+	#include <pthread.h>
+#else
+	#pragma warning(disable:4996)
+#endif
+
+#include "config.h"
+#include "logging.h"
+#include "oracle.h"
+#include "tempfs.h"
+#include "dbro_refresh.h"
+#include "vfs.h"
+#include "util.h"
+#include "compile.h"
+#include "startup.h"
+
+#define ST_CONNECTING 0
+#define ST_VALIDATING 1
+#define ST_READY      2
+#define ST_FAILED     3
+
+static const char *st_state_names[] = { "connecting", "validating", "ready", "failed" };
+
+static struct {
+#ifndef _MSC_VER
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t       thread;
+    int             thread_started;
+#endif
+    int             state;
+    int             connected; // 1=connected, -1=never will be
+    time_t          started;
+    time_t          completed;
+    char            error[256];
+} st = {
+#ifndef _MSC_VER
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+#endif
+    .state = ST_CONNECTING
+};
+
+static void st_set(int state, int connected, const char *error) {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&st.mutex);
+#endif
+    st.state = state;
+    st.connected = connected;
+    if (error != NULL)
+        snprintf(st.error, sizeof(st.error), "%s", error);
+    if (state == ST_READY || state == ST_FAILED)
+        st.completed = time(NULL);
+#ifndef _MSC_VER
+    pthread_cond_broadcast(&st.cond);
+    pthread_mutex_unlock(&st.mutex);
+#endif
+}
+
+// connect, determine whether database is read only and initialize cache directory
+static int st_connect() {
+    if (ora_connect(g_conf.username, g_conf.password, g_conf.database) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "Unable to connect to database.");
+        st_set(ST_FAILED, -1, "unable to connect to database");
+        return EXIT_FAILURE;
+    }
+
+    logmsg(LOG_DEBUG, "is_sysdba=[%d]", g_conf._isdba);
+
+    if (g_conf.dbro == -1) {
+        if (g_conf._isdba == 1) {
+            logmsg(LOG_DEBUG, "neither dbro nor dbrw parameter given, thus trying 'select open_mode from v$database'");
+            g_conf.dbro = ora_get_open_mode();
+            if (g_conf.dbro == -1) {
+                logmsg(LOG_DEBUG, ".. unable to query v$database, assuming the database is opened as read/write");
+                g_conf.dbro = 0;
+            }
+        } else {
+            logmsg(LOG_DEBUG, "assuming database opened as read/write because this user has no (sys)dba privileges (needed to obtain this info).");
+            g_conf.dbro = 0;
+        }
+    }
+    logmsg(LOG_DEBUG, "dbro=[%d]", g_conf.dbro);
+
+    if (tfs_mkdir() != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "Unable to initialize temp directory (%s)", g_conf.temppath);
+        st_set(ST_FAILED, -1, "unable to initialize temp directory");
+        return EXIT_FAILURE;
+    }
+
+    // directory tree of previous mount is served right away, its entries only once validation completes (see st_validated)
+    if (g_conf.dbro == 1) {
+        dbr_refresh_prepare();
+
+        char snapshot_fn[4096];
+        snprintf(snapshot_fn, sizeof(snapshot_fn), "%s%s%s", g_conf._temppath, PATH_SEP, VFS_SNAPSHOT_FILE);
+        vfs_snapshot_load(snapshot_fn, (long long) g_conf._prev_mount_pid, (long long) g_conf._prev_mount_stamp);
+    }
+
+    st_set(ST_VALIDATING, 1, NULL);
+    return EXIT_SUCCESS;
+}
+
+static int st_validate() {
+    // watermark is written for kept cache even if it is new, so that the next mount can use it
+    if (g_conf.dbro != 1 || (g_conf._temppath_reused == 0 && g_conf.keepcache == 0)) {
+        st_set(ST_READY, 1, NULL);
+        return EXIT_SUCCESS;
+    }
+
+    logmsg(LOG_INFO, "Cache validation started because temppath_reused=[%d] and dbro=[%d]", g_conf._temppath_reused, g_conf.dbro);
+
+#ifndef _MSC_VER
+    // requests are served using the main connection meanwhile
+    struct s_connection conn;
+    memset(&conn, 0, sizeof(struct s_connection));
+    if (ora_connect_session(&conn) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "Cache validation failed, unable to connect.");
+        st_set(ST_FAILED, 1, "cache validation failed");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    int retval = dbr_refresh_cache();
+
+#ifndef _MSC_VER
+    ora_disconnect_session(&conn);
+#endif
+
+    if (retval != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "Cache validation failed");
+        st_set(ST_FAILED, 1, "cache validation failed");
+        return EXIT_FAILURE;
+    }
+
+    logmsg(LOG_INFO, "Cache validation completed.");
+    st_set(ST_READY, 1, NULL);
+    return EXIT_SUCCESS;
+}
+
+#ifndef _MSC_VER
+static void* st_thread(void *arg) {
+    if (st_connect() == EXIT_SUCCESS)
+        st_validate();
+    return NULL;
+}
+
+int st_start() {
+    st.started = time(NULL);
+    if (pthread_create(&st.thread, NULL, st_thread, NULL) != 0) {
+        logmsg(LOG_ERROR, "st_start() - unable to start startup thread.");
+        st_set(ST_FAILED, -1, "unable to start startup thread");
+        return EXIT_FAILURE;
+    }
+    st.thread_started = 1;
+    return EXIT_SUCCESS;
+}
+
+void st_stop() {
+    if (st.thread_started == 0)
+        return;
+
+    dbr_refresh_cancel();
+    pthread_join(st.thread, NULL);
+    st.thread_started = 0;
+}
+
+int st_wait() {
+    pthread_mutex_lock(&st.mutex);
+    if (st.connected == 0) {
+        logmsg(LOG_DEBUG, "st_wait() - waiting for database connection.");
+        while (st.connected == 0)
+            pthread_cond_wait(&st.cond, &st.mutex);
+    }
+    int connected = st.connected;
+    pthread_mutex_unlock(&st.mutex);
+
+    return (connected == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int st_connected() {
+    pthread_mutex_lock(&st.mutex);
+    int connected = st.connected;
+    pthread_mutex_unlock(&st.mutex);
+    return (connected == 1 ? 1 : 0);
+}
+
+int st_validated() {
+    pthread_mutex_lock(&st.mutex);
+    int state = st.state;
+    pthread_mutex_unlock(&st.mutex);
+    return (state == ST_READY ? 1 : 0);
+}
+#else
+int st_start() {
+    st.started = time(NULL);
+    if (st_connect() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    return st_validate();
+}
+
+void st_stop() {
+}
+
+int st_wait() {
+    return (st.connected == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int st_connected() {
+    return (st.connected == 1 ? 1 : 0);
+}
+
+int st_validated() {
+    return (st.state == ST_READY ? 1 : 0);
+}
+#endif
+
+size_t st_status(char *buf, size_t size) {
+    int done = 0, total = 0;
+    dbr_progress(&done, &total);
+    int queued = cmp_queued();
+    long long completed = cmp_completed();
+
+#ifndef _MSC_VER
+    pthread_mutex_lock(&st.mutex);
+#endif
+    int len = snprintf(buf, size,
+        "state=%s\nconnected=%d\nvalidated=%d\nto_validate=%d\nelapsed=%lld\ncompile_queue=%d\ncompiled=%lld\nerror=%s\n",
+        st_state_names[st.state],
+        (st.connected == 1 ? 1 : 0),
+        done,
+        total,
+        (long long) ((st.completed != 0 ? st.completed : time(NULL)) - st.started),
+        queued,
+        completed,
+        st.error);
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&st.mutex);
+#endif
+
+    if (len < 0)
+        return 0;
+    return ((size_t) len >= size ? size-1 : (size_t) len);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Mount startup: database connection, cache directory and (with dbro) cache validation.
+ *
+ * On Linux, this is done by a background thread, so that mountpoint is available right away.
+ * Requests which need database wait for the connection (st_wait), while cache validation
+ * continues in background with its own database session. Its progress is reported by special
+ * file ddlfs.status.
+ *
+ * On Windows, all of this is done synchronously before the filesystem is mounted.
+ * */
+
+/**
+ * Start mount startup. On Linux, this must be called after fuse has daemonized the process (fuse init).
+ * On Windows, this returns once startup has completed.
+ * */
+int st_start();
+
+/**
+ * Cancel cache validation (if still in progress) and wait for startup thread to complete.
+ * */
+void st_stop();
+
+/**
+ * Wait until database connection is available.
+ * return EXIT_FAILURE if it never will be (startup failed).
+ * */
+int st_wait();
+
+/**
+ * return 1 if database connection is available, 0 otherwise. This does not wait.
+ * */
+int st_connected();
+
+/**
+ * return 1 if cache validation has completed successfully (or was not needed), 0 otherwise. This does not wait.
+ * Until then, entries of continued mount are not trusted (see tfs_quick_validate).
+ * */
+int st_validated();
+
+/**
+ * Write contents of ddlfs.status (state of startup) to buf, return its length.
+ * */
+size_t st_status(char *buf, size_t size);
@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+	#include <unistd.h>
+	#include <pthread.h>
+#endif
+
+#include "config.h"
+#include "logging.h"
+#include "oracle.h"
+#include "query.h"
+#include "stream.h"
+
+#ifndef _MSC_VER
+
+#define STM_WORKERS_MAX 16
+#define STM_CHUNK (64*1024) // written rows are made available to readers (flushed) at least every this many bytes
+
+typedef enum {
+    STM_QUEUED,
+    STM_FETCHING,
+    STM_DONE,
+    STM_FAILED
+} t_stm_state;
+
+struct s_stm_job {
+    char       *schema;     // filesystem names, as given to qry_object
+    char       *type;
+    char       *object;
+    t_stm_state state;
+    int         refs;       // worker and handles of readers
+    int         fd;         // read-only descriptor of content, -1 until first rows are written
+    char       *staging_fn; // only used by worker
+    off_t       avail;      // bytes of content written so far
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;        // job was queued
+    pthread_cond_t  progress;    // job made progress (or completed)
+    pthread_t      *threads;
+    int             thread_count;
+    int             running;
+    int             idle;        // workers waiting for a job
+    t_stm_job      *queue[STM_WORKERS_MAX];
+    int             queue_count;
+    t_stm_job      *active[STM_WORKERS_MAX]; // queued or being fetched, other opens of the same object join them
+    int             active_count;
+} stm = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER, .progress = PTHREAD_COND_INITIALIZER };
+
+// job fetched by calling thread (stream worker) and content already made available to readers
+static _Thread_local t_stm_job *stm_current = NULL;
+static _Thread_local long stm_published = 0;
+
+// stm.mutex must be held by caller
+static void stm_job_release(t_stm_job *job) {
+    if (--job->refs > 0)
+        return;
+    if (job->fd != -1)
+        close(job->fd);
+    free(job->schema);
+    free(job->type);
+    free(job->object);
+    free(job->staging_fn);
+    free(job);
+}
+
+// stm.mutex must be held by caller
+static void stm_job_finish(t_stm_job *job, t_stm_state state) {
+    job->state = state;
+    for (int i = 0; i < stm.active_count; i++) {
+        if (stm.active[i] == job) {
+            stm.active[i] = stm.active[--stm.active_count];
+            break;
+        }
+    }
+    pthread_cond_broadcast(&stm.progress);
+    stm_job_release(job);
+}
+
+static int stm_fetch(int id, t_stm_job *job) {
+    char *fname = NULL;
+    struct stat st;
+
+    stm_current = job;
+    stm_published = 0;
+    int retval = qry_object(job->schema, job->type, job->object, &fname);
+    stm_current = NULL;
+
+    // nothing was streamed (e.g. cache was up2date or table), complete content is served from cache file
+    if (retval == EXIT_SUCCESS && job->fd == -1) {
+        int fd = open(fname, O_RDONLY);
+        if (fd == -1) {
+            logmsg(LOG_ERROR, "stm_worker(%d) - unable to open [%s]: %d - %s", id, fname, errno, strerror(errno));
+            retval = EXIT_FAILURE;
+        } else {
+            pthread_mutex_lock(&stm.mutex);
+            job->fd = fd;
+            pthread_mutex_unlock(&stm.mutex);
+        }
+    }
+
+    if (retval == EXIT_SUCCESS && fstat(job->fd, &st) != 0) {
+        logmsg(LOG_ERROR, "stm_worker(%d) - unable to stat [%s]: %d - %s", id, fname, errno, strerror(errno));
+        retval = EXIT_FAILURE;
+    }
+
+    pthread_mutex_lock(&stm.mutex);
+    if (retval == EXIT_SUCCESS)
+        job->avail = st.st_size;
+    stm_job_finish(job, (retval == EXIT_SUCCESS ? STM_DONE : STM_FAILED));
+    pthread_mutex_unlock(&stm.mutex);
+
+    free(fname);
+    return retval;
+}
+
+static void* stm_worker(void *arg) {
+    int id = (int) (intptr_t) arg;
+    struct s_connection conn;
+    int connected = 0;
+
+    memset(&conn, 0, sizeof(struct s_connection));
+    logmsg(LOG_DEBUG, "stm_worker(%d) - started.", id);
+
+    pthread_mutex_lock(&stm.mutex);
+    while (stm.running) {
+        if (stm.queue_count == 0) {
+            stm.idle++;
+            pthread_cond_wait(&stm.cond, &stm.mutex);
+            stm.idle--;
+            continue;
+        }
+
+        t_stm_job *job = stm.queue[0];
+        memmove(&stm.queue[0], &stm.queue[1], (--stm.queue_count) * sizeof(t_stm_job*));
+        job->state = STM_FETCHING;
+        pthread_mutex_unlock(&stm.mutex);
+
+        // database session is only opened once there's something to do
+        if (connected == 0 && ora_connect_session(&conn) == EXIT_SUCCESS)
+            connected = 1;
+
+        if (connected == 0) {
+            logmsg(LOG_ERROR, "stm_worker(%d) - unable to connect, [%s].[%s].[%s] is fetched by fuse thread.", id, job->schema, job->type, job->object);
+            pthread_mutex_lock(&stm.mutex);
+            stm_job_finish(job, STM_FAILED);
+            continue;
+        }
+
+        logmsg(LOG_DEBUG, "stm_worker(%d) - fetch [%s].[%s].[%s]", id, job->schema, job->type, job->object);
+        if (stm_fetch(id, job) != EXIT_SUCCESS)
+            logmsg(LOG_ERROR, "stm_worker(%d) - unable to fetch [%s].[%s].[%s]", id, job->schema, job->type, job->object);
+
+        pthread_mutex_lock(&stm.mutex);
+    }
+    pthread_mutex_unlock(&stm.mutex);
+
+    if (connected == 1)
+        ora_disconnect_session(&conn);
+
+    logmsg(LOG_DEBUG, "stm_worker(%d) - stopped.", id);
+    return NULL;
+}
+
+int stm_start() {
+    if (g_conf.stream <= 0)
+        return EXIT_SUCCESS;
+
+    int count = (g_conf.stream > STM_WORKERS_MAX ? STM_WORKERS_MAX : g_conf.stream);
+    stm.threads = calloc(count, sizeof(pthread_t));
+    if (stm.threads == NULL) {
+        logmsg(LOG_ERROR, "stm_start() - unable to allocate memory for %d threads.", count);
+        return EXIT_FAILURE;
+    }
+
+    stm.running = 1;
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&stm.threads[i], NULL, stm_worker, (void*) (intptr_t) i) != 0) {
+            logmsg(LOG_ERROR, "stm_start() - unable to start stream worker %d.", i);
+            break;
+        }
+        stm.thread_count++;
+    }
+
+    logmsg(LOG_INFO, "Started %d stream worker(s).", stm.thread_count);
+    return EXIT_SUCCESS;
+}
+
+void stm_stop() {
+    if (stm.threads == NULL)
+        return;
+
+    pthread_mutex_lock(&stm.mutex);
+    stm.running = 0;
+    while (stm.queue_count > 0)
+        stm_job_finish(stm.queue[--stm.queue_count], STM_FAILED);
+    pthread_cond_broadcast(&stm.cond);
+    pthread_mutex_unlock(&stm.mutex);
+
+    for (int i = 0; i < stm.thread_count; i++)
+        pthread_join(stm.threads[i], NULL);
+
+    free(stm.threads);
+    stm.threads = NULL;
+    stm.thread_count = 0;
+}
+
+int stm_open(const char *schema, const char *type, const char *object, t_stm_job **job) {
+    *job = NULL;
+    if (stm.thread_count == 0)
+        return -1;
+
+    pthread_mutex_lock(&stm.mutex);
+
+    t_stm_job *j = NULL;
+    for (int i = 0; i < stm.active_count && j == NULL; i++)
+        if (strcmp(stm.active[i]->schema, schema) == 0 && strcmp(stm.active[i]->type, type) == 0 && strcmp(stm.active[i]->object, object) == 0)
+            j = stm.active[i];
+
+    if (j == NULL) {
+        // every worker is busy (streaming other objects), caller is faster on its own
+        if (stm.idle <= stm.queue_count || stm.active_count == STM_WORKERS_MAX) {
+            pthread_mutex_unlock(&stm.mutex);
+            return -1;
+        }
+
+        j = calloc(1, sizeof(t_stm_job));
+        if (j == NULL || (j->schema = strdup(schema)) == NULL || (j->type = strdup(type)) == NULL || (j->object = strdup(object)) == NULL) {
+            logmsg(LOG_ERROR, "stm_open() - unable to allocate memory for [%s].[%s].[%s]", schema, type, object);
+            if (j != NULL) {
+                free(j->schema);
+                free(j->type);
+                free(j);
+            }
+            pthread_mutex_unlock(&stm.mutex);
+            return -1;
+        }
+        j->fd = -1;
+        j->state = STM_QUEUED;
+        j->refs = 1; // worker
+        stm.queue[stm.queue_count++] = j;
+        stm.active[stm.active_count++] = j;
+        pthread_cond_signal(&stm.cond);
+    }
+
+    j->refs++;
+    while (j->fd == -1 && (j->state == STM_QUEUED || j->state == STM_FETCHING))
+        pthread_cond_wait(&stm.progress, &stm.mutex);
+
+    int fd = -1;
+    if (j->state != STM_FAILED && (fd = dup(j->fd)) == -1)
+        logmsg(LOG_ERROR, "stm_open() - unable to dup descriptor of [%s].[%s].[%s]: %d - %s", schema, type, object, errno, strerror(errno));
+
+    if (fd == -1 || j->state == STM_DONE)
+        stm_job_release(j);
+    else
+        *job = j;
+
+    pthread_mutex_unlock(&stm.mutex);
+    return fd;
+}
+
+int stm_wait(t_stm_job *job, off_t end) {
+    pthread_mutex_lock(&stm.mutex);
+    while (job->avail < end && (job->state == STM_QUEUED || job->state == STM_FETCHING))
+        pthread_cond_wait(&stm.progress, &stm.mutex);
+    int retval = (job->state == STM_FAILED ? EXIT_FAILURE : EXIT_SUCCESS);
+    pthread_mutex_unlock(&stm.mutex);
+    return retval;
+}
+
+void stm_release(t_stm_job *job) {
+    pthread_mutex_lock(&stm.mutex);
+    stm_job_release(job);
+    pthread_mutex_unlock(&stm.mutex);
+}
+
+void stm_staging(const char *staging_fn) {
+    if (stm_current == NULL)
+        return;
+    free(stm_current->staging_fn);
+    stm_current->staging_fn = strdup(staging_fn);
+}
+
+void stm_progress(FILE *fp) {
+    t_stm_job *job = stm_current;
+    if (job == NULL || job->staging_fn == NULL)
+        return;
+
+    // ftell does not flush, rows are only flushed once there's enough of them
+    long pos = ftell(fp);
+    if (pos <= 0 || (stm_published > 0 && pos - stm_published < STM_CHUNK))
+        return;
+    if (fflush(fp) != 0)
+        return;
+
+    // staging file is renamed (or replaced by dedup) when fetch completes, readers keep this descriptor
+    int fd = -1;
+    if (job->fd == -1 && (fd = open(job->staging_fn, O_RDONLY)) == -1) {
+        logmsg(LOG_ERROR, "stm_progress() - unable to open [%s]: %d - %s", job->staging_fn, errno, strerror(errno));
+        return;
+    }
+
+    pthread_mutex_lock(&stm.mutex);
+    if (fd != -1)
+        job->fd = fd;
+    job->avail = (off_t) pos;
+    pthread_cond_broadcast(&stm.progress);
+    pthread_mutex_unlock(&stm.mutex);
+    stm_published = pos;
+}
+
+#else
+
+int stm_start() {
+    return EXIT_SUCCESS;
+}
+
+void stm_stop() {
+}
+
+int stm_open(const char *schema, const char *type, const char *object, t_stm_job **job) {
+    *job = NULL;
+    return -1;
+}
+
+int stm_wait(t_stm_job *job, off_t end) {
+    return EXIT_SUCCESS;
+}
+
+void stm_release(t_stm_job *job) {
+}
+
+void stm_staging(const char *staging_fn) {
+}
+
+void stm_progress(FILE *fp) {
+}
+
+#endif
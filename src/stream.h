@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * Progressive materialization of objects opened for reading (see stream= parameter).
+ *
+ * Object is fetched into local cache by a background worker (with its own database session),
+ * while fs_open returns as soon as the first rows are written. fs_read then only waits until
+ * the requested range is written (or the fetch completes). Cache file is committed exactly as
+ * it would be by qry_object, so st_size is final once the fetch completes.
+ * If no worker is free, caller fetches the object itself (as if streaming was disabled).
+ *
+ * Not available on Windows, where stm_open always fails.
+ * */
+
+typedef struct s_stm_job t_stm_job;
+
+/**
+ * Start worker threads. Must be called after fuse has daemonized the process (fuse init).
+ * */
+int stm_start();
+
+/**
+ * Stop worker threads (fetches in progress are completed first) and close their database sessions.
+ * */
+void stm_stop();
+
+/**
+ * Materialize object (filesystem names, like qry_object) in background and return read-only file
+ * descriptor of its content once first rows are written (or once the object is validated in cache).
+ * *job is set if fetch is still in progress, it must be passed to stm_wait before reading and
+ * released with stm_release. Returns -1 if object cannot be streamed, caller should use qry_object.
+ * */
+int stm_open(const char *schema, const char *type, const char *object, t_stm_job **job);
+
+/**
+ * Wait until first end bytes of content are written or fetch completes, whichever comes first.
+ * */
+int stm_wait(t_stm_job *job, off_t end);
+
+void stm_release(t_stm_job *job);
+
+/**
+ * Called by qry_object just before object is fetched into staging_fn and by qry_object_all_source
+ * after rows (or pieces of view text, see t_ora_piecewise) were written to fp. These do nothing,
+ * unless called from stream worker.
+ * */
+void stm_staging(const char *staging_fn);
+void stm_progress(FILE *fp);
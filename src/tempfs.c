@@ -11,9 +11,14 @@
 	#include <unistd.h>
 	#include <sys/xattr.h>
 	#include <dirent.h>
+	#include <utime.h>
+	#include <pthread.h>
+	#include <sys/wait.h>
+	#include <sys/mman.h>
 #else
 	#include <windows.h>
 	#include <io.h>
+	#include <sys/utime.h>
 	#pragma warning(disable:4996)
 	#define strdup _strdup
 	#define pid_t int
@@ -23,6 +28,27 @@
 #include "config.h"
 #include "logging.h"
 #include "util.h"
+#include "tempfs.h"
+#include "startup.h"
+
+#define TFS_LOCK_STRIPES 4096
+#define TFS_MUTEX_STRIPES 64 // must divide TFS_LOCK_STRIPES
+#define TFS_BUF_SIZE 65536
+
+// lock file (ddlfs.lck in cache directory), its bytes are used as lock stripes by tfs_lock()
+#ifndef _MSC_VER
+static int tfs_lock_fd = -1;
+
+// fcntl locks are owned by process, so threads of this process are serialized by mutexes (prefetch workers).
+// Entries sharing lock file byte always share the mutex as well.
+static pthread_mutex_t tfs_mutex[TFS_MUTEX_STRIPES];
+static pthread_once_t tfs_mutex_once = PTHREAD_ONCE_INIT;
+#else
+static HANDLE tfs_lock_fd = INVALID_HANDLE_VALUE;
+#endif
+
+// content addressed store (ddlfs-cas.<uid> in temppath), empty if dedup=0
+static char tfs_cas_path[2048] = "";
 
 
 /**
@@ -50,6 +76,325 @@ static int tfs_getldt_fn(const char *cache_fn, char **meta_fn) {
 }
 
 
+// lock stripe for cache_fn, only file name is used because temppath may be spelled differently by other processes
+static long tfs_lock_stripe(const char *cache_fn) {
+    const char *base = strrchr(cache_fn, PATH_SEP[0]);
+    base = (base == NULL ? cache_fn : base + 1);
+    return (long) (utl_hash(base, strlen(base), UTL_HASH_INIT) % TFS_LOCK_STRIPES);
+}
+
+#ifndef _MSC_VER
+static int tfs_lock_open(const char *lock_fn) {
+    tfs_lock_fd = open(lock_fn, O_RDWR | O_CREAT, 0600);
+    if (tfs_lock_fd == -1) {
+        logmsg(LOG_ERROR, "tfs_lock_open - unable to open lock file [%s]: %d - %s", lock_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void tfs_mutex_init() {
+    for (int i = 0; i < TFS_MUTEX_STRIPES; i++)
+        pthread_mutex_init(&tfs_mutex[i], NULL);
+}
+
+static int tfs_lock_set(const char *cache_fn, short type) {
+    if (tfs_lock_fd == -1)
+        return EXIT_SUCCESS; // cache is not shared
+
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = tfs_lock_stripe(cache_fn);
+    fl.l_len = 1;
+
+    while (fcntl(tfs_lock_fd, F_SETLKW, &fl) == -1) {
+        if (errno == EINTR)
+            continue;
+        logmsg(LOG_ERROR, "tfs_lock - unable to (un)lock [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int tfs_lock(const char *cache_fn) {
+    pthread_once(&tfs_mutex_once, tfs_mutex_init);
+    pthread_mutex_lock(&tfs_mutex[tfs_lock_stripe(cache_fn) % TFS_MUTEX_STRIPES]);
+    return tfs_lock_set(cache_fn, F_WRLCK);
+}
+
+int tfs_unlock(const char *cache_fn) {
+    int retval = tfs_lock_set(cache_fn, F_UNLCK);
+    pthread_mutex_unlock(&tfs_mutex[tfs_lock_stripe(cache_fn) % TFS_MUTEX_STRIPES]);
+    return retval;
+}
+#else
+static int tfs_lock_open(const char *lock_fn) {
+    tfs_lock_fd = CreateFileA(lock_fn, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (tfs_lock_fd == INVALID_HANDLE_VALUE) {
+        logmsg(LOG_ERROR, "tfs_lock_open - unable to open lock file [%s], error=%lu", lock_fn, GetLastError());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int tfs_lock(const char *cache_fn) {
+    if (tfs_lock_fd == INVALID_HANDLE_VALUE)
+        return EXIT_SUCCESS; // cache is not shared
+
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = (DWORD) tfs_lock_stripe(cache_fn);
+    if (!LockFileEx(tfs_lock_fd, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) {
+        logmsg(LOG_ERROR, "tfs_lock - unable to lock [%s], error=%lu", cache_fn, GetLastError());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int tfs_unlock(const char *cache_fn) {
+    if (tfs_lock_fd == INVALID_HANDLE_VALUE)
+        return EXIT_SUCCESS;
+
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = (DWORD) tfs_lock_stripe(cache_fn);
+    if (!UnlockFileEx(tfs_lock_fd, 0, 1, 0, &overlapped)) {
+        logmsg(LOG_ERROR, "tfs_unlock - unable to unlock [%s], error=%lu", cache_fn, GetLastError());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+#endif
+
+int tfs_staging_fn(const char *cache_fn, char *staging_fn, size_t staging_len) {
+    int len = snprintf(staging_fn, staging_len, "%s.%d.new", cache_fn, (int) g_conf._mount_pid);
+    if (len < 0 || (size_t) len >= staging_len) {
+        logmsg(LOG_ERROR, "tfs_staging_fn - staging file name for [%s] is too long", cache_fn);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int tfs_commit(const char *staging_fn, const char *cache_fn) {
+#ifndef _MSC_VER
+    if (rename(staging_fn, cache_fn) != 0) {
+        logmsg(LOG_ERROR, "tfs_commit - unable to rename [%s] to [%s]: %d - %s", staging_fn, cache_fn, errno, strerror(errno));
+        unlink(staging_fn);
+        return EXIT_FAILURE;
+    }
+#else
+    if (!MoveFileExA(staging_fn, cache_fn, MOVEFILE_REPLACE_EXISTING)) {
+        logmsg(LOG_ERROR, "tfs_commit - unable to move [%s] to [%s], error=%lu", staging_fn, cache_fn, GetLastError());
+        DeleteFileA(staging_fn);
+        return EXIT_FAILURE;
+    }
+#endif
+    return EXIT_SUCCESS;
+}
+
+// compute content hash of file fname, size is optional output parameter
+static int tfs_file_hash(const char *fname, uint64_t *content_hash, long long *size) {
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL) {
+        logmsg(LOG_ERROR, "tfs_file_hash - unable to open [%s]: %d - %s", fname, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    char buf[TFS_BUF_SIZE];
+    size_t len;
+    long long total = 0;
+    *content_hash = UTL_HASH_INIT;
+    while ((len = fread(buf, 1, TFS_BUF_SIZE, fp)) > 0) {
+        *content_hash = utl_hash(buf, len, *content_hash);
+        total += (long long) len;
+    }
+
+    if (ferror(fp) != 0) {
+        logmsg(LOG_ERROR, "tfs_file_hash - unable to read [%s]", fname);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    fclose(fp);
+
+    if (size != NULL)
+        *size = total;
+    return EXIT_SUCCESS;
+}
+
+#ifndef _MSC_VER
+// return 1 if files fn1 and fn2 have exactly the same content and 0 otherwise (or on error)
+static int tfs_same_content(const char *fn1, const char *fn2) {
+    FILE *fp1 = fopen(fn1, "rb");
+    FILE *fp2 = fopen(fn2, "rb");
+    int retval = (fp1 != NULL && fp2 != NULL);
+
+    char buf1[TFS_BUF_SIZE], buf2[TFS_BUF_SIZE];
+    while (retval == 1) {
+        size_t len1 = fread(buf1, 1, TFS_BUF_SIZE, fp1);
+        size_t len2 = fread(buf2, 1, TFS_BUF_SIZE, fp2);
+        if (len1 != len2 || memcmp(buf1, buf2, len1) != 0 || ferror(fp1) || ferror(fp2))
+            retval = 0;
+        else if (len1 == 0)
+            break;
+    }
+
+    if (fp1 != NULL)
+        fclose(fp1);
+    if (fp2 != NULL)
+        fclose(fp2);
+    return retval;
+}
+
+int tfs_dedup(const char *staging_fn, uint64_t *content_hash) {
+    long long size = 0;
+    if (tfs_file_hash(staging_fn, content_hash, &size) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    if (tfs_cas_path[0] == '\0')
+        return EXIT_SUCCESS; // dedup=0
+
+    char blob_fn[4096];
+    snprintf(blob_fn, 4096, "%s/%016llx.%lld", tfs_cas_path, (unsigned long long) *content_hash, size);
+
+    // first copy of this content simply becomes the blob
+    if (link(staging_fn, blob_fn) == 0)
+        return EXIT_SUCCESS;
+
+    if (errno != EEXIST) {
+        // e.g. EXDEV if cas folder is on another filesystem; keep private copy, which is perfectly valid
+        logmsg(LOG_DEBUG, "tfs_dedup - unable to link [%s] to [%s]: %d - %s", staging_fn, blob_fn, errno, strerror(errno));
+        return EXIT_SUCCESS;
+    }
+
+    // equal hash does not guarantee equal content
+    if (tfs_same_content(staging_fn, blob_fn) != 1) {
+        logmsg(LOG_DEBUG, "tfs_dedup - [%s] differs from [%s], keeping private copy", staging_fn, blob_fn);
+        return EXIT_SUCCESS;
+    }
+
+    // replace staging file with another link to existing blob
+    char link_fn[4096];
+    snprintf(link_fn, 4096, "%s.lnk", staging_fn);
+    unlink(link_fn);
+    if (link(blob_fn, link_fn) != 0) {
+        logmsg(LOG_DEBUG, "tfs_dedup - unable to link [%s] to [%s]: %d - %s", blob_fn, link_fn, errno, strerror(errno));
+        return EXIT_SUCCESS;
+    }
+    if (rename(link_fn, staging_fn) != 0) {
+        logmsg(LOG_ERROR, "tfs_dedup - unable to rename [%s] to [%s]: %d - %s", link_fn, staging_fn, errno, strerror(errno));
+        unlink(link_fn);
+        return EXIT_SUCCESS;
+    }
+
+    logmsg(LOG_DEBUG, "tfs_dedup - [%s] is shared with [%s]", staging_fn, blob_fn);
+    return EXIT_SUCCESS;
+}
+
+int tfs_unshare(const char *cache_fn) {
+    struct stat st;
+    if (stat(cache_fn, &st) != 0) {
+        if (errno == ENOENT)
+            return EXIT_SUCCESS;
+        logmsg(LOG_ERROR, "tfs_unshare - unable to stat [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (st.st_nlink < 2)
+        return EXIT_SUCCESS; // not shared with anybody (anymore)
+
+    char staging_fn[4096];
+    if (tfs_staging_fn(cache_fn, staging_fn, 4096) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    FILE *src = fopen(cache_fn, "rb");
+    FILE *dst = fopen(staging_fn, "wb");
+    if (src == NULL || dst == NULL) {
+        logmsg(LOG_ERROR, "tfs_unshare - unable to copy [%s] to [%s]: %d - %s", cache_fn, staging_fn, errno, strerror(errno));
+        if (src != NULL)
+            fclose(src);
+        if (dst != NULL)
+            fclose(dst);
+        return EXIT_FAILURE;
+    }
+
+    char buf[TFS_BUF_SIZE];
+    size_t len;
+    int retval = EXIT_SUCCESS;
+    while ((len = fread(buf, 1, TFS_BUF_SIZE, src)) > 0) {
+        if (fwrite(buf, 1, len, dst) != len) {
+            retval = EXIT_FAILURE;
+            break;
+        }
+    }
+    if (ferror(src) != 0)
+        retval = EXIT_FAILURE;
+    fclose(src);
+    if (fclose(dst) != 0)
+        retval = EXIT_FAILURE;
+
+    if (retval != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "tfs_unshare - unable to copy [%s] to [%s]", cache_fn, staging_fn);
+        unlink(staging_fn);
+        return EXIT_FAILURE;
+    }
+
+    // private copy must look unmodified, see qry_object()
+    struct utimbuf newtime;
+    newtime.actime = st.st_atime;
+    newtime.modtime = st.st_mtime;
+    if (utime(staging_fn, &newtime) != 0 || chmod(staging_fn, st.st_mode & 07777) != 0) {
+        logmsg(LOG_ERROR, "tfs_unshare - unable to copy attributes of [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        unlink(staging_fn);
+        return EXIT_FAILURE;
+    }
+
+    logmsg(LOG_DEBUG, "tfs_unshare - [%s] got private copy", cache_fn);
+    return tfs_commit(staging_fn, cache_fn);
+}
+
+// remove blobs which are not referenced by any cache file anymore (link count dropped to 1)
+static void tfs_cas_gc() {
+    if (tfs_cas_path[0] == '\0')
+        return;
+
+    DIR *dir = opendir(tfs_cas_path);
+    if (dir == NULL) {
+        logmsg(LOG_ERROR, "tfs_cas_gc - unable to open directory [%s]: %d %s", tfs_cas_path, errno, strerror(errno));
+        return;
+    }
+
+    char blob_fn[4096];
+    struct dirent *ent;
+    struct stat st;
+    int removed = 0;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.')
+            continue;
+
+        snprintf(blob_fn, 4096, "%s/%s", tfs_cas_path, ent->d_name);
+        if (stat(blob_fn, &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink == 1) {
+            if (unlink(blob_fn) == 0)
+                removed++;
+        }
+    }
+    closedir(dir);
+
+    logmsg(LOG_DEBUG, "tfs_cas_gc - removed %d unreferenced blob(s) from [%s]", removed, tfs_cas_path);
+}
+#else
+int tfs_dedup(const char *staging_fn, uint64_t *content_hash) {
+    // no hard links here, content hash is still recorded in meta file
+    return tfs_file_hash(staging_fn, content_hash, NULL);
+}
+
+int tfs_unshare(const char *cache_fn) {
+    return EXIT_SUCCESS;
+}
+#endif
+
 static inline int tfs_fwrite(const void *ptr, size_t size, FILE *stream) {
     size_t len = fwrite(ptr, 1, size, stream);
     if (len != size) {
@@ -60,14 +405,14 @@ static inline int tfs_fwrite(const void *ptr, size_t size, FILE *stream) {
     return EXIT_SUCCESS;
 }
 
-int tfs_setldt(const char *path, time_t last_ddl_time) {
+int tfs_setmeta(const char *path, const t_tfs_meta *meta) {
     // I have considered saving last_ddl_time as user extended attribute of file on filesystems which supports this
     // (most do, but not all of them). Problem with this approach is that even if fs supports this feature, it may
     // be disabled at kernel level or at mount time (fs opts). So.. I decided not to rely on such feature.
 
     char *meta_fn = NULL;
     if (tfs_getldt_fn(path, &meta_fn) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "tfs_setldf - unable to determine meta file for cache file [%s]", path);
+        logmsg(LOG_ERROR, "tfs_setmeta - unable to determine meta file for cache file [%s]", path);
         if (meta_fn != NULL)
             free(meta_fn);
         return EXIT_FAILURE;
@@ -75,28 +420,22 @@ int tfs_setldt(const char *path, time_t last_ddl_time) {
 
     FILE *fp = fopen(meta_fn, "w");
     if (fp == NULL) {
-        logmsg(LOG_ERROR, "tfs_setldf - unable to open meta file [%s]: %d - %s", meta_fn, errno, strerror(errno));
-        free(meta_fn);
-        return EXIT_FAILURE;
-    }
-
-    if (tfs_fwrite(&last_ddl_time, sizeof(time_t), fp) != EXIT_SUCCESS) {
-        free(meta_fn);
-        return EXIT_FAILURE;
-    }
-
-    if (tfs_fwrite(&g_conf._mount_pid, sizeof(pid_t), fp) != EXIT_SUCCESS) {
+        logmsg(LOG_ERROR, "tfs_setmeta - unable to open meta file [%s]: %d - %s", meta_fn, errno, strerror(errno));
         free(meta_fn);
         return EXIT_FAILURE;
     }
 
-    if (tfs_fwrite(&g_conf._mount_stamp, sizeof(time_t), fp) != EXIT_SUCCESS) {
+    if (tfs_fwrite(&meta->last_ddl_time, sizeof(time_t), fp) != EXIT_SUCCESS ||
+        tfs_fwrite(&g_conf._mount_pid, sizeof(pid_t), fp) != EXIT_SUCCESS ||
+        tfs_fwrite(&g_conf._mount_stamp, sizeof(time_t), fp) != EXIT_SUCCESS ||
+        tfs_fwrite(&meta->content_hash, sizeof(uint64_t), fp) != EXIT_SUCCESS ||
+        tfs_fwrite(&meta->validity, sizeof(int), fp) != EXIT_SUCCESS) {
         free(meta_fn);
         return EXIT_FAILURE;
     }
 
     if (fclose(fp) != 0) {
-        logmsg(LOG_ERROR, "tfs_setldf - unable to close meta file [%s]", meta_fn);
+        logmsg(LOG_ERROR, "tfs_setmeta - unable to close meta file [%s]", meta_fn);
         free(meta_fn);
         return EXIT_FAILURE;
     }
@@ -105,11 +444,26 @@ int tfs_setldt(const char *path, time_t last_ddl_time) {
     return EXIT_SUCCESS;
 }
 
-int tfs_getldt(const char *path, time_t *last_ddl_time, pid_t *mount_pid, time_t *mount_stamp) {
+// read one field from meta file, return EXIT_FAILURE on short read
+static int tfs_fread(void *ptr, size_t size, FILE *stream, const char *meta_fn, int field) {
+    size_t len = fread(ptr, 1, size, stream);
+    if (len != size) {
+        logmsg(LOG_ERROR, "tfs_getmeta - unable to read meta file [%s], field %d, got [%d] bytes, expected [%d]", meta_fn, field, len, size);
+        if (ferror(stream) != 0) {
+            logmsg(LOG_ERROR, "tfs_getmeta - .. ERROR");
+        }  else {
+            logmsg(LOG_ERROR, "tfs_getmeta - .. EOF");
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int tfs_getmeta(const char *path, t_tfs_meta *meta) {
 
     char *meta_fn = NULL;
     if (tfs_getldt_fn(path, &meta_fn) != EXIT_SUCCESS) {
-        logmsg(LOG_ERROR, "tfs_getldf - unable to determine meta file for cache file [%s]", path);
+        logmsg(LOG_ERROR, "tfs_getmeta - unable to determine meta file for cache file [%s]", path);
         if (meta_fn != NULL)
             free(meta_fn);
         return EXIT_FAILURE;
@@ -117,54 +471,28 @@ int tfs_getldt(const char *path, time_t *last_ddl_time, pid_t *mount_pid, time_t
         
     FILE *fp = fopen(meta_fn, "r");
     if (fp == NULL) {
-        logmsg(LOG_ERROR, "tfs_getldf - unable to open meta file [%s]: %d - %s", meta_fn, errno, strerror(errno));
+        logmsg(LOG_ERROR, "tfs_getmeta - unable to open meta file [%s]: %d - %s", meta_fn, errno, strerror(errno));
         free(meta_fn);
         return EXIT_FAILURE;
     }
 
-    size_t len = fread(last_ddl_time, 1, sizeof(time_t), fp);
-    if (len != sizeof(time_t)) {
-        logmsg(LOG_ERROR, "tfs_getldf - unable to read meta file [%s], field 1,  got [%d] bytes, expected [%d]", meta_fn, len, sizeof(time_t));
-        if (ferror(fp) != 0) {
-            logmsg(LOG_ERROR, "tfs_getldf - .. ERROR");
-        }  else {
-            logmsg(LOG_ERROR, "tfs_getldf - .. EOF");
-        }
+    if (tfs_fread(&meta->last_ddl_time, sizeof(time_t), fp, meta_fn, 1) != EXIT_SUCCESS ||
+        tfs_fread(&meta->mount_pid, sizeof(pid_t), fp, meta_fn, 2) != EXIT_SUCCESS ||
+        tfs_fread(&meta->mount_stamp, sizeof(time_t), fp, meta_fn, 3) != EXIT_SUCCESS) {
         fclose(fp);
         free(meta_fn);
         return EXIT_FAILURE;
-    }    
-
-    if (mount_pid != NULL && mount_stamp != NULL) {
-        len = fread(mount_pid, 1, sizeof(pid_t), fp);
-        if (len != sizeof(pid_t)) {
-            logmsg(LOG_ERROR, "tfs_getldf - unable to read meta file [%s], field 2, got [%d] bytes, expected [%d]", meta_fn, len, sizeof(pid_t));
-            if (ferror(fp) != 0) {
-                logmsg(LOG_ERROR, "tfs_getldf - .. ERROR");
-            }  else {
-                logmsg(LOG_ERROR, "tfs_getldf - .. EOF");
-            }
-            fclose(fp);
-            free(meta_fn);
-            return EXIT_FAILURE;
-        }
+    }
 
-        len = fread(mount_stamp, 1, sizeof(time_t), fp);
-        if (len != sizeof(time_t)) {
-            logmsg(LOG_ERROR, "tfs_getldf - unable to read meta file [%s], field 3, got [%d] bytes, expected [%d]", meta_fn, len, sizeof(time_t));
-            if (ferror(fp) != 0) {
-                logmsg(LOG_ERROR, "tfs_getldf - .. ERROR");
-            }  else {
-                logmsg(LOG_ERROR, "tfs_getldf - .. EOF");
-            }
-            fclose(fp);
-            free(meta_fn);
-            return EXIT_FAILURE;
-        }
+    // meta files written by older versions of ddlfs end here
+    if (fread(&meta->content_hash, 1, sizeof(uint64_t), fp) != sizeof(uint64_t) ||
+        fread(&meta->validity, 1, sizeof(int), fp) != sizeof(int)) {
+        meta->content_hash = 0;
+        meta->validity = -1;
     }
 
     if (fclose(fp) != 0) {
-        logmsg(LOG_ERROR, "tfs_getldf - unable to close meta file [%s]", meta_fn);
+        logmsg(LOG_ERROR, "tfs_getmeta - unable to close meta file [%s]", meta_fn);
         free(meta_fn);
         return EXIT_FAILURE;
     }
@@ -173,6 +501,134 @@ int tfs_getldt(const char *path, time_t *last_ddl_time, pid_t *mount_pid, time_t
     return EXIT_SUCCESS;
 }
 
+int tfs_setldt(const char *path, time_t last_ddl_time) {
+    t_tfs_meta meta;
+
+    // keep content hash and validity of existing entry (if any)
+    if (access(path, F_OK) == -1 || tfs_getmeta(path, &meta) != EXIT_SUCCESS) {
+        meta.content_hash = 0;
+        meta.validity = -1;
+    }
+    meta.last_ddl_time = last_ddl_time;
+
+    return tfs_setmeta(path, &meta);
+}
+
+int tfs_getldt(const char *path, time_t *last_ddl_time, pid_t *mount_pid, time_t *mount_stamp) {
+    t_tfs_meta meta;
+
+    if (tfs_getmeta(path, &meta) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    *last_ddl_time = meta.last_ddl_time;
+    if (mount_pid != NULL)
+        *mount_pid = meta.mount_pid;
+    if (mount_stamp != NULL)
+        *mount_stamp = meta.mount_stamp;
+
+    return EXIT_SUCCESS;
+}
+
+int tfs_revalidate(const char *cache_fn, time_t last_ddl_time, int discard) {
+    t_tfs_meta meta;
+    int retval = EXIT_SUCCESS;
+
+    if (access(cache_fn, F_OK) == -1)
+        return EXIT_FAILURE;
+
+    // entry may be (re)written by request served meanwhile (validation runs in background)
+    tfs_lock(cache_fn);
+    if (tfs_getmeta(cache_fn, &meta) != EXIT_SUCCESS || meta.last_ddl_time != last_ddl_time) {
+        if (discard == 1)
+            tfs_rmfile(cache_fn);
+        retval = EXIT_FAILURE;
+    } else if (meta.mount_pid != g_conf._mount_pid || meta.mount_stamp != g_conf._mount_stamp) {
+        // not yet verified by this mount
+        retval = tfs_setmeta(cache_fn, &meta);
+    }
+    tfs_unlock(cache_fn);
+
+    return retval;
+}
+
+int tfs_unchanged(const char *cache_fn) {
+    t_tfs_meta meta;
+    if (tfs_getmeta(cache_fn, &meta) != EXIT_SUCCESS || meta.content_hash == 0)
+        return EXIT_FAILURE;
+
+    uint64_t content_hash;
+    if (tfs_file_hash(cache_fn, &content_hash, NULL) != EXIT_SUCCESS || content_hash != meta.content_hash)
+        return EXIT_FAILURE;
+
+    // file is not modified anymore, see qry_object()
+    struct utimbuf newtime;
+    newtime.actime = time(NULL);
+    newtime.modtime = 0;
+    if (utime(cache_fn, &newtime) != 0)
+        logmsg(LOG_ERROR, "tfs_unchanged - unable to reset modification time of [%s]: %d - %s", cache_fn, errno, strerror(errno));
+
+    return EXIT_SUCCESS;
+}
+
+int tfs_map(const char *cache_fn, const char **data, size_t *len) {
+    *data = NULL;
+    *len = 0;
+
+#ifndef _MSC_VER
+    int fd = open(cache_fn, O_RDONLY);
+#else
+    int fd = open(cache_fn, O_RDONLY | O_BINARY);
+#endif
+    if (fd == -1) {
+        logmsg(LOG_ERROR, "tfs_map - unable to open [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        logmsg(LOG_ERROR, "tfs_map - unable to stat [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return EXIT_SUCCESS;
+    }
+
+#ifndef _MSC_VER
+    void *addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        logmsg(LOG_ERROR, "tfs_map - unable to map [%s]: %d - %s", cache_fn, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+#else
+    char *addr = malloc((size_t) st.st_size);
+    if (addr == NULL || read(fd, addr, (unsigned int) st.st_size) != (int) st.st_size) {
+        logmsg(LOG_ERROR, "tfs_map - unable to read [%s]", cache_fn);
+        free(addr);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+#endif
+
+    *data = (const char*) addr;
+    *len = (size_t) st.st_size;
+    return EXIT_SUCCESS;
+}
+
+void tfs_unmap(const char *data, size_t len) {
+    if (data == NULL)
+        return;
+#ifndef _MSC_VER
+    munmap((void*) data, len);
+#else
+    free((void*) data);
+#endif
+}
+
 int tfs_rmfile(const char *cache_fn) {
 
     int retval = EXIT_SUCCESS;
@@ -230,7 +686,10 @@ int tfs_quick_validate(const char *path) {
         return EXIT_FAILURE;
     }
 
-    if (mount_pid == g_conf._mount_pid && mount_stamp == g_conf._mount_stamp) {
+    // verified by this mount or by the one it continues (see dbr_refresh_prepare), but only once entries
+    // changed since then were revalidated, until then last_ddl_time is checked
+    if ((mount_pid == g_conf._mount_pid && mount_stamp == g_conf._mount_stamp) ||
+        (st_validated() == 1 && mount_pid == g_conf._prev_mount_pid && mount_stamp == g_conf._prev_mount_stamp && mount_pid != 0)) {
         logmsg(LOG_DEBUG, "tfs_quick_validate() - validated [%s]", meta_fn);
         free(meta_fn);
         return EXIT_SUCCESS;
@@ -275,99 +734,181 @@ int tfs_validate(const char *cache_fn, char *last_ddl_time, time_t *actual_time)
     return tfs_validate2(cache_fn, *actual_time);
 }
 
-// return 1 if haystack ends with suffix and 0 otherwise.
-static int tfs_strend(const char *haystack, const char *suffix) {
-    if (strlen(haystack) <= strlen(suffix))
-        return 0;
-
-    if (strcmp(haystack + strlen(haystack) + strlen(haystack) - strlen(suffix), suffix))
-        return 1;
+// cache directory is renamed to "<name>.trash.<pid>.<seq>" and removed in background, see tfs_rmdir
+#define TFS_TRASH_INFIX ".trash."
+static unsigned int tfs_trash_seq = 0;
 
-    return 0;
+// atomically move directory dir_path out of the way, so that it can be removed without anyone waiting for it.
+static int tfs_trash(const char *dir_path, char *trash_path, size_t trash_len, int ignoreNoDir) {
+#ifndef _MSC_VER
+    snprintf(trash_path, trash_len, "%s%s%d.%u", dir_path, TFS_TRASH_INFIX, (int) getpid(), tfs_trash_seq++);
+    if (rename(dir_path, trash_path) != 0) {
+        if (ignoreNoDir != 1 || errno != ENOENT)
+            logmsg(LOG_ERROR, "tfs_trash - unable to rename [%s] to [%s]: %d - %s", dir_path, trash_path, errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+#else
+    snprintf(trash_path, trash_len, "%s%s%lu.%u", dir_path, TFS_TRASH_INFIX, GetCurrentProcessId(), tfs_trash_seq++);
+    if (!MoveFileA(dir_path, trash_path)) {
+        if (ignoreNoDir != 1 || GetLastError() != ERROR_FILE_NOT_FOUND)
+            logmsg(LOG_ERROR, "tfs_trash - unable to rename [%s] to [%s], error=%lu", dir_path, trash_path, GetLastError());
+        return EXIT_FAILURE;
+    }
+#endif
+    logmsg(LOG_DEBUG, "tfs_trash - moved [%s] to [%s]", dir_path, trash_path);
+    return EXIT_SUCCESS;
 }
 
 #ifndef _MSC_VER
-int tfs_rmdir(int ignoreNoDir) {
-
-    // remove files in directory
+// remove directory with all of its files (cache directory has no subdirectories).
+// Another process may be removing the same (trash) directory, so missing files are ignored.
+static int tfs_rmtree(const char *dir_path) {
     DIR *dir;
     struct dirent *ent;
-    if ((dir = opendir (g_conf._temppath)) == NULL) {
-        if (ignoreNoDir != 1 || errno != ENOENT)
-            logmsg(LOG_ERROR, "tfs_rmdir - unable to open directory [%s]: %d %s", g_conf._temppath, errno, strerror(errno));
+    if ((dir = opendir(dir_path)) == NULL) {
+        if (errno == ENOENT)
+            return EXIT_SUCCESS;
+        logmsg(LOG_ERROR, "tfs_rmtree - unable to open directory [%s]: %d %s", dir_path, errno, strerror(errno));
         return EXIT_FAILURE;
     }
 
-    char temppath[8192];
-    while ((ent = readdir (dir)) != NULL) {
-        if (strlen(g_conf._temppath) + strlen(ent->d_name) > 8190) {
-            logmsg(LOG_ERROR, "tfs_rmdir - unable to remove file because name too long (8k) [%s]", ent->d_name);
+    char file_path[8192];
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+
+        if (snprintf(file_path, sizeof(file_path), "%s/%s", dir_path, ent->d_name) >= (int) sizeof(file_path)) {
+            logmsg(LOG_ERROR, "tfs_rmtree - unable to remove file because name too long (8k) [%s]", ent->d_name);
             continue;
         }
-        strcpy(temppath, g_conf._temppath);
-        strcat(temppath, "/");
-        strcat(temppath, ent->d_name);
-
-        if ( (tfs_strend(ent->d_name, ".tmp")) || (tfs_strend(ent->d_name, ".dfs")) ) {
-            if (unlink(temppath) != 0) {
-                logmsg(LOG_ERROR, "tfs_rmdir - unable to delete file [%s]: %d - %s", temppath, errno, strerror(errno));
-                continue;
-            }
-        }
-    }
 
+        if (unlink(file_path) != 0 && errno != ENOENT)
+            logmsg(LOG_ERROR, "tfs_rmtree - unable to delete file [%s]: %d - %s", file_path, errno, strerror(errno));
+    }
     closedir(dir);
 
-    // remove empty directory
-    if (rmdir(g_conf._temppath) != 0) {
-        logmsg(LOG_ERROR, "tfs_rmdir - unable to delete directory (%s): %d - %s", g_conf._temppath, errno, strerror(errno));
+    if (rmdir(dir_path) != 0 && errno != ENOENT) {
+        logmsg(LOG_ERROR, "tfs_rmtree - unable to delete directory (%s): %d - %s", dir_path, errno, strerror(errno));
         return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
 }
-#else
-int tfs_rmdir(int ignoreNoDir) {
-    if (_access(g_conf._temppath, 0 != 0)) {
-        logmsg(LOG_DEBUG, "tfs_rmdir, folder [%s] does not exist (which is OK).", g_conf._temppath);
-        return EXIT_SUCCESS; // it's ok if temppath already does not exist, we've intended to delete it using this function anyway.
-    }
 
-    char abs_path[4096];
-    snprintf(abs_path, 4096, "%s%s*", g_conf._temppath, PATH_SEP);    
-    WIN32_FIND_DATA find_data;
-    HANDLE find_handle = FindFirstFileA(abs_path, &find_data);    
-	    
-    if (find_handle == INVALID_HANDLE_VALUE) {
-        logmsg(LOG_ERROR, "tfs_rmdir - FindFirstFileA has failed to open [%s], error=%lu", abs_path, GetLastError());
+// remove trash directory by detached "rm -rf", so that neither umount nor exit of this process waits for it.
+// Other threads may hold locks (malloc, logging) at fork time, so children only call exec (or _exit).
+// Blobs referenced only by removed cache are collected by the next mount (see tfs_purge_thread).
+static int tfs_purge_detached(const char *trash_path) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        logmsg(LOG_ERROR, "tfs_purge_detached - unable to fork: %d - %s", errno, strerror(errno));
         return EXIT_FAILURE;
     }
-   
-	do {        
-        if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-            continue; // mostly to skip "." and ".."       
-        
-        snprintf(abs_path, 4096, "%s%s%s", g_conf._temppath, PATH_SEP, find_data.cFileName);
-        if (!DeleteFileA(abs_path))
-            logmsg(LOG_ERROR, "tfs_rmdir - unable to delete file [%s]!", abs_path);       
 
-	} while (FindNextFileA(find_handle, &find_data));
-    
-    if (!FindClose(find_handle)) {
-        logmsg(LOG_ERROR, "tfs_rmdir, FindClose returned error=%lu", GetLastError());
+    if (pid == 0) {
+        // intermediate child, its child is adopted by init and removes the directory
+        setsid();
+        if (fork() != 0)
+            _exit(0);
+
+        execl("/bin/rm", "rm", "-rf", "--", trash_path, (char*) NULL);
+        _exit(127);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        logmsg(LOG_ERROR, "tfs_purge_detached - unable to start removal of [%s]", trash_path);
         return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
+
+// remove trash left behind by previous mounts (e.g. killed before their cleanup completed)
+static void* tfs_purge_thread(void *arg) {
+    DIR *dir = opendir(g_conf.temppath);
+    if (dir == NULL) {
+        logmsg(LOG_ERROR, "tfs_purge_thread - unable to open directory [%s]: %d %s", g_conf.temppath, errno, strerror(errno));
+        return NULL;
+    }
+
+    char trash_path[4096];
+    struct dirent *ent;
+    int removed = 0;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, "ddlfs-", 6) != 0 || strstr(ent->d_name, TFS_TRASH_INFIX) == NULL)
+            continue;
+
+        snprintf(trash_path, sizeof(trash_path), "%s%s%s", g_conf.temppath, PATH_SEP, ent->d_name);
+        if (tfs_rmtree(trash_path) == EXIT_SUCCESS)
+            removed++;
+    }
+    closedir(dir);
+
+    if (removed > 0)
+        logmsg(LOG_INFO, "Removed %d cache director%s left behind by previous mounts.", removed, (removed == 1 ? "y" : "ies"));
 
-    // this should fail if the directory is not empty.
-    if (!RemoveDirectoryA(g_conf._temppath)) {
-        logmsg(LOG_ERROR, "tfs_rmdir, unable to remove directry (%s), which _should_ be empty at this point.", g_conf._temppath);
+    // blobs referenced only by removed cache (including trash removed by previous mount, see tfs_purge_detached)
+    tfs_cas_gc();
+    return NULL;
+}
+
+static void tfs_purge_trash() {
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, tfs_purge_thread, NULL) != 0)
+        logmsg(LOG_ERROR, "tfs_purge_trash - unable to start thread, trash is not removed.");
+    pthread_attr_destroy(&attr);
+}
+#else
+// there is no fork, directory is removed by detached "rmdir /s /q"
+static int tfs_purge_detached(const char *trash_path) {
+    char cmd[4096];
+    snprintf(cmd, sizeof(cmd), "cmd.exe /c rmdir /s /q \"%s\"", trash_path);
+
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    memset(&si, 0, sizeof(si));
+    memset(&pi, 0, sizeof(pi));
+    si.cb = sizeof(si);
+    if (!CreateProcessA(NULL, cmd, NULL, NULL, FALSE, DETACHED_PROCESS | CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
+        logmsg(LOG_ERROR, "tfs_purge_detached - unable to start [%s], error=%lu", cmd, GetLastError());
         return EXIT_FAILURE;
     }
-    
-	return EXIT_SUCCESS;
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+    return EXIT_SUCCESS;
+}
+
+static void tfs_purge_trash() {
+    char pattern[4096];
+    snprintf(pattern, sizeof(pattern), "%s%sddlfs-*%s*", g_conf.temppath, PATH_SEP, TFS_TRASH_INFIX);
+    WIN32_FIND_DATA find_data;
+    HANDLE find_handle = FindFirstFileA(pattern, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE)
+        return;
+
+    char trash_path[4096];
+    do {
+        if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            continue;
+        snprintf(trash_path, sizeof(trash_path), "%s%s%s", g_conf.temppath, PATH_SEP, find_data.cFileName);
+        tfs_purge_detached(trash_path);
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
 }
 #endif
 
+int tfs_rmdir(int ignoreNoDir) {
+    char trash_path[4096];
+    if (tfs_trash(g_conf._temppath, trash_path, sizeof(trash_path), ignoreNoDir) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    // if it can not be removed now, the next mount will (tfs_purge_trash)
+    return tfs_purge_detached(trash_path);
+}
+
 int tfs_mkdir() {
 
     g_conf._temppath = calloc(2048, sizeof(char));
@@ -376,13 +917,21 @@ int tfs_mkdir() {
         return EXIT_FAILURE;
     }
 
-    snprintf(g_conf._temppath, 2047, "%s%sddlfs-%s.%s.%s.%s",
-        g_conf.temppath,
-        PATH_SEP,
-        g_conf.database,
-        (getenv("ORACLE_SID") == NULL ? "tns" : getenv("ORACLE_SID")),
-        g_conf.username,
-        g_conf.schemas);
+    if (g_conf.sharedcache == 1) {
+        // shared by every mount of the same database, regardless of connect string, user or schemas
+        snprintf(g_conf._temppath, 2047, "%s%sddlfs-db.%s",
+            g_conf.temppath,
+            PATH_SEP,
+            g_conf._dbid);
+    } else {
+        snprintf(g_conf._temppath, 2047, "%s%sddlfs-%s.%s.%s.%s",
+            g_conf.temppath,
+            PATH_SEP,
+            g_conf.database,
+            (getenv("ORACLE_SID") == NULL ? "tns" : getenv("ORACLE_SID")),
+            g_conf.username,
+            g_conf.schemas);
+    }
 
     // replace "special" characters
     for (size_t i = strlen(g_conf.temppath)+1; i < strlen(g_conf._temppath); i++) {
@@ -402,9 +951,29 @@ int tfs_mkdir() {
         g_conf._temppath[i] = '_';
     }
 
-    // (optionally) delete existing directory
-    if (g_conf.keepcache == 0)
-        tfs_rmdir(1);
+#ifndef _MSC_VER
+    // identical objects (from different schemas, pdbs or mounts) are stored only once, cache files are hard links
+    // (per user, as temppath may be shared and blobs of someone else must never become our cache files)
+    if (g_conf.dedup == 1) {
+        struct stat cas_st;
+        snprintf(tfs_cas_path, 2048, "%s%sddlfs-cas.%d", g_conf.temppath, PATH_SEP, (int) getuid());
+        if (mkdir(tfs_cas_path, 0700) != 0 && errno != EEXIST) {
+            logmsg(LOG_ERROR, "tfs_mkdir - unable to create directory [%s], dedup disabled: %d - %s", tfs_cas_path, errno, strerror(errno));
+            tfs_cas_path[0] = '\0';
+        } else if (lstat(tfs_cas_path, &cas_st) != 0 || !S_ISDIR(cas_st.st_mode) ||
+                   cas_st.st_uid != getuid() || (cas_st.st_mode & 0777) != 0700) {
+            logmsg(LOG_ERROR, "tfs_mkdir - [%s] is not a directory private to this user (mode 0700), dedup disabled.", tfs_cas_path);
+            tfs_cas_path[0] = '\0';
+        }
+    }
+#endif
+
+    // (optionally) discard existing directory, it is removed in background together with trash of previous mounts
+    if (g_conf.keepcache == 0) {
+        char trash_path[4096];
+        tfs_trash(g_conf._temppath, trash_path, sizeof(trash_path), 1);
+    }
+    tfs_purge_trash();
 
     // create or reuse directory
     g_conf._temppath_reused = 0;
@@ -431,6 +1000,14 @@ int tfs_mkdir() {
         logmsg(LOG_DEBUG, "tfs_mkdir - reused temporary directory: [%s]", g_conf._temppath);
         g_conf._temppath_reused = 1;
     }
+    g_conf._temppath_ready = 1;
+
+    if (g_conf.sharedcache == 1) {
+        char lock_fn[4096];
+        snprintf(lock_fn, 4096, "%s%sddlfs.lck", g_conf._temppath, PATH_SEP);
+        if (tfs_lock_open(lock_fn) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
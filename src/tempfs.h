@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <stdint.h>
 #ifdef _MSC_VER
 	#define pid_t int
 #endif
@@ -14,6 +15,28 @@
  * */
 
 
+/**
+ * Metadata of cached file, stored in ".dfs" file next to it.
+ * */
+typedef struct {
+    time_t   last_ddl_time;
+    pid_t    mount_pid;     // process which (re)validated this entry
+    time_t   mount_stamp;
+    uint64_t content_hash;  // hash of file content, 0=unknown
+    int      validity;      // 0=valid, 1=invalid, -1=unknown
+} t_tfs_meta;
+
+/**
+ * Write metadata of file specified by *path. mount_pid and mount_stamp
+ * are always set to those of current process.
+ * */
+int tfs_setmeta(const char *path, const t_tfs_meta *meta);
+
+/**
+ * Read metadata of file specified by *path.
+ * */
+int tfs_getmeta(const char *path, t_tfs_meta *meta);
+
 /**
  * set "last_ddl_time" extended attribute on file specified by *path.
  * */
@@ -24,6 +47,30 @@ int tfs_setldt(const char *path, time_t last_ddl_time);
  * */
 int tfs_getldt(const char *path, time_t *last_ddl_time, pid_t *mount_pid, time_t *mount_stamp);
 
+/**
+ * If cached file is up2date according to last_ddl_time, mark it as verified by this mount
+ * (see tfs_quick_validate). Metadata is read and written (only if needed) once.
+ * Outdated file is removed if discard is 1.
+ * return EXIT_SUCCESS if file was verified and EXIT_FAILURE if it is missing, outdated (or on error).
+ * */
+int tfs_revalidate(const char *cache_fn, time_t last_ddl_time, int discard);
+
+/**
+ * Check if content of cached file is the same as its content when it was written to cache
+ * (see content_hash). If it is, file is marked as not modified (mtime=0) again.
+ * return EXIT_SUCCESS if content is unchanged and EXIT_FAILURE if it has changed (or it is unknown).
+ * */
+int tfs_unchanged(const char *cache_fn);
+
+/**
+ * Map content of cached file to memory (read-only), so that it can be passed to OCI without copying it.
+ * *len is set to file size, *data is NULL for empty file. Must be released by tfs_unmap().
+ * On Windows, file is read to allocated buffer instead.
+ * */
+int tfs_map(const char *cache_fn, const char **data, size_t *len);
+
+void tfs_unmap(const char *data, size_t len);
+
 /**
  * Remove cached file (and its metadata).
  * */
@@ -35,7 +82,7 @@ int tfs_rmfile(const char *cache_fn);
  * return EXIT_SUCCESS if cached file is up2date and EXIT_FAILURE on either error OR if cached file is outdated.
  * (because failure should invalidate cache anyway)
  * */
-int tfs_validate(const char *cache_fn, const char *last_ddl_time, time_t *actual_time);
+int tfs_validate(const char *cache_fn, char *last_ddl_time, time_t *actual_time);
 
 /**
  * Exactly the same as tfs_validate, except it doesn't need to convert string time to time_t time
@@ -49,6 +96,44 @@ int tfs_validate2(const char *cache_fn, time_t last_ddl_time);
  * */
 int tfs_quick_validate(const char *path);
 
+/**
+ * Lock cache entry cache_fn for exclusive access. Cache directory may be shared by
+ * more than one ddlfs process (sharedcache=1), this lock protects the entry from
+ * being (re)written by two processes (or two threads) at the same time.
+ * tfs_unlock() must be called even if tfs_lock() fails.
+ * */
+int tfs_lock(const char *cache_fn);
+
+/**
+ * Release lock obtained by tfs_lock().
+ * */
+int tfs_unlock(const char *cache_fn);
+
+/**
+ * Determine name of the staging file (staging_fn) for cache file cache_fn. Contents
+ * are written to staging file first and then atomically moved to cache_fn by tfs_commit(),
+ * so that other processes never see partially written cache file.
+ * */
+int tfs_staging_fn(const char *cache_fn, char *staging_fn, size_t staging_len);
+
+/**
+ * Atomically replace cache_fn with staging_fn.
+ * */
+int tfs_commit(const char *staging_fn, const char *cache_fn);
+
+/**
+ * Compute content hash of staging file and, if the same content is already cached (under any
+ * name, by any mount), replace staging file with hard link to existing copy (dedup=1).
+ * Shared copies are kept in ddlfs-cas folder within temppath.
+ * */
+int tfs_dedup(const char *staging_fn, uint64_t *content_hash);
+
+/**
+ * Make sure cache_fn is not shared with other cache files (see tfs_dedup), this must
+ * be called before cache file is modified.
+ * */
+int tfs_unshare(const char *cache_fn);
+
 /**
  * Create temporary directory for cached files (cached ddl content). 
  * This folder may be removed on umount (depending on parameters).
@@ -58,7 +143,9 @@ int tfs_mkdir();
 
 /**
  * Remove temporary directory for cached files (cached ddl content).
- * This is optionally called on umount.
+ * This is optionally called on umount. Directory is atomically renamed to a trash name and
+ * removed by a detached process, so this does not wait for its files to be deleted.
+ * Trash which was not removed (e.g. process was killed) is removed by the next mount (tfs_mkdir).
  * */
 int tfs_rmdir();
 
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifdef _MSC_VER
@@ -14,6 +15,8 @@
 
 #include "logging.h"
 #include "config.h"
+#include "util.h"
+#include "objtype.h"
 
 #ifdef _MSC_VER
 	#define strdup _strdup	
@@ -21,93 +24,110 @@
 #endif
 
 
-time_t utl_str2time(char *time) {
-    struct tm *temptime = malloc(sizeof(struct tm));
-    if (temptime == NULL) {
-            logmsg(LOG_ERROR, "utl_str2time(): unable to allocate memory for temptime");
-            return -1;
-    }
-    memset(temptime, 0, sizeof(struct tm));
-    
-	// strptime is not available in Windows
-	// char* xx = strptime(time, "%Y-%m-%d %H:%M:%S", temptime);
-	// if (xx == NULL || *xx != '\0') {
-	//     logmsg(LOG_ERROR, "utl_str2time(): unable to parse date [%s]", time);
-	//     free(temptime);
-	//     return -1;
-	// }
-	temptime->tm_isdst = -1;
-	memset(temptime, 0, sizeof(struct tm));
-	sscanf(time, "%d-%d-%d %d:%d:%d", &temptime->tm_year, &temptime->tm_mon, &temptime->tm_mday, &temptime->tm_hour, &temptime->tm_min, &temptime->tm_sec);
-	temptime->tm_mon -= 1;		// months are 0 - 11 and 
-	temptime->tm_year -= 1900;	// years start in 1900
-	
-	time_t retval = mktime(temptime); //timegm(temptime);
-    free(temptime);
-    return retval;
+// offset (seconds west of UTC) of local standard time, see utl_time_init()
+static long long utl_std_west = 0;
+static int utl_std_west_set = 0;
+
+// days since 1970-01-01 of proleptic gregorian date
+static long long utl_days_from_civil(int y, int m, int d) {
+    y -= (m <= 2);
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    long long yoe = y - era * 400;
+    long long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
 }
 
-int utl_fs2oratype(char **fstype) {
-    char *type = *fstype;
-
-    if (strcmp(type, "PACKAGE_SPEC") == 0) {
-        free(type);
-        type = strdup("PACKAGE");
-    } else if (strcmp(type, "PACKAGE_BODY") == 0) {
-        free(type);
-        type = strdup("PACKAGE BODY");
-    } else if (strcmp(type, "TYPE_BODY") == 0) {
-        free(type);
-        type = strdup("TYPE BODY");
-    } else if (strcmp(type, "JAVA_SOURCE") == 0) {
-        free(type);
-        type = strdup("JAVA SOURCE");
-    } else if (strcmp(type, "JAVA_CLASS") == 0) {
-        free(type);
-        type = strdup("JAVA CLASS");
-    } else if (strcmp(type, "MATERIALIZED_VIEW") == 0) {
-        free(type);
-        type = strdup("MATERIALIZED VIEW");
+void utl_time_init() {
+    // dates were always converted by mktime() as local standard time (tm_isdst=0), offset is the same for all of them
+    time_t now = time(NULL);
+    struct tm t;
+#ifndef _MSC_VER
+    localtime_r(&now, &t);
+#else
+    localtime_s(&t, &now);
+#endif
+    int year = t.tm_year + 1900;
+    memset(&t, 0, sizeof(struct tm));
+    t.tm_year = year - 1900;
+    t.tm_mday = 1;
+    t.tm_hour = 12;
+    t.tm_isdst = 0;
+    utl_std_west = (long long) mktime(&t) - (utl_days_from_civil(year, 1, 1) * 86400 + 12 * 3600);
+    utl_std_west_set = 1;
+}
+
+time_t utl_epoch2time(long long wall) {
+    if (utl_std_west_set == 0)
+        utl_time_init();
+    return (time_t) (wall + utl_std_west);
+}
+
+// parse exactly n digits at *p
+static int utl_digits(const char **p, int n, int *value) {
+    int v = 0;
+    for (int i = 0; i < n; i++, (*p)++) {
+        if (**p < '0' || **p > '9')
+            return EXIT_FAILURE;
+        v = v * 10 + (**p - '0');
     }
+    *value = v;
+    return EXIT_SUCCESS;
+}
 
+time_t utl_str2time(char *time) {
+    int y, mo, d, h, mi, sec;
+    const char *p = time;
+    if (utl_digits(&p, 4, &y) == EXIT_SUCCESS && *p++ == '-' &&
+        utl_digits(&p, 2, &mo) == EXIT_SUCCESS && *p++ == '-' &&
+        utl_digits(&p, 2, &d) == EXIT_SUCCESS && *p++ == ' ' &&
+        utl_digits(&p, 2, &h) == EXIT_SUCCESS && *p++ == ':' &&
+        utl_digits(&p, 2, &mi) == EXIT_SUCCESS && *p++ == ':' &&
+        utl_digits(&p, 2, &sec) == EXIT_SUCCESS &&
+        mo >= 1 && mo <= 12 && d >= 1 && d <= 31 && h <= 23 && mi <= 59 && sec <= 59)
+        return utl_epoch2time(utl_days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec);
+
+    // anything else (not formatted as 'yyyy-mm-dd hh24:mi:ss') is left to mktime, as it always was
+    struct tm temptime;
+    memset(&temptime, 0, sizeof(struct tm));
+    sscanf(time, "%d-%d-%d %d:%d:%d", &temptime.tm_year, &temptime.tm_mon, &temptime.tm_mday, &temptime.tm_hour, &temptime.tm_min, &temptime.tm_sec);
+    temptime.tm_mon -= 1;       // months are 0 - 11 and
+    temptime.tm_year -= 1900;   // years start in 1900
+    return mktime(&temptime);
+}
+
+// replace *name (malloc-ed) with name, unless it's the same already
+static int utl_replace_type(char **name, const char *type_name) {
+    if (strcmp(*name, type_name) == 0)
+        return EXIT_SUCCESS;
+
+    char *type = strdup(type_name);
     if (type == NULL) {
-        logmsg(LOG_ERROR, "str_fs2oratype() - unable to malloc for normalized type.");
+        logmsg(LOG_ERROR, "utl_replace_type() - unable to malloc for normalized type.");
         return EXIT_FAILURE;
     }
-
-    *fstype = type;
+    free(*name);
+    *name = type;
     return EXIT_SUCCESS;
 }
 
+int utl_fs2oratype(char **fstype) {
+    const t_objtype *ot = ot_by_fs(*fstype);
+    return (ot == NULL ? EXIT_SUCCESS : utl_replace_type(fstype, ot->ora_name));
+}
+
 int utl_ora2fstype(char **oratype) {
-    char *type = *oratype;
-    if (strcmp(type, "PACKAGE") == 0) {
-        free(type);
-        type = strdup("PACKAGE_SPEC");
-    } else if (strcmp(type, "PACKAGE BODY") == 0) {
-        free(type);
-        type = strdup("PACKAGE_BODY");
-    } else if (strcmp(type, "TYPE BODY") == 0) {
-        free(type);
-        type = strdup("TYPE_BODY");
-    } else if (strcmp(type, "JAVA SOURCE") == 0) {
-        free(type);
-        type = strdup("JAVA_SOURCE");
-    } else if (strcmp(type, "JAVA CLASS") == 0) {
-        free(type);
-        type = strdup("JAVA_CLASS");
-    } else if (strcmp(type, "MATERIALIZED VIEW") == 0) {
-        free(type);
-        type = strdup("MATERIALIZED_VIEW");
-    }
+    const t_objtype *ot = ot_by_ora(*oratype);
+    return (ot == NULL ? EXIT_SUCCESS : utl_replace_type(oratype, ot->fs_name));
+}
 
-    if (type == NULL) {
-        logmsg(LOG_ERROR, "str_ora2fstype() - unable to malloc for normalized type.");
-        return EXIT_FAILURE;
+uint64_t utl_hash(const void *data, size_t len, uint64_t hash) {
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
     }
-
-    *oratype = type;
-    return EXIT_SUCCESS;
+    return hash;
 }
 
 void ora_replace_all_dba(char *query) {
@@ -1,5 +1,6 @@
 #pragma once
 #include <sys/types.h>
+#include <stdint.h>
 #include <time.h>
 
 #ifdef _MSC_VER
@@ -13,6 +14,17 @@
  * */
 time_t utl_str2time(char *time);
 
+/**
+ * Convert date from database as seconds since 1970-01-01 00:00:00 (see ORA_EPOCH) to time_t. Dates are
+ * interpreted as local standard time, the same as by utl_str2time, but without mktime() for every row.
+ * */
+time_t utl_epoch2time(long long wall);
+
+/**
+ * Determine offset of local standard time used by utl_epoch2time (called once at startup, before any threads).
+ * */
+void utl_time_init();
+
 /**
  * Convert filesystem type (e.g. "PACKAGE_SPEC") to Oracle type (e.g. "PACKAGE")
  * *fstype must not be allocated on stack (use malloc() or anything similar)
@@ -24,6 +36,13 @@ int utl_fs2oratype(char **fstype);
  * */
 int utl_ora2fstype(char **oratype);
 
+/**
+ * FNV-1a hash of len bytes pointed to by data. Pass UTL_HASH_INIT as hash for the first
+ * chunk and the previously returned value for any subsequent chunk of the same content.
+ * */
+#define UTL_HASH_INIT 14695981039346656037ULL
+uint64_t utl_hash(const void *data, size_t len, uint64_t hash);
+
 /**
  * Replace every occurrence of " all_" with " dba_" if g_conf._has_catalog_role == 1.
  */
@@ -1,13 +1,63 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
 
 #ifdef _WIN64
 	#include <SYS\TYPES.H>
 	#define strdup _strdup
 #endif
+#ifndef _MSC_VER
+	#include <pthread.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
 
 #include "vfs.h"
 #include "logging.h"
+#include "objtype.h"
+
+#define VFS_SNAPSHOT_VERSION 1
+
+// snapshot file header
+typedef struct {
+    char     magic[8];     // "DDLFSVFS"
+    uint32_t version;
+    uint32_t count;        // number of records
+    uint64_t names_size;   // size of names (zero terminated strings) following records
+    int64_t  mount_pid;    // identity of cache entries snapshot is consistent with
+    int64_t  mount_stamp;
+} t_vfs_header;
+
+// one entry, records are in preorder (parent before its children, children sorted by name)
+typedef struct {
+    int32_t  parent;       // index of parent record, -1 for root
+    uint32_t name;         // offset of name within names
+    int64_t  fsize;
+    int64_t  created;
+    int64_t  modified;
+    char     ftype;
+    char     loaded;
+    char     pad[6];
+} t_vfs_record;
+
+// invalidations queued by vfs_invalidate_later (and updates queued by vfs_update_later)
+typedef struct {
+    char *schema;
+    char *type;
+    char *fname;     // NULL=invalidation of directory, otherwise update of this file entry
+    char  ftype;
+    time_t modified;
+} t_vfs_invalidation;
+
+#ifndef _MSC_VER
+static pthread_mutex_t vfs_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static t_vfs_invalidation *vfs_pending = NULL;
+static int vfs_pending_count = 0;
 
 t_fsentry* vfs_entry_create(const char type, 
                             const char *fname, 
@@ -34,6 +84,8 @@ t_fsentry* vfs_entry_create(const char type,
         t->children = NULL;
     }
     t->allocated = 1;
+    t->loaded = 0;
+    t->otype = OT_NONE;
     // logmsg(LOG_DEBUG, "++ VFS_ENTRY (%s) addr=[%p]", fname, t);
     return t;
 }
@@ -45,6 +97,7 @@ void vfs_entry_free(t_fsentry *entry, int children_only) {
         vfs_entry_free(entry->children[i], 0);
         
     entry->count = 0;
+    entry->loaded = 0;
     if (!children_only) {
         if (entry->children != NULL)
             free(entry->children);
@@ -76,6 +129,10 @@ void vfs_entry_add(t_fsentry *parent, t_fsentry *child) {
         parent->children = realloc(parent->children, parent->capacity * sizeof(t_fsentry*));    
     }
     parent->children[parent->count++] = child;
+
+    // objects are of the type of their directory
+    if (child->otype == OT_NONE)
+        child->otype = parent->otype;
 }
     
 t_fsentry* _vfs_search(t_fsentry *entry, const char *fname, int min, int max, int depth) {
@@ -117,3 +174,265 @@ static int vfs_entry_compare(const void *a, const void *b) {
 void vfs_entry_sort(t_fsentry *parent) {
     qsort(parent->children, parent->count, sizeof(t_fsentry*), vfs_entry_compare);
 }
+
+// remove (and free) child fname of parent, children stay sorted
+int vfs_entry_remove(t_fsentry *parent, const char *fname) {
+    t_fsentry *child = vfs_entry_search(parent, fname);
+    if (child == NULL)
+        return EXIT_FAILURE;
+
+    for (int i = 0; i < parent->count; i++) {
+        if (parent->children[i] == child) {
+            memmove(&parent->children[i], &parent->children[i+1], (parent->count - i - 1) * sizeof(t_fsentry*));
+            parent->count--;
+            break;
+        }
+    }
+    vfs_entry_free(child, 0);
+    return EXIT_SUCCESS;
+}
+
+static void vfs_snapshot_count(t_fsentry *entry, uint32_t *count, uint64_t *names_size) {
+    (*count)++;
+    *names_size += strlen(entry->fname) + 1;
+    for (int i = 0; i < entry->count; i++)
+        vfs_snapshot_count(entry->children[i], count, names_size);
+}
+
+static void vfs_snapshot_fill(t_fsentry *entry, int32_t parent, t_vfs_record *records, uint32_t *count, char *names, uint64_t *names_size) {
+    int32_t self = (int32_t) *count;
+    t_vfs_record *r = &records[(*count)++];
+    memset(r, 0, sizeof(t_vfs_record));
+    r->parent = parent;
+    r->name = (uint32_t) *names_size;
+    r->fsize = (int64_t) entry->fsize;
+    r->created = (int64_t) entry->created;
+    r->modified = (int64_t) entry->modified;
+    r->ftype = entry->ftype;
+    r->loaded = (char) entry->loaded;
+
+    size_t len = strlen(entry->fname) + 1;
+    memcpy(names + *names_size, entry->fname, len);
+    *names_size += len;
+
+    for (int i = 0; i < entry->count; i++)
+        vfs_snapshot_fill(entry->children[i], self, records, count, names, names_size);
+}
+
+int vfs_snapshot_save(const char *fn, long long mount_pid, long long mount_stamp) {
+    t_vfs_header header;
+    memset(&header, 0, sizeof(t_vfs_header));
+    memcpy(header.magic, "DDLFSVFS", 8);
+    header.version = VFS_SNAPSHOT_VERSION;
+    header.mount_pid = (int64_t) mount_pid;
+    header.mount_stamp = (int64_t) mount_stamp;
+    vfs_snapshot_count(g_vfs, &header.count, &header.names_size);
+
+    t_vfs_record *records = malloc(header.count * sizeof(t_vfs_record));
+    char *names = malloc(header.names_size);
+    if (records == NULL || names == NULL) {
+        logmsg(LOG_ERROR, "vfs_snapshot_save() - unable to allocate memory for %u entries", header.count);
+        free(records);
+        free(names);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t count = 0;
+    uint64_t names_size = 0;
+    vfs_snapshot_fill(g_vfs, -1, records, &count, names, &names_size);
+
+    int retval = EXIT_SUCCESS;
+    FILE *fp = fopen(fn, "wb");
+    if (fp == NULL) {
+        logmsg(LOG_ERROR, "vfs_snapshot_save() - unable to open [%s]: %d - %s", fn, errno, strerror(errno));
+        retval = EXIT_FAILURE;
+    } else {
+        if (fwrite(&header, sizeof(t_vfs_header), 1, fp) != 1 ||
+            fwrite(records, sizeof(t_vfs_record), header.count, fp) != header.count ||
+            fwrite(names, 1, header.names_size, fp) != header.names_size) {
+            logmsg(LOG_ERROR, "vfs_snapshot_save() - unable to write [%s]: %d - %s", fn, errno, strerror(errno));
+            retval = EXIT_FAILURE;
+        }
+        if (fclose(fp) != 0)
+            retval = EXIT_FAILURE;
+        if (retval != EXIT_SUCCESS)
+            remove(fn);
+    }
+
+    if (retval == EXIT_SUCCESS)
+        logmsg(LOG_DEBUG, "vfs_snapshot_save() - saved %u entries to [%s]", header.count, fn);
+
+    free(records);
+    free(names);
+    return retval;
+}
+
+// build tree (into g_vfs) from snapshot contents
+static int vfs_snapshot_build(const char *data, size_t size, long long mount_pid, long long mount_stamp) {
+    const t_vfs_header *header = (const t_vfs_header*) data;
+    if (size < sizeof(t_vfs_header) ||
+        memcmp(header->magic, "DDLFSVFS", 8) != 0 ||
+        header->version != VFS_SNAPSHOT_VERSION ||
+        header->count == 0 ||
+        header->names_size == 0 ||
+        header->names_size > size ||
+        size != sizeof(t_vfs_header) + (size_t) header->count * sizeof(t_vfs_record) + header->names_size) {
+        logmsg(LOG_INFO, "Ignoring invalid vfs snapshot.");
+        return EXIT_FAILURE;
+    }
+
+    if (header->mount_pid != (int64_t) mount_pid || header->mount_stamp != (int64_t) mount_stamp) {
+        logmsg(LOG_DEBUG, "vfs_snapshot_build() - snapshot is not consistent with cache (mount %lld.%lld)", (long long) header->mount_pid, (long long) header->mount_stamp);
+        return EXIT_FAILURE;
+    }
+
+    const t_vfs_record *records = (const t_vfs_record*) (data + sizeof(t_vfs_header));
+    const char *names = (const char*) (records + header->count);
+
+    // every name offset (checked below) must point to a string which ends within the snapshot
+    if (names[header->names_size-1] != '\0') {
+        logmsg(LOG_INFO, "Ignoring invalid vfs snapshot (names are not terminated).");
+        return EXIT_FAILURE;
+    }
+
+    t_fsentry **entries = malloc(header->count * sizeof(t_fsentry*));
+    if (entries == NULL) {
+        logmsg(LOG_ERROR, "vfs_snapshot_build() - unable to allocate memory for %u entries", header->count);
+        return EXIT_FAILURE;
+    }
+
+    // records[0] is root (g_vfs itself)
+    entries[0] = g_vfs;
+    g_vfs->loaded = records[0].loaded;
+    for (uint32_t i = 1; i < header->count; i++) {
+        const t_vfs_record *r = &records[i];
+        if (r->parent < 0 || (uint32_t) r->parent >= i || r->name >= header->names_size || entries[r->parent]->ftype != 'D') {
+            logmsg(LOG_ERROR, "vfs_snapshot_build() - invalid record %u", i);
+            vfs_entry_free(g_vfs, 1);
+            free(entries);
+            return EXIT_FAILURE;
+        }
+
+        entries[i] = vfs_entry_create(r->ftype, names + r->name, (time_t) r->created, (time_t) r->modified);
+        entries[i]->fsize = (off_t) r->fsize;
+        entries[i]->loaded = r->loaded;
+        if (records[r->parent].parent == 0) {
+            // type directory (parent is schema)
+            const t_objtype *ot = ot_by_fs(entries[i]->fname);
+            entries[i]->otype = (ot == NULL ? OT_NONE : ot->id);
+        }
+        vfs_entry_add(entries[r->parent], entries[i]);
+    }
+
+    logmsg(LOG_INFO, "Loaded %u entries from vfs snapshot.", header->count);
+    free(entries);
+    return EXIT_SUCCESS;
+}
+
+int vfs_snapshot_load(const char *fn, long long mount_pid, long long mount_stamp) {
+    int retval = EXIT_FAILURE;
+
+#ifndef _MSC_VER
+    int fd = open(fn, O_RDONLY);
+    if (fd == -1) {
+        logmsg(LOG_DEBUG, "vfs_snapshot_load() - no snapshot [%s] found.", fn);
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            logmsg(LOG_ERROR, "vfs_snapshot_load() - unable to mmap [%s]: %d - %s", fn, errno, strerror(errno));
+        } else {
+            retval = vfs_snapshot_build((const char*) data, (size_t) st.st_size, mount_pid, mount_stamp);
+            munmap(data, (size_t) st.st_size);
+        }
+    }
+    close(fd);
+#else
+    FILE *fp = fopen(fn, "rb");
+    if (fp == NULL) {
+        logmsg(LOG_DEBUG, "vfs_snapshot_load() - no snapshot [%s] found.", fn);
+        return EXIT_FAILURE;
+    }
+
+    long size = 0;
+    char *data = NULL;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0 &&
+        (data = malloc((size_t) size)) != NULL && fread(data, 1, (size_t) size, fp) == (size_t) size)
+        retval = vfs_snapshot_build(data, (size_t) size, mount_pid, mount_stamp);
+    free(data);
+    fclose(fp);
+#endif
+
+    if (remove(fn) != 0)
+        logmsg(LOG_ERROR, "vfs_snapshot_load() - unable to remove [%s]: %d - %s", fn, errno, strerror(errno));
+
+    return retval;
+}
+
+static void vfs_pending_add(const char *schema, const char *type, const char *fname, char ftype, time_t modified) {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&vfs_mutex);
+#endif
+    t_vfs_invalidation *tmp = realloc(vfs_pending, (vfs_pending_count+1) * sizeof(t_vfs_invalidation));
+    if (tmp == NULL) {
+        logmsg(LOG_ERROR, "vfs_pending_add() - unable to allocate memory for [%s].[%s]", schema, (type == NULL ? "" : type));
+    } else {
+        vfs_pending = tmp;
+        vfs_pending[vfs_pending_count].schema = strdup(schema);
+        vfs_pending[vfs_pending_count].type = (type == NULL ? NULL : strdup(type));
+        vfs_pending[vfs_pending_count].fname = (fname == NULL ? NULL : strdup(fname));
+        vfs_pending[vfs_pending_count].ftype = ftype;
+        vfs_pending[vfs_pending_count].modified = modified;
+        vfs_pending_count++;
+    }
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&vfs_mutex);
+#endif
+}
+
+void vfs_invalidate_later(const char *schema, const char *type) {
+    vfs_pending_add(schema, type, NULL, 0, 0);
+}
+
+void vfs_update_later(const char *schema, const char *type, const char *fname, char ftype, time_t modified) {
+    vfs_pending_add(schema, type, fname, ftype, modified);
+}
+
+void vfs_invalidate_pending() {
+#ifndef _MSC_VER
+    pthread_mutex_lock(&vfs_mutex);
+#endif
+    for (int i = 0; i < vfs_pending_count; i++) {
+        t_vfs_invalidation *inv = &vfs_pending[i];
+        t_fsentry *schema = (inv->schema == NULL ? NULL : vfs_entry_search(g_vfs, inv->schema));
+        if (inv->type == NULL) {
+            // schema was created, dropped or its objects changed
+            g_vfs->loaded = 0;
+            if (schema != NULL)
+                vfs_entry_free(schema, 1);
+        } else if (schema != NULL) {
+            t_fsentry *type = vfs_entry_search(schema, inv->type);
+            t_fsentry *file = (type == NULL || inv->fname == NULL ? NULL : vfs_entry_search(type, inv->fname));
+            if (file != NULL) {
+                file->ftype = inv->ftype;
+                file->modified = inv->modified;
+            } else if (type != NULL) {
+                vfs_entry_free(type, 1);
+            }
+        }
+        logmsg(LOG_DEBUG, "vfs_invalidate_pending() - invalidated [%s].[%s] [%s]", (inv->schema == NULL ? "" : inv->schema),
+            (inv->type == NULL ? "" : inv->type), (inv->fname == NULL ? "" : inv->fname));
+        free(inv->schema);
+        free(inv->type);
+        free(inv->fname);
+    }
+    free(vfs_pending);
+    vfs_pending = NULL;
+    vfs_pending_count = 0;
+#ifndef _MSC_VER
+    pthread_mutex_unlock(&vfs_mutex);
+#endif
+}
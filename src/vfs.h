@@ -14,8 +14,12 @@ typedef struct s_fsentry {
 	int 	capacity;
 	int 	count;
 	int     allocated;
+	int     loaded;   // 1=children are complete listing from database (or snapshot)
+	int     otype;    // id of object type (see objtype.h) of type directories and their objects, OT_NONE otherwise
 } t_fsentry;
 
+#define VFS_SNAPSHOT_FILE "ddlfs.vfs" // in cache directory, see vfs_snapshot_save()
+
 extern t_fsentry *g_vfs;
 extern t_fsentry *g_vfs_last_schema;
 
@@ -43,3 +47,36 @@ t_fsentry* vfs_entry_search(t_fsentry *entry, const char *fname);
 
 void vfs_entry_sort(t_fsentry *parent);
 
+int vfs_entry_remove(t_fsentry *parent, const char *fname);
+
+
+/**
+ * Save whole tree (g_vfs) to snapshot file fn, which is tagged with identity of cache
+ * entries it is consistent with (see dbr_generation).
+ * Snapshot is array of fixed-size records followed by their names, it is mmap-ed when loaded.
+ * */
+int vfs_snapshot_save(const char *fn, long long mount_pid, long long mount_stamp);
+
+/**
+ * Load snapshot fn into g_vfs (which must be empty), but only if it is tagged with specified identity.
+ * Snapshot file is removed, so that it is never used twice (tree changes are not written to it).
+ * */
+int vfs_snapshot_load(const char *fn, long long mount_pid, long long mount_stamp);
+
+/**
+ * Queue invalidation of loaded directory (schema, type) or, if type is NULL, of schema and list of
+ * schemas. This may be called from any thread, see vfs_invalidate_pending().
+ * */
+void vfs_invalidate_later(const char *schema, const char *type);
+
+/**
+ * Queue update of file entry (schema, type, fname) in place: its validity (ftype F/I) and modification
+ * time, e.g. after its DDL was executed. If the entry is not loaded, its directory is invalidated instead.
+ * This may be called from any thread, see vfs_invalidate_pending().
+ * */
+void vfs_update_later(const char *schema, const char *type, const char *fname, char ftype, time_t modified);
+
+/**
+ * Apply queued invalidations and updates (from the thread which uses g_vfs).
+ * */
+void vfs_invalidate_pending();
@@ -13,6 +13,8 @@ username=$CFG_USERNAME,\
 password=$CFG_PASSWORD,\
 schemas=%,\
 loglevel=DEBUG,\
+prefetch=2,\
+stream=2,\
 database=$CFG_DATABASE \
 "$CFG_MOUNT_POINT" \
 # &> testcase.log &
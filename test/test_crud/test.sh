@@ -15,13 +15,36 @@ function proc_compare() {
     exit 1
 }
 
+# number of DDL statements executed so far, it only grows
+function compiled_count() {
+    sed -n 's/^compiled=//p' "$CFG_MOUNT_POINT/ddlfs.status"
+}
+
+# wait until DDL written through the filesystem is executed (release may be delivered after close returns,
+# so compile_queue=0 does not mean it was queued and executed already), $1 is compiled_count before the write
+function wait_compiled() {
+    local l_waited=0
+    until [ "$(compiled_count)" -gt "$1" ]
+    do
+        if [ "$l_waited" -ge 60 ]
+        then
+            echo "error: DDL was not executed within 60 seconds!"
+            exit 1
+        fi
+        sleep 1
+        l_waited=$((l_waited + 1))
+    done
+}
+
 function test_create() {
     local readonly l_type="$1"
     local readonly l_dbf="$2"
     local readonly l_rpf="$3"
 
     echo "creating $l_type/$l_dbf"
+    local readonly l_compiled="$(compiled_count)"
     > "$CFG_MOUNT_POINT/$CFG_USERNAME/$l_type/$l_dbf"
+    wait_compiled "$l_compiled"
     proc_compare "repository/$l_rpf" "$CFG_MOUNT_POINT/$CFG_USERNAME/$l_type/$l_dbf"
 }
 
@@ -31,10 +54,59 @@ function test_copy() {
     local readonly l_rpf="$3"
 
     echo "copying $l_type/$l_dbf"
+    local readonly l_compiled="$(compiled_count)"
     cp repository/$l_rpf "$CFG_MOUNT_POINT/$CFG_USERNAME/$l_type/$l_dbf"
+    # cache file is refilled from database once DDL is executed, so this compares with what reached database
+    wait_compiled "$l_compiled"
     proc_compare "repository/$l_rpf" "$CFG_MOUNT_POINT/$CFG_USERNAME/$l_type/$l_dbf"
 }
 
+# large object is read while it is still being fetched (see stream=), partial, full and concurrent
+# reads (which join the same fetch) must all return what is in database
+function test_stream() {
+    local readonly l_dbf="$1"
+    local readonly l_lines="$2"
+    local readonly l_file="$CFG_MOUNT_POINT/$CFG_USERNAME/PACKAGE_SPEC/$l_dbf"
+    local readonly l_tmp="$(mktemp -d)"
+
+    echo "streaming PACKAGE_SPEC/$l_dbf ($l_lines lines)"
+    {
+        echo "CREATE OR REPLACE EDITIONABLE PACKAGE \"$CFG_USERNAME\".\"${l_dbf%.*}\" AS"
+        for i in $(seq 1 "$l_lines")
+        do
+            echo "   PROCEDURE proc_$i(p_param IN NUMBER);"
+        done
+        echo "END;"
+    } > "$l_tmp/expected.sql"
+
+    # created by another session, so that it is not cached by ddlfs
+    { cat "$l_tmp/expected.sql"; echo "/"; } | sqlplus -S $CFG_USERNAME/$CFG_PASSWORD@$CFG_DATABASE &> /dev/null
+    ls "$CFG_MOUNT_POINT/$CFG_USERNAME/PACKAGE_SPEC/" &> /dev/null
+
+    # only the beginning is read (reader closes the file while the rest is still being fetched)
+    head -c 1000 "$l_file" > "$l_tmp/head.sql"
+    head -c 1000 "$l_tmp/expected.sql" > "$l_tmp/expected_head.sql"
+    proc_compare "$l_tmp/expected_head.sql" "$l_tmp/head.sql"
+
+    proc_compare "$l_tmp/expected.sql" "$l_file"
+
+    # changed by another session again, concurrent opens of the same object share one fetch
+    { head -n -1 "$l_tmp/expected.sql"; echo "   PROCEDURE proc_last;"; echo "END;"; } > "$l_tmp/changed.sql"
+    { cat "$l_tmp/changed.sql"; echo "/"; } | sqlplus -S $CFG_USERNAME/$CFG_PASSWORD@$CFG_DATABASE &> /dev/null
+    cat "$l_file" > "$l_tmp/read1.sql" &
+    cat "$l_file" > "$l_tmp/read2.sql" &
+    cat "$l_file" > "$l_tmp/read3.sql"
+    wait
+    proc_compare "$l_tmp/changed.sql" "$l_tmp/read1.sql"
+    proc_compare "$l_tmp/changed.sql" "$l_tmp/read2.sql"
+    proc_compare "$l_tmp/changed.sql" "$l_tmp/read3.sql"
+
+    sqlplus -S $CFG_USERNAME/$CFG_PASSWORD@$CFG_DATABASE &> /dev/null << eof
+        drop package "$CFG_USERNAME"."${l_dbf%.*}";
+eof
+    rm -rf "$l_tmp"
+}
+
 function test_delete() {
     local readonly l_type="$1"
     local readonly l_dbf="$2"
@@ -128,6 +200,9 @@ eof
  test_copy "TYPE_BODY"     "TYPE2.SQL"         "TYPE_BODY2.SQL"
 # trigger, materialized_view, table: not supported
 
+# Test reading large objects while they are being fetched (streaming)
+ test_stream "PACKAGE_STREAM.SQL"   20000
+
 # Test deleting existing files
  test_delete "PACKAGE_BODY"         "PACKAGE1.SQL"
  test_delete "PACKAGE_SPEC"         "PACKAGE1.SQL"
@@ -3,6 +3,12 @@
 
 . cfg.sh
 
+# cache is validated in background after mount
+until grep -q '^state=\(ready\|failed\)' "$CFG_MOUNT_POINT/ddlfs.status"
+do
+    sleep 1
+done
+
 if [ -f cache/*/ddlfs-DDLFS_TESTCASE.VIEW.VIEW_DBRO_VW.SQL.tmp ]
 then
     echo "error: cache file was not removed during mount..."